@@ -3,6 +3,7 @@
 #include "utils/base_app.h"
 #include "stat/stat.h"
 #include "common_msg.h"
+#include "jobs/jobs.h"
 
 #include "systems/renderer/renderer_interface.h"
 #include "systems/render_data_manager/render_data_manager_interface.h"
@@ -19,31 +20,17 @@ int run_application(BaseApp& pSample, UINT width, UINT height);
 class SceneEngine : public BaseApp
 {
 	std::vector<std::unique_ptr<IBaseSystem>> systems_;
-	LockFreeQueue_SingleConsumer<CommonMsg::Message, 32> msg_queue_;
 
 protected:
 	void OnInit(HWND hWnd, UINT width, UINT height) override;
 	void Tick() override 
 	{ 
 		//IF_DO_STAT(stat_app_tick.PassValue(1));
-		while (auto opt_msg = msg_queue_.Pop())
-		{
-			//IF_DO_STAT(stat_app_msg.PassValue(msg_queue_.Num()));
-			//STAT_TIME_SCOPE(app, broadcast);
-			for (auto& system : systems_)
-			{
-				assert(system);
-				system->ReceiveCommonMessage(*opt_msg);
-			}
-		}
-		std::this_thread::yield();
+		// CommonMsg goes through the bus directly to subscribers, so there is nothing to do until a window message.
+		MsgWaitForMultipleObjectsEx(0, nullptr, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
 	}
 	void OnDestroy() override;
 	void ToggleFullscreenWindow() override;
-	void ReceiveMsgToBroadcast(CommonMsg::Message msg) override
-	{
-		msg_queue_.Enqueue(std::move(msg));
-	}
 };
 
 int main()
@@ -55,6 +42,7 @@ int main()
 void SceneEngine::OnInit(HWND hWnd, UINT width, UINT height)
 {
 	LOG(main_log, ELog::Display, "OnInit");
+	Jobs::Initialize();
 	systems_.emplace_back(IRenderer::CreateSystem(hWnd, width, height, *this));
 	systems_.emplace_back(IRenderDataManager::CreateSystem());
 	systems_.emplace_back(IGameplay::CreateSystem());
@@ -86,10 +74,10 @@ void SceneEngine::OnDestroy()
 		system->Destroy();
 	}
 	systems_.clear();
+	Jobs::Shutdown();
 }
 
 void SceneEngine::ToggleFullscreenWindow()
 {
-	IRenderer::RT_MSG_ToogleFullScreen msg;
-	IRenderer::EnqueueMsg(msg);
+	IRenderer::EmplaceCommand<IRenderer::RT_CMD_ToogleFullScreen>();
 }
\ No newline at end of file
@@ -136,5 +136,20 @@ struct InstancesInNodeGPU
 {
 	using TIndex = uint32_t;
 	static constexpr TIndex kInvalid = Const::kInvalid32;
-	std::array<TIndex, Const::kMaxInstancesPerNode> instances = { kInvalid };
-};
\ No newline at end of file
+	std::array<TIndex, Const::kMaxInstancesPerNode> instances;
+
+	InstancesInNodeGPU() { instances.fill(kInvalid); }
+};
+
+// Inner node of the 4-wide BVH over the static nodes. The bounds of the children are stored per axis, one lane per
+// child, so a child test is 4-wide on the CPU and the GPU.
+struct BvhNodeGPU
+{
+	static constexpr uint32_t kWidth = 4;
+	static constexpr uint32_t kLeafFlag = 0x80000000;	// the child is a static node, not an inner node
+
+	XMFLOAT4 min_x, min_y, min_z;
+	XMFLOAT4 max_x, max_y, max_z;
+	std::array<uint32_t, kWidth> children = { Const::kInvalid32, Const::kInvalid32, Const::kInvalid32, Const::kInvalid32 };
+};
+static_assert(sizeof(BvhNodeGPU) % 16 == 0, "GPU structured buffer stride");
\ No newline at end of file
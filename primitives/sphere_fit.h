@@ -0,0 +1,105 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <algorithm>
+#include <assert.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+namespace SphereFit
+{
+	constexpr std::size_t kMaxSpheres = 64;
+
+	namespace Detail
+	{
+		inline float HorizontalMin(DirectX::FXMVECTOR v)
+		{
+			using namespace DirectX;
+			const XMVECTOR pairs = XMVectorMin(v, XMVectorSwizzle<1, 0, 3, 2>(v));
+			return XMVectorGetX(XMVectorMin(pairs, XMVectorSwizzle<2, 3, 0, 1>(pairs)));
+		}
+
+		inline float HorizontalMax(DirectX::FXMVECTOR v)
+		{
+			using namespace DirectX;
+			const XMVECTOR pairs = XMVectorMax(v, XMVectorSwizzle<1, 0, 3, 2>(v));
+			return XMVectorGetX(XMVectorMax(pairs, XMVectorSwizzle<2, 3, 0, 1>(pairs)));
+		}
+	}
+
+	// Near minimal sphere enclosing all the spheres. Two enclosing candidates are built, the smaller one is returned:
+	// - centered in the bounding box of the spheres, with the exact radius for that center. The spheres are
+	//   transposed, so both passes process 4 spheres per vector.
+	// - grown from the largest sphere by merging the others (Ritter).
+	inline DirectX::BoundingSphere Enclose(std::span<const DirectX::BoundingSphere> spheres)
+	{
+		using namespace DirectX;
+		assert(!spheres.empty() && (spheres.size() <= kMaxSpheres));
+		constexpr std::size_t kMaxGroups = kMaxSpheres / 4;
+		const std::size_t groups_num = (spheres.size() + 3) / 4;
+
+		// The last group is padded with the last sphere, it doesn't change the result.
+		std::array<XMVECTOR, kMaxGroups> xs, ys, zs, rs;
+		for (std::size_t group = 0; group < groups_num; group++)
+		{
+			XMFLOAT4A x, y, z, r;
+			for (std::size_t lane = 0; lane < 4; lane++)
+			{
+				const BoundingSphere& sphere = spheres[std::min(group * 4 + lane, spheres.size() - 1)];
+				(&x.x)[lane] = sphere.Center.x;
+				(&y.x)[lane] = sphere.Center.y;
+				(&z.x)[lane] = sphere.Center.z;
+				(&r.x)[lane] = sphere.Radius;
+			}
+			xs[group] = XMLoadFloat4A(&x);
+			ys[group] = XMLoadFloat4A(&y);
+			zs[group] = XMLoadFloat4A(&z);
+			rs[group] = XMLoadFloat4A(&r);
+		}
+
+		XMVECTOR min_x = XMVectorSubtract(xs[0], rs[0]), max_x = XMVectorAdd(xs[0], rs[0]);
+		XMVECTOR min_y = XMVectorSubtract(ys[0], rs[0]), max_y = XMVectorAdd(ys[0], rs[0]);
+		XMVECTOR min_z = XMVectorSubtract(zs[0], rs[0]), max_z = XMVectorAdd(zs[0], rs[0]);
+		for (std::size_t group = 1; group < groups_num; group++)
+		{
+			min_x = XMVectorMin(min_x, XMVectorSubtract(xs[group], rs[group]));
+			max_x = XMVectorMax(max_x, XMVectorAdd(xs[group], rs[group]));
+			min_y = XMVectorMin(min_y, XMVectorSubtract(ys[group], rs[group]));
+			max_y = XMVectorMax(max_y, XMVectorAdd(ys[group], rs[group]));
+			min_z = XMVectorMin(min_z, XMVectorSubtract(zs[group], rs[group]));
+			max_z = XMVectorMax(max_z, XMVectorAdd(zs[group], rs[group]));
+		}
+		const XMFLOAT3 center(
+			(Detail::HorizontalMin(min_x) + Detail::HorizontalMax(max_x)) * 0.5f,
+			(Detail::HorizontalMin(min_y) + Detail::HorizontalMax(max_y)) * 0.5f,
+			(Detail::HorizontalMin(min_z) + Detail::HorizontalMax(max_z)) * 0.5f);
+
+		const XMVECTOR cx = XMVectorReplicate(center.x);
+		const XMVECTOR cy = XMVectorReplicate(center.y);
+		const XMVECTOR cz = XMVectorReplicate(center.z);
+		XMVECTOR extent = XMVectorZero();
+		for (std::size_t group = 0; group < groups_num; group++)
+		{
+			const XMVECTOR dx = XMVectorSubtract(xs[group], cx);
+			const XMVECTOR dy = XMVectorSubtract(ys[group], cy);
+			const XMVECTOR dz = XMVectorSubtract(zs[group], cz);
+			const XMVECTOR dist_sq = XMVectorMultiplyAdd(dz, dz, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dx, dx)));
+			extent = XMVectorMax(extent, XMVectorAdd(XMVectorSqrt(dist_sq), rs[group]));
+		}
+		const BoundingSphere boxed(center, Detail::HorizontalMax(extent));
+
+		const auto largest = std::max_element(spheres.begin(), spheres.end(),
+			[](const BoundingSphere& a, const BoundingSphere& b) { return a.Radius < b.Radius; });
+		BoundingSphere grown = *largest;
+		for (const BoundingSphere& sphere : spheres)
+		{
+			if (grown.Contains(sphere) != CONTAINS)
+			{
+				BoundingSphere::CreateMerged(grown, grown, sphere);
+			}
+		}
+
+		return (grown.Radius < boxed.Radius) ? grown : boxed;
+	}
+}
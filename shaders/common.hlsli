@@ -82,3 +82,17 @@ struct BoundingSphere
 	float3 center;
 	float radius;
 };
+
+#define BVH_LEAF_FLAG 0x80000000
+// Per axis bounds, one lane per child. A child is an inner node index, a static node index with BVH_LEAF_FLAG,
+// or 0xFFFFFFFF when empty.
+struct BvhNode
+{
+	float4 min_x;
+	float4 min_y;
+	float4 min_z;
+	float4 max_x;
+	float4 max_y;
+	float4 max_z;
+	uint4 children;
+};
@@ -28,11 +28,13 @@ public:
 protected:
 	Entity triangle_instance_;
 	
-	void operator()(GP_MSG_MeshLoaded) {}
-	void operator()(GP_MSG_MaterialLoaded) {}
+	void operator()(GP_MSG_MeshLoaded&) {}
+	void operator()(GP_MSG_MaterialLoaded&) {}
 
-	void HandleSingleMessage(GP_MSG& msg) override { std::visit([&](auto&& arg) { (*this)(arg); }, msg); }
+	void HandleSingleMessage(GP_MSG& msg) override { std::visit([&](auto& arg) { (*this)(arg); }, msg); }
 	void Tick() override {}
+	ETickMode GetTickMode() const override { return ETickMode::OnMessage; }
+	EExecution GetExecution() const override { return EExecution::Pooled; }
 	void ThreadInitialize() override 
 	{
 		std::shared_ptr<Mesh> triangle_mesh_ = std::make_shared<Mesh>();
@@ -1,10 +1,11 @@
 #pragma once
 
 #include "rdm_base.h"
+#include "hierarchical_bitmap.h"
 
 class MeshManager
 {
-	Bitset2::bitset2<Const::kMeshCapacity> free_mesh_slots_;
+	HierarchicalBitmap<Const::kMeshCapacity> free_mesh_slots_;
 	std::vector<std::shared_ptr<Mesh>> pending_remove_;
 	std::vector<std::shared_ptr<Mesh>> pending_add_;
 
@@ -22,14 +23,14 @@ class MeshManager
 	}
 
 public:
-	MeshManager() { free_mesh_slots_.set(); }
+	MeshManager() { free_mesh_slots_.set_all(); }
 
 	void Add(std::shared_ptr<Mesh> mesh)
 	{
 		assert(mesh);
-		const auto free_slot = free_mesh_slots_.find_first();
-		assert(free_slot != Bitset2::bitset2<Const::kMeshCapacity>::npos);
-		free_mesh_slots_.set(free_slot, false);
+		const auto free_slot = free_mesh_slots_.find_first_set();
+		assert(free_slot != decltype(free_mesh_slots_)::npos);
+		free_mesh_slots_.clear(free_slot);
 		assert(mesh->index == Const::kInvalid32);
 		mesh->index = static_cast<uint32_t>(free_slot);
 		pending_add_.push_back(mesh);
@@ -42,13 +43,15 @@ public:
 		pending_remove_.push_back(mesh);
 	}
 
+	bool HasPendingRemove() const { return !pending_remove_.empty(); }
+
 	void FlushPendingRemove()
 	{
 		for (auto mesh : pending_remove_)
 		{
 			assert(mesh->index != Const::kInvalid32);
 			assert(!free_mesh_slots_[mesh->index]);
-			free_mesh_slots_.set(mesh->index, true);
+			free_mesh_slots_.set(mesh->index);
 			mesh->index = Const::kInvalid32;
 			mesh->added_in_batch = Const::kInvalid32;
 		}
@@ -59,7 +62,7 @@ public:
 	{
 		FlushPendingRemove();
 		pending_add_.clear();
-		free_mesh_slots_.set();
+		free_mesh_slots_.set_all();
 	}
 
 	EUpdateResult Update(StructBuffer& mesh_buffer, ID3D12GraphicsCommandList* command_list, UploadBuffer& upload_buffer)
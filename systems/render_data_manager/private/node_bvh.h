@@ -0,0 +1,269 @@
+#pragma once
+
+#include "rdm_base.h"
+#include <vector>
+#include <span>
+#include <cfloat>
+
+// 4-wide BVH over the static nodes, built top-down with a binned SAH. The inner nodes are stored in a flat array in
+// depth first order, root first, in the layout of BvhNodeGPU, so a whole subtree outside of the frustum is rejected
+// with a single test. Cull is the CPU reference traversal.
+class NodeBvh
+{
+	static constexpr uint32_t kBins = 16;
+	static constexpr uint32_t kMinBinnedSize = 8;	// smaller ranges are split at the median, binning costs more
+	static constexpr uint32_t kMaxDepth = 64;
+
+	struct Bounds
+	{
+		XMFLOAT3 min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		void Grow(const XMFLOAT3& point)
+		{
+			min = XMFLOAT3(std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z));
+			max = XMFLOAT3(std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z));
+		}
+
+		void Grow(const Bounds& other)
+		{
+			min = XMFLOAT3(std::min(min.x, other.min.x), std::min(min.y, other.min.y), std::min(min.z, other.min.z));
+			max = XMFLOAT3(std::max(max.x, other.max.x), std::max(max.y, other.max.y), std::max(max.z, other.max.z));
+		}
+
+		float Area() const
+		{
+			if (min.x > max.x)
+				return 0.0f;
+			const XMFLOAT3 size(max.x - min.x, max.y - min.y, max.z - min.z);
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+
+		static float Axis(const XMFLOAT3& v, uint32_t axis) { return (&v.x)[axis]; }
+	};
+
+	struct Primitive
+	{
+		Bounds bounds;
+		XMFLOAT3 centroid;
+		uint32_t node_idx = Const::kInvalid32;
+	};
+
+	struct Range
+	{
+		uint32_t begin = 0;
+		uint32_t end = 0;
+		Bounds bounds;
+
+		uint32_t Size() const { return end - begin; }
+	};
+
+	std::vector<BvhNodeGPU> nodes_;
+	std::vector<Primitive> primitives_;
+
+	Bounds GetBounds(uint32_t begin, uint32_t end) const
+	{
+		Bounds bounds;
+		for (uint32_t idx = begin; idx < end; idx++)
+		{
+			bounds.Grow(primitives_[idx].bounds);
+		}
+		return bounds;
+	}
+
+	// Splits the range in two with the lowest SAH cost, binned along the longest axis of the centroids.
+	// Falls back to the median, for small ranges, or when the centroids don't spread.
+	std::pair<Range, Range> Split(const Range& range)
+	{
+		assert(range.Size() > 1);
+		Bounds centroids;
+		for (uint32_t idx = range.begin; idx < range.end; idx++)
+		{
+			centroids.Grow(primitives_[idx].centroid);
+		}
+		const XMFLOAT3 extent(centroids.max.x - centroids.min.x, centroids.max.y - centroids.min.y, centroids.max.z - centroids.min.z);
+		const uint32_t axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+		const float axis_min = Bounds::Axis(centroids.min, axis);
+		const float axis_extent = Bounds::Axis(extent, axis);
+
+		if ((axis_extent > 0.0f) && (range.Size() >= kMinBinnedSize))
+		{
+			const float bin_scale = kBins / axis_extent;
+			auto get_bin = [&](const Primitive& primitive)
+			{
+				const float offset = (Bounds::Axis(primitive.centroid, axis) - axis_min) * bin_scale;
+				return std::min(static_cast<uint32_t>(offset), kBins - 1);
+			};
+			std::array<Bounds, kBins> bin_bounds;
+			std::array<uint32_t, kBins> bin_count = {};
+			for (uint32_t idx = range.begin; idx < range.end; idx++)
+			{
+				const uint32_t bin = get_bin(primitives_[idx]);
+				bin_bounds[bin].Grow(primitives_[idx].bounds);
+				bin_count[bin]++;
+			}
+
+			// Split after the bin idx costs: area of the left side * its count + the same for the right side.
+			std::array<Bounds, kBins - 1> left_bounds, right_bounds;
+			std::array<float, kBins - 1> cost = {};
+			Bounds left, right;
+			uint32_t left_count = 0, right_count = 0;
+			for (uint32_t idx = 0; idx < (kBins - 1); idx++)
+			{
+				left.Grow(bin_bounds[idx]);
+				left_count += bin_count[idx];
+				left_bounds[idx] = left;
+				cost[idx] = left.Area() * left_count;
+			}
+			for (uint32_t idx = kBins - 1; idx > 0; idx--)
+			{
+				right.Grow(bin_bounds[idx]);
+				right_count += bin_count[idx];
+				right_bounds[idx - 1] = right;
+				cost[idx - 1] += right.Area() * right_count;
+			}
+			const uint32_t best_split = static_cast<uint32_t>(std::distance(cost.begin(), std::min_element(cost.begin(), cost.end())));
+
+			Primitive* const split = std::partition(primitives_.data() + range.begin, primitives_.data() + range.end,
+				[&](const Primitive& primitive) { return get_bin(primitive) <= best_split; });
+			const uint32_t mid = static_cast<uint32_t>(split - primitives_.data());
+			if ((mid != range.begin) && (mid != range.end))
+				return { Range{ range.begin, mid, left_bounds[best_split] }, Range{ mid, range.end, right_bounds[best_split] } };
+		}
+		const uint32_t mid = range.begin + range.Size() / 2;
+		std::nth_element(primitives_.data() + range.begin, primitives_.data() + mid, primitives_.data() + range.end,
+			[&](const Primitive& a, const Primitive& b) { return Bounds::Axis(a.centroid, axis) < Bounds::Axis(b.centroid, axis); });
+		return { Range{ range.begin, mid, GetBounds(range.begin, mid) }, Range{ mid, range.end, GetBounds(mid, range.end) } };
+	}
+
+	uint32_t BuildNode(const Range& range, uint32_t depth)
+	{
+		assert(depth < kMaxDepth);
+		const uint32_t node_idx = static_cast<uint32_t>(nodes_.size());
+		nodes_.emplace_back();
+
+		// Collapse the binary splits: split the child with the largest area, until there are kWidth children.
+		std::array<Range, BvhNodeGPU::kWidth> children;
+		uint32_t children_num = 1;
+		children[0] = range;
+		while (children_num < BvhNodeGPU::kWidth)
+		{
+			uint32_t to_split = Const::kInvalid32;
+			for (uint32_t idx = 0; idx < children_num; idx++)
+			{
+				if ((children[idx].Size() > 1) && ((to_split == Const::kInvalid32) || (children[idx].bounds.Area() > children[to_split].bounds.Area())))
+				{
+					to_split = idx;
+				}
+			}
+			if (to_split == Const::kInvalid32)
+				break;
+			std::tie(children[to_split], children[children_num]) = Split(children[to_split]);
+			children_num++;
+		}
+
+		for (uint32_t idx = 0; idx < children_num; idx++)
+		{
+			const Range& child = children[idx];
+			const uint32_t child_ref = (child.Size() == 1)
+				? (primitives_[child.begin].node_idx | BvhNodeGPU::kLeafFlag)
+				: BuildNode(child, depth + 1);
+			// nodes_ may be reallocated by the recursion.
+			BvhNodeGPU& node = nodes_[node_idx];
+			(&node.min_x.x)[idx] = child.bounds.min.x;
+			(&node.min_y.x)[idx] = child.bounds.min.y;
+			(&node.min_z.x)[idx] = child.bounds.min.z;
+			(&node.max_x.x)[idx] = child.bounds.max.x;
+			(&node.max_y.x)[idx] = child.bounds.max.y;
+			(&node.max_z.x)[idx] = child.bounds.max.z;
+			node.children[idx] = child_ref;
+		}
+		for (uint32_t idx = children_num; idx < BvhNodeGPU::kWidth; idx++)
+		{
+			// Empty bounds, never intersected.
+			BvhNodeGPU& node = nodes_[node_idx];
+			(&node.min_x.x)[idx] = (&node.min_y.x)[idx] = (&node.min_z.x)[idx] = FLT_MAX;
+			(&node.max_x.x)[idx] = (&node.max_y.x)[idx] = (&node.max_z.x)[idx] = -FLT_MAX;
+			node.children[idx] = Const::kInvalid32;
+		}
+		return node_idx;
+	}
+
+public:
+	// leaves[idx] is the sphere of the static node idx. Spheres with a non positive radius are skipped.
+	void Build(std::span<const BoundingSphere> leaves)
+	{
+		nodes_.clear();
+		primitives_.clear();
+		primitives_.reserve(leaves.size());
+		for (uint32_t idx = 0; idx < leaves.size(); idx++)
+		{
+			const BoundingSphere& sphere = leaves[idx];
+			if (sphere.Radius <= 0.0f)
+				continue;
+			Primitive& primitive = primitives_.emplace_back();
+			primitive.bounds.min = XMFLOAT3(sphere.Center.x - sphere.Radius, sphere.Center.y - sphere.Radius, sphere.Center.z - sphere.Radius);
+			primitive.bounds.max = XMFLOAT3(sphere.Center.x + sphere.Radius, sphere.Center.y + sphere.Radius, sphere.Center.z + sphere.Radius);
+			primitive.centroid = sphere.Center;
+			primitive.node_idx = idx;
+		}
+		if (primitives_.empty())
+			return;
+		nodes_.reserve(primitives_.size() / (BvhNodeGPU::kWidth - 1) + 1);
+		const uint32_t primitives_num = static_cast<uint32_t>(primitives_.size());
+		BuildNode(Range{ 0, primitives_num, GetBounds(0, primitives_num) }, 0);
+	}
+
+	std::span<const BvhNodeGPU> GetNodes() const { return nodes_; }
+
+	// Calls func(static_node_idx) for every leaf, whose bounds intersect the frustum. The 4 children of an inner
+	// node are tested together, against the frustum planes.
+	template<typename F>
+	void Cull(const BoundingFrustum& frustum, F&& func) const
+	{
+		if (nodes_.empty())
+			return;
+		// World space, the normals point out of the frustum.
+		XMVECTOR planes[6];
+		frustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+		std::array<uint32_t, kMaxDepth * BvhNodeGPU::kWidth> stack;
+		uint32_t stack_size = 0;
+		stack[stack_size++] = 0;
+		while (stack_size)
+		{
+			const BvhNodeGPU& node = nodes_[stack[--stack_size]];
+			const XMVECTOR min_x = XMLoadFloat4(&node.min_x), min_y = XMLoadFloat4(&node.min_y), min_z = XMLoadFloat4(&node.min_z);
+			const XMVECTOR max_x = XMLoadFloat4(&node.max_x), max_y = XMLoadFloat4(&node.max_y), max_z = XMLoadFloat4(&node.max_z);
+			// A box is outside, when its corner nearest to the inside of a plane is in front of the plane.
+			const XMVECTOR zero = XMVectorZero();
+			XMVECTOR outside = XMVectorFalseInt();
+			for (const XMVECTOR& plane : planes)
+			{
+				const XMVECTOR nx = XMVectorSplatX(plane), ny = XMVectorSplatY(plane), nz = XMVectorSplatZ(plane);
+				const XMVECTOR px = XMVectorSelect(max_x, min_x, XMVectorGreater(nx, zero));
+				const XMVECTOR py = XMVectorSelect(max_y, min_y, XMVectorGreater(ny, zero));
+				const XMVECTOR pz = XMVectorSelect(max_z, min_z, XMVectorGreater(nz, zero));
+				const XMVECTOR dist = XMVectorMultiplyAdd(nz, pz, XMVectorMultiplyAdd(ny, py, XMVectorMultiplyAdd(nx, px, XMVectorSplatW(plane))));
+				outside = XMVectorOrInt(outside, XMVectorGreater(dist, zero));
+			}
+			uint32_t lanes[4];
+			XMStoreInt4(lanes, outside);
+			for (uint32_t idx = 0; idx < BvhNodeGPU::kWidth; idx++)
+			{
+				const uint32_t child = node.children[idx];
+				if ((child == Const::kInvalid32) || lanes[idx])
+					continue;
+				if (child & BvhNodeGPU::kLeafFlag)
+				{
+					func(child & ~BvhNodeGPU::kLeafFlag);
+				}
+				else
+				{
+					assert(stack_size < stack.size());
+					stack[stack_size++] = child;
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "rdm_base.h"
+#include "small_container.h"
+#include <unordered_map>
+#include <cmath>
+
+// Hashed uniform grid over the node centers, so SceneManager::AddToHierarchy checks only the nodes near an instance.
+// Nodes are bucketed into levels by the power of two of their radius. The cell size of a level is its largest radius,
+// so a query visits only the levels within the wanted radius range, and the cells within the search distance.
+// Cell coordinates wrap in the key, distant cells may share a bucket, so candidates are only candidates.
+class NodeGrid
+{
+	static constexpr uint64_t kNoKey = ~uint64_t(0);
+	static constexpr int32_t kMinLevel = -32;
+	static constexpr int32_t kMaxLevel = 31;
+	static constexpr uint32_t kCoordBits = 19;
+	static constexpr uint64_t kCoordMask = (uint64_t(1) << kCoordBits) - 1;
+
+	using TNodeIndex = uint16_t;
+	static_assert(Const::kStaticNodesCapacity <= 0x10000, "node index doesn't fit");
+
+	std::unordered_map<uint64_t, small_container<TNodeIndex, 4>> cells_;
+	std::array<uint64_t, Const::kStaticNodesCapacity> node_keys_;
+	// Nodes per level, empty levels are not probed.
+	std::array<uint32_t, kMaxLevel - kMinLevel + 1> level_nodes_ = {};
+
+	static int32_t GetLevel(float radius)
+	{
+		return (radius > 0.0f) ? std::clamp(std::ilogb(radius), kMinLevel, kMaxLevel) : kMinLevel;
+	}
+
+	static float GetCellSize(int32_t level) { return std::ldexp(1.0f, level + 1); }
+
+	static int64_t ToCell(float coord, float cell_size) { return static_cast<int64_t>(std::floor(coord / cell_size)); }
+
+	static uint64_t MakeKey(int32_t level, int64_t x, int64_t y, int64_t z)
+	{
+		return (uint64_t(level - kMinLevel) << (3 * kCoordBits))
+			| ((uint64_t(x) & kCoordMask) << (2 * kCoordBits))
+			| ((uint64_t(y) & kCoordMask) << kCoordBits)
+			| (uint64_t(z) & kCoordMask);
+	}
+
+	static int32_t GetLevel(uint64_t key) { return static_cast<int32_t>(key >> (3 * kCoordBits)) + kMinLevel; }
+
+	static uint64_t MakeKey(const BoundingSphere& node)
+	{
+		const int32_t level = GetLevel(node.Radius);
+		const float cell_size = GetCellSize(level);
+		return MakeKey(level, ToCell(node.Center.x, cell_size), ToCell(node.Center.y, cell_size), ToCell(node.Center.z, cell_size));
+	}
+
+	void Insert(uint32_t node_idx, uint64_t key)
+	{
+		cells_[key].add(static_cast<TNodeIndex>(node_idx));
+		node_keys_[node_idx] = key;
+		level_nodes_[GetLevel(key) - kMinLevel]++;
+	}
+
+public:
+	NodeGrid() { node_keys_.fill(kNoKey); }
+
+	bool Contains(uint32_t node_idx) const { return node_keys_[node_idx] != kNoKey; }
+
+	// Inserts the node, or moves it to the cell of its current sphere.
+	void Update(uint32_t node_idx, const BoundingSphere& node)
+	{
+		const uint64_t key = MakeKey(node);
+		if (node_keys_[node_idx] == key)
+			return;
+		if (Contains(node_idx))
+		{
+			Remove(node_idx);
+		}
+		Insert(node_idx, key);
+	}
+
+	void Remove(uint32_t node_idx)
+	{
+		assert(Contains(node_idx));
+		level_nodes_[GetLevel(node_keys_[node_idx]) - kMinLevel]--;
+		const auto found_cell = cells_.find(node_keys_[node_idx]);
+		assert(found_cell != cells_.end());
+		auto& cell = found_cell->second;
+		TNodeIndex* const found = std::find(cell.begin(), cell.end(), static_cast<TNodeIndex>(node_idx));
+		assert(found != cell.end());
+		cell.remove(cell.iterator_to_index(found), true);
+		if (!cell.size())
+		{
+			cells_.erase(found_cell);
+		}
+		node_keys_[node_idx] = kNoKey;
+	}
+
+	// The node was moved to another slot, its sphere didn't change.
+	void Move(uint32_t from_idx, uint32_t to_idx)
+	{
+		assert(!Contains(to_idx));
+		const uint64_t key = node_keys_[from_idx];
+		Remove(from_idx);
+		Insert(to_idx, key);
+	}
+
+	void Clear()
+	{
+		cells_.clear();
+		node_keys_.fill(kNoKey);
+		level_nodes_.fill(0);
+	}
+
+	// Calls func(node_idx) for every node, that may have its center closer than distance, and a radius within
+	// (min_radius, max_radius). Returns false without any call, when it would probe more than max_probes cells.
+	template<typename F>
+	bool ForEachCandidate(const float3& center, float distance, float min_radius, float max_radius, uint32_t max_probes, F&& func) const
+	{
+		const int32_t min_level = GetLevel(min_radius);
+		const int32_t max_level = GetLevel(max_radius);
+		uint64_t probes = 0;
+		for (int32_t level = min_level; level <= max_level; level++)
+		{
+			if (!level_nodes_[level - kMinLevel])
+				continue;
+			const float cell_size = GetCellSize(level);
+			auto cells_num = [&](float coord) { return uint64_t(ToCell(coord + distance, cell_size) - ToCell(coord - distance, cell_size) + 1); };
+			probes += cells_num(center.x) * cells_num(center.y) * cells_num(center.z);
+			if (probes > max_probes)
+				return false;
+		}
+		for (int32_t level = min_level; level <= max_level; level++)
+		{
+			if (!level_nodes_[level - kMinLevel])
+				continue;
+			const float cell_size = GetCellSize(level);
+			for (int64_t x = ToCell(center.x - distance, cell_size); x <= ToCell(center.x + distance, cell_size); x++)
+			{
+				for (int64_t y = ToCell(center.y - distance, cell_size); y <= ToCell(center.y + distance, cell_size); y++)
+				{
+					for (int64_t z = ToCell(center.z - distance, cell_size); z <= ToCell(center.z + distance, cell_size); z++)
+					{
+						const auto found = cells_.find(MakeKey(level, x, y, z));
+						if (found == cells_.end())
+							continue;
+						for (const TNodeIndex node_idx : found->second)
+						{
+							func(uint32_t(node_idx));
+						}
+					}
+				}
+			}
+		}
+		return true;
+	}
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "rdm_base.h"
+#include "jobs/jobs.h"
+#include <vector>
+#include <memory_resource>
+#include <span>
+#include <array>
+#include <bit>
+#include <cfloat>
+
+// Bulk clustering of instances into nodes, LBVH style. The instances are sorted by the Morton code of their centers,
+// then the sorted range is split at the highest bit, in which its first and last codes differ, until a part fits in
+// a node. So every node covers a single octree cell, and the nodes come out in Morton order: nodes close in memory
+// are close in space.
+namespace NodeLbvh
+{
+	constexpr uint32_t kRadixBits = 8;
+	constexpr uint32_t kRadixSize = 1 << kRadixBits;
+	constexpr uint32_t kBatchSize = 2048;
+	// 10 bits per axis (a 30 bit code) are enough, unless the scene is over 1024 instances wide.
+	constexpr uint32_t kNarrowAxisBits = 10;
+	constexpr uint32_t kWideAxisBits = 21;
+
+	struct Key
+	{
+		uint64_t code = 0;
+		uint32_t idx = 0;
+	};
+
+	struct Leaf
+	{
+		uint32_t begin = 0;
+		uint32_t end = 0;
+
+		uint32_t Size() const { return end - begin; }
+	};
+
+	struct Clusters
+	{
+		std::pmr::vector<uint32_t> order;	// indices of the input spheres, in Morton order
+		std::pmr::vector<Leaf> leaves;		// ranges of order, in Morton order
+
+		explicit Clusters(std::pmr::memory_resource* resource) : order(resource), leaves(resource) {}
+	};
+
+	// Inserts two zero bits after each of the lower 21 bits.
+	inline uint64_t Spread(uint64_t v)
+	{
+		v &= 0x1fffff;
+		v = (v | (v << 32)) & 0x001f00000000ffffull;
+		v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+		v = (v | (v << 8)) & 0x100f00f00f00f00full;
+		v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+		v = (v | (v << 2)) & 0x1249249249249249ull;
+		return v;
+	}
+
+	inline uint64_t Encode(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return (Spread(x) << 2) | (Spread(y) << 1) | Spread(z);
+	}
+
+	// Stable LSD radix sort by the lower code_bits of the codes. Every pass counts the digits of a block per job, then
+	// scatters the blocks in parallel to their offsets. Passes, in which all the keys share the digit, are skipped.
+	// The scratch memory comes from the resource of keys.
+	inline void SortByCode(std::pmr::vector<Key>& keys, uint32_t code_bits)
+	{
+		const uint32_t keys_num = static_cast<uint32_t>(keys.size());
+		if (keys_num < 2)
+			return;
+		const uint32_t blocks_num = std::clamp((keys_num + kBatchSize - 1) / kBatchSize, 1u, Jobs::NumWorkers() + 1);
+		const uint32_t block_size = (keys_num + blocks_num - 1) / blocks_num;
+		std::pmr::vector<std::array<uint32_t, kRadixSize>> offsets(blocks_num, keys.get_allocator());
+		std::pmr::vector<Key> temp(keys_num, keys.get_allocator());
+		Key* src = keys.data();
+		Key* dst = temp.data();
+		for (uint32_t shift = 0; shift < code_bits; shift += kRadixBits)
+		{
+			auto digit = [shift](const Key& key) { return static_cast<uint32_t>(key.code >> shift) & (kRadixSize - 1); };
+			Jobs::ParallelFor(blocks_num, 1, [&](uint32_t block)
+			{
+				std::array<uint32_t, kRadixSize>& counts = offsets[block];
+				counts.fill(0);
+				const uint32_t end = std::min(keys_num, (block + 1) * block_size);
+				for (uint32_t idx = block * block_size; idx < end; idx++)
+				{
+					counts[digit(src[idx])]++;
+				}
+			});
+
+			// Digit major, block minor, so the keys with the same digit keep their order.
+			bool single_digit = false;
+			uint32_t offset = 0;
+			for (uint32_t value = 0; value < kRadixSize; value++)
+			{
+				const uint32_t first = offset;
+				for (std::array<uint32_t, kRadixSize>& counts : offsets)
+				{
+					const uint32_t count = counts[value];
+					counts[value] = offset;
+					offset += count;
+				}
+				single_digit |= (offset - first) == keys_num;
+			}
+			if (single_digit)
+				continue;
+
+			Jobs::ParallelFor(blocks_num, 1, [&](uint32_t block)
+			{
+				std::array<uint32_t, kRadixSize>& block_offsets = offsets[block];
+				const uint32_t end = std::min(keys_num, (block + 1) * block_size);
+				for (uint32_t idx = block * block_size; idx < end; idx++)
+				{
+					dst[block_offsets[digit(src[idx])]++] = src[idx];
+				}
+			});
+			std::swap(src, dst);
+		}
+		if (src != keys.data())
+		{
+			keys.swap(temp);
+		}
+	}
+
+	// Splits the sorted keys [begin, end) at the highest differing code bit, or in the middle when all the codes are
+	// equal, until a part has at most max_leaf_size keys.
+	inline void Split(const std::pmr::vector<Key>& keys, uint32_t begin, uint32_t end, uint32_t max_leaf_size, std::pmr::vector<Leaf>& leaves)
+	{
+		if (end - begin <= max_leaf_size)
+		{
+			leaves.push_back(Leaf{ begin, end });
+			return;
+		}
+		const uint64_t first_code = keys[begin].code;
+		const uint64_t diff = first_code ^ keys[end - 1].code;
+		uint32_t split = begin + (end - begin) / 2;
+		if (diff)
+		{
+			const uint64_t split_bit = uint64_t(1) << (63 - std::countl_zero(diff));
+			const auto found = std::partition_point(keys.begin() + begin, keys.begin() + end,
+				[&](const Key& key) { return !((key.code ^ first_code) & split_bit); });
+			split = static_cast<uint32_t>(found - keys.begin());
+		}
+		assert((split > begin) && (split < end));
+		Split(keys, begin, split, max_leaf_size, leaves);
+		Split(keys, split, end, max_leaf_size, leaves);
+	}
+
+	// The octree cells may leave nodes half empty. When there would be more than max_leaves leaves, the sorted range
+	// is cut into full leaves instead, still in Morton order. The result and the scratch memory come from resource.
+	inline Clusters Build(std::span<const BoundingSphere> spheres, uint32_t max_leaf_size, uint32_t max_leaves,
+		std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+	{
+		Clusters clusters(resource);
+		const uint32_t spheres_num = static_cast<uint32_t>(spheres.size());
+		if (!spheres_num)
+			return clusters;
+		assert(max_leaf_size && (spheres_num <= uint64_t(max_leaf_size) * max_leaves));
+
+		XMFLOAT3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		float min_radius = FLT_MAX;
+		for (const BoundingSphere& sphere : spheres)
+		{
+			min = XMFLOAT3(std::min(min.x, sphere.Center.x), std::min(min.y, sphere.Center.y), std::min(min.z, sphere.Center.z));
+			max = XMFLOAT3(std::max(max.x, sphere.Center.x), std::max(max.y, sphere.Center.y), std::max(max.z, sphere.Center.z));
+			min_radius = std::min(min_radius, sphere.Radius);
+		}
+		const float extent = std::max({ max.x - min.x, max.y - min.y, max.z - min.z, FLT_MIN });
+		const uint32_t axis_bits = (extent <= float(1 << kNarrowAxisBits) * 2.0f * min_radius) ? kNarrowAxisBits : kWideAxisBits;
+		const float max_cell = float((1u << axis_bits) - 1);
+		const float scale = max_cell / extent;
+
+		std::pmr::vector<Key> keys(spheres_num, resource);
+		Jobs::ParallelFor(spheres_num, kBatchSize, [&](uint32_t idx)
+		{
+			const XMFLOAT3& center = spheres[idx].Center;
+			auto cell = [&](float coord, float min_coord) { return static_cast<uint32_t>(std::clamp((coord - min_coord) * scale, 0.0f, max_cell)); };
+			keys[idx] = Key{ Encode(cell(center.x, min.x), cell(center.y, min.y), cell(center.z, min.z)), idx };
+		});
+		SortByCode(keys, 3 * axis_bits);
+
+		Split(keys, 0, spheres_num, max_leaf_size, clusters.leaves);
+		if (clusters.leaves.size() > max_leaves)
+		{
+			clusters.leaves.clear();
+			for (uint32_t begin = 0; begin < spheres_num; begin += max_leaf_size)
+			{
+				clusters.leaves.push_back(Leaf{ begin, std::min(spheres_num, begin + max_leaf_size) });
+			}
+		}
+
+		clusters.order.resize(spheres_num);
+		for (uint32_t idx = 0; idx < spheres_num; idx++)
+		{
+			clusters.order[idx] = keys[idx].idx;
+		}
+		return clusters;
+	}
+}
@@ -35,9 +35,10 @@ namespace IRenderDataManager
 }
 using namespace IRenderDataManager;
 
-struct RDM_MSG_AddComponent { MeshComponent* component = nullptr; };
-struct RDM_MSG_RemoveComponent { MeshComponent* component = nullptr; };
-using RDM_MSG = std::variant<RDM_MSG_AddComponent, RDM_MSG_RemoveComponent>;
+struct RDM_MSG_AddComponent { MeshComponentHandle component; };
+struct RDM_MSG_RemoveComponent { MeshComponentHandle component; };
+struct RDM_MSG_UpdateTransform { MeshComponentHandle component; Transform transform; };
+using RDM_MSG = std::variant<RDM_MSG_AddComponent, RDM_MSG_RemoveComponent, RDM_MSG_UpdateTransform>;
 
 enum class EUpdateResult
 {
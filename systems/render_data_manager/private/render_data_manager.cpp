@@ -4,36 +4,33 @@
 #include "scene_manager.h"
 #include "small_container.h"
 #include "stat/stat.h"
+#include "config/config.h"
 #include "primitives/mesh_data.h"
 #include "common/utils.h"
 
+struct SyncFence;
+
+// Lists are recorded with allocators used round-robin, so a new list can be opened while the previous ones still execute.
 struct GPUCommands
 {
 private:
+	static constexpr uint32_t kAllocatorsNum = 3;
+
 	ComPtr<ID3D12GraphicsCommandList> copy_command_list_;
 	ComPtr<ID3D12CommandQueue> copy_queue_;
-	ComPtr<ID3D12CommandAllocator> copy_command_allocator_;
+	ComPtr<ID3D12CommandAllocator> copy_command_allocators_[kAllocatorsNum];
+	uint64_t allocator_fence_values_[kAllocatorsNum] = {};	// signaled after the last list recorded with the allocator
+	uint32_t active_allocator_ = 0;
 	bool command_list_open_ = false;
 
 	friend struct SyncFence;
 
 public:
-	void Reopen()
-	{
-		if (command_list_open_)
-			return;
-		ThrowIfFailed(copy_command_allocator_->Reset());
-		ThrowIfFailed(copy_command_list_->Reset(copy_command_allocator_.Get(), nullptr));
-		command_list_open_ = true;
-	}
+	// Blocks only when the GPU still executes a list recorded with the next allocator.
+	void Reopen(SyncFence& fence);
 
-	void Execute()
-	{
-		ThrowIfFailed(copy_command_list_->Close());
-		ID3D12CommandList* ppCommandLists[] = { copy_command_list_.Get() };
-		copy_queue_->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-		command_list_open_ = false;
-	}
+	// Returns the fence value signaled after the list.
+	uint64_t Execute(SyncFence& fence);
 
 	void Create(ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type)
 	{
@@ -43,10 +40,14 @@ public:
 		ThrowIfFailed(device->CreateCommandQueue(&queue_desc, IID_PPV_ARGS(&copy_queue_)));
 		NAME_D3D12_OBJECT(copy_queue_);
 
-		ThrowIfFailed(device->CreateCommandAllocator(type, IID_PPV_ARGS(&copy_command_allocator_)));
-		NAME_D3D12_OBJECT(copy_command_allocator_);
+		for (uint32_t idx = 0; idx < kAllocatorsNum; idx++)
+		{
+			ThrowIfFailed(device->CreateCommandAllocator(type, IID_PPV_ARGS(&copy_command_allocators_[idx])));
+			NAME_D3D12_OBJECT_INDEXED(copy_command_allocators_, idx);
+		}
+		active_allocator_ = 0;
 
-		ThrowIfFailed(device->CreateCommandList(0, type, copy_command_allocator_.Get(), nullptr, IID_PPV_ARGS(&copy_command_list_)));
+		ThrowIfFailed(device->CreateCommandList(0, type, copy_command_allocators_[active_allocator_].Get(), nullptr, IID_PPV_ARGS(&copy_command_list_)));
 		NAME_D3D12_OBJECT(copy_command_list_);
 		command_list_open_ = true;
 	}
@@ -55,7 +56,10 @@ public:
 	{
 		copy_command_list_.Reset();
 		copy_queue_.Reset();
-		copy_command_allocator_.Reset();
+		for (ComPtr<ID3D12CommandAllocator>& allocator : copy_command_allocators_)
+		{
+			allocator.Reset();
+		}
 	}
 
 	ID3D12GraphicsCommandList* GetCommandList() { assert(copy_command_list_); return copy_command_list_.Get(); }
@@ -67,7 +71,6 @@ private:
 	ComPtr<ID3D12Fence> fence_;
 	HANDLE fence_event_ = 0;
 	uint64_t fence_value_ = 0;
-	std::future<IRenderer::SyncGPU> rt_future_;
 
 public:
 	void Create(ID3D12Device* device)
@@ -83,33 +86,37 @@ public:
 		fence_value_++;
 	}
 
-	void WaitForGPU(GPUCommands& commands)
+	uint64_t Signal(GPUCommands& commands)
 	{
 		ThrowIfFailed(commands.copy_queue_->Signal(fence_.Get(), fence_value_));
-		ThrowIfFailed(fence_->SetEventOnCompletion(fence_value_, fence_event_));
+		return fence_value_++;
+	}
+
+	uint64_t GetCompletedValue() const { return fence_->GetCompletedValue(); }
+
+	void WaitForValue(uint64_t value)
+	{
+		if (fence_->GetCompletedValue() >= value)
+			return;
+		ThrowIfFailed(fence_->SetEventOnCompletion(value, fence_event_));
 		WaitForSingleObjectEx(fence_event_, INFINITE, FALSE);
-		fence_value_++;
 	}
 
-	std::promise<IRenderer::SyncGPU> MakePromiseRT()
+	void WaitForGPU(GPUCommands& commands)
 	{
-		assert(!rt_future_.valid());
-		std::promise<IRenderer::SyncGPU> promise;
-		rt_future_ = promise.get_future();
-		assert(rt_future_.valid());
-		return promise;
+		WaitForValue(Signal(commands));
 	}
 
-	void WaitForRT(volatile bool& open)
+	void WaitForRT(const std::shared_future<IRenderer::SyncGPU>& rt_future, volatile bool& open)
 	{
-		assert(rt_future_.valid());
-		for (std::future_status status = std::future_status::deferred;
+		assert(rt_future.valid());
+		for (std::future_status status = rt_future.wait_for(Utils::Microsecond{ 0 });
 			(status != std::future_status::ready) && open;
-			status = rt_future_.wait_for(Utils::Microsecond{ 8000 }));
+			status = rt_future.wait_for(Utils::Microsecond{ 8000 }));
 		if (!open)
 			return;
-		assert(rt_future_.valid());
-		const auto [rt_fence, rt_fence_value] = rt_future_.get();
+		assert(rt_future.valid());
+		const auto [rt_fence, rt_fence_value] = rt_future.get();
 		assert(rt_fence);
 		if (rt_fence->GetCompletedValue() < rt_fence_value)
 		{
@@ -135,8 +142,31 @@ public:
 	}
 };
 
+void GPUCommands::Reopen(SyncFence& fence)
+{
+	if (command_list_open_)
+		return;
+	active_allocator_ = (active_allocator_ + 1) % kAllocatorsNum;
+	fence.WaitForValue(allocator_fence_values_[active_allocator_]);
+	ID3D12CommandAllocator* const allocator = copy_command_allocators_[active_allocator_].Get();
+	ThrowIfFailed(allocator->Reset());
+	ThrowIfFailed(copy_command_list_->Reset(allocator, nullptr));
+	command_list_open_ = true;
+}
+
+uint64_t GPUCommands::Execute(SyncFence& fence)
+{
+	ThrowIfFailed(copy_command_list_->Close());
+	ID3D12CommandList* ppCommandLists[] = { copy_command_list_.Get() };
+	copy_queue_->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	command_list_open_ = false;
+	const uint64_t fence_value = fence.Signal(*this);
+	allocator_fence_values_[active_allocator_] = fence_value;
+	return fence_value;
+}
+
 class RenderDataManager* render_data_manager = nullptr;
-class RenderDataManager : public BaseSystemImpl<RDM_MSG>
+class RenderDataManager : public BaseSystemImpl<RDM_MSG, LaneQueue_SingleConsumer<RDM_MSG>>
 {
 protected:
 	SceneManager scene_;
@@ -145,35 +175,69 @@ protected:
 	SyncFence fence_;
 
 	UploadBuffer upload_buffer_;
+#if DO_STAT
+	UploadStats upload_stats_{ "renderer_data_manager" };
+	Stat::Id nodes_refit_stat_{ "renderer_data_manager", "nodes_refit", Stat::EMode::PerFrame };
+	Stat::Id node_volume_ratio_stat_{ "renderer_data_manager", "node_volume_ratio", Stat::EMode::Override };
+	Stat::Id moved_instances_stat_{ "renderer_data_manager", "moved_instances", Stat::EMode::PerFrame };
+#endif
 	DescriptorHeap buffers_heap_;
 
 	GPUCommands commands_;
 	
 	StructBuffer mesh_buffer_;
-	StructBuffer instances_buffer_;
+	// Retired like the nodes. A changed instance is uploaded to each buffer, when the buffer becomes active.
+	RingBuffered<StructBuffer, Const::kStaticInstancesBuffersNum, std::shared_future<IRenderer::SyncGPU>> instances_;
+	uint32_t published_instances_idx_ = Const::kInvalid32;
 	struct NodesBuffers
 	{
 		StructBuffer bounding_sphere;
 		StructBuffer instances_per_node;
 	};
-	Twins<NodesBuffers> nodes_;
+	// A slot is retired, when the renderer switched to a newer one and finished the frames that used it.
+	RingBuffered<NodesBuffers, Const::kStaticNodesBuffersNum, std::shared_future<IRenderer::SyncGPU>> nodes_;
+	uint32_t published_nodes_idx_ = Const::kInvalid32;
 
 	std::atomic_uint32_t actual_batch_ = 0;
+	// The nodes are rebuilt in Morton order every rebuild_period_ ticks, when the scene changed. 0: never.
+	uint32_t rebuild_period_ = 0;
+	uint32_t ticks_since_rebuild_ = 0;
+	// The BVH over the nodes is not uploaded yet, the culling shaders test every node. Off by default.
+	bool build_bvh_ = false;
 
 public:
 	RenderDataManager() { assert(!render_data_manager); render_data_manager = this; }
 	virtual ~RenderDataManager() { assert(render_data_manager); render_data_manager = nullptr; }
-	MeshComponent* Allocate(std::shared_ptr<Mesh>&& mesh, Transform&& transform)
+	MeshComponentHandle Allocate(std::shared_ptr<Mesh>&& mesh, Transform&& transform)
 	{
 		return scene_.Allocate(std::forward<std::shared_ptr<Mesh>>(mesh), std::forward<Transform>(transform));
 	}
 	uint32_t GetActualBatch() const { return actual_batch_; }
 
 protected:
-	void operator()(RDM_MSG_AddComponent msg) 
+	// Executes the recorded copies. The upload buffer space they read is reclaimed, once the returned fence value completes.
+	uint64_t ExecuteUploads()
 	{
-		assert(msg.component);
-		MeshComponent& instance = *msg.component;
+		const uint64_t fence_value = commands_.Execute(fence_);
+		upload_buffer_.submit(fence_value);
+		return fence_value;
+	}
+
+	// Executes the recorded copies and opens a new list, when the upload buffer is full. Blocks only until the oldest
+	// submission reading the upload buffer completes, unless it already did.
+	void SubmitUploadsAndReclaim()
+	{
+		ExecuteUploads();
+		fence_.WaitForValue(upload_buffer_.get_oldest_fence_value());
+		upload_buffer_.retire(fence_.GetCompletedValue());
+		commands_.Reopen(fence_);
+	}
+
+	void operator()(RDM_MSG_AddComponent& msg) 
+	{
+		MeshComponent* const found = scene_.Get(msg.component);
+		assert(found);
+		MeshComponent& instance = *found;
 		assert(instance.mesh);
 		if (instance.mesh->index == Const::kInvalid32)
 		{
@@ -185,40 +249,56 @@ protected:
 		scene_.Add(instance);
 	}
 
-	void operator()(RDM_MSG_RemoveComponent msg) 
+	void operator()(RDM_MSG_RemoveComponent& msg) 
 	{
-		assert(msg.component);
-		std::shared_ptr<Mesh> mesh_to_remove = scene_.RemoveAndFree(*msg.component);
+		MeshComponent* const instance = scene_.Get(msg.component);
+		assert(instance);
+		std::shared_ptr<Mesh> mesh_to_remove = scene_.RemoveAndFree(*instance);
 		if (mesh_to_remove)
 		{
 			meshes_.Remove(mesh_to_remove);
 		}
 	}
 
+	// Only the last transform of an instance in a tick is applied, in ApplyTransforms.
+	void operator()(RDM_MSG_UpdateTransform& msg)
+	{
+		MeshComponent* const instance = scene_.Get(msg.component);
+		assert(instance);
+		scene_.SetTransform(*instance, msg.transform);
+	}
+
 protected:
 	void ThreadInitialize() override
 	{
 		const IRenderer::RendererCommon& common = IRenderer::GetRendererCommon();
-		upload_buffer_.initialize(common.device.Get(), 2 * 1024 * 1024);
-		buffers_heap_.create(common.device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_NONE, 6);
+		const uint64_t upload_min_size = Config::GetNumber<uint64_t>("render_data_manager", "upload_min_kb").value_or(2 * 1024) * 1024;
+		const uint64_t upload_max_size = Config::GetNumber<uint64_t>("render_data_manager", "upload_max_kb").value_or(64 * 1024) * 1024;
+		upload_buffer_.set_size_limits(upload_min_size, std::max(upload_min_size, upload_max_size));
+		rebuild_period_ = Config::GetNumber<uint32_t>("render_data_manager", "rebuild_period").value_or(512);
+		build_bvh_ = Config::GetNumber<uint32_t>("render_data_manager", "build_bvh").value_or(0) != 0;
+		upload_buffer_.initialize(common.device.Get(), static_cast<uint32_t>(upload_min_size));
+		buffers_heap_.create(common.device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_NONE, 1 + Const::kStaticInstancesBuffersNum + 2 * Const::kStaticNodesBuffersNum);
 
 		commands_.Create(common.device.Get(), D3D12_COMMAND_LIST_TYPE_COPY);
 
 		fence_.Create(common.device.Get());
 		
 		Construct<MeshDataGPU,		StructBuffer>(mesh_buffer_,							nullptr, Const::kMeshCapacity,				common.device.Get(), commands_.GetCommandList(), upload_buffer_, &buffers_heap_, { D3D12_RESOURCE_STATE_COMMON });
-		Construct<MeshInstanceGPU,	StructBuffer>(instances_buffer_,					nullptr, Const::kStaticInstancesCapacity,	common.device.Get(), commands_.GetCommandList(), upload_buffer_, &buffers_heap_, { D3D12_RESOURCE_STATE_COMMON });
+		for (StructBuffer& instances_buffer : instances_)
+		{
+			Construct<MeshInstanceGPU,	StructBuffer>(instances_buffer,					nullptr, Const::kStaticInstancesCapacity,	common.device.Get(), commands_.GetCommandList(), upload_buffer_, &buffers_heap_, { D3D12_RESOURCE_STATE_COMMON });
+		}
 		for (auto& n : nodes_)
 		{
 			Construct<BoundingSphere,				StructBuffer>(n.bounding_sphere,	nullptr, Const::kStaticNodesCapacity,		common.device.Get(), commands_.GetCommandList(), upload_buffer_, &buffers_heap_, { D3D12_RESOURCE_STATE_COMMON });
 			Construct<InstancesInNodeGPU::TIndex,	StructBuffer>(n.instances_per_node, nullptr, Const::kStaticInstancesCapacity,	common.device.Get(), commands_.GetCommandList(), upload_buffer_, &buffers_heap_, { D3D12_RESOURCE_STATE_COMMON });
 		}
 		
-		commands_.Execute();
-		fence_.WaitForGPU(commands_);
+		fence_.WaitForValue(commands_.Execute(fence_));
 		upload_buffer_.reset();
 
-		IRenderer::EnqueueMsg({ IRenderer::RT_MSG_MeshBuffer { mesh_buffer_.get_srv_handle()} });
+		IRenderer::EmplaceCommand<IRenderer::RT_CMD_MeshBuffer>(mesh_buffer_.get_srv_handle());
 	}
 
 	void ThreadCleanUp() override
@@ -231,7 +311,7 @@ protected:
 		commands_.Destroy();
 	}
 
-	void HandleSingleMessage(RDM_MSG& msg) override { std::visit([&](auto&& arg) { (*this)(std::move(arg)); }, msg); }
+	void HandleSingleMessage(RDM_MSG& msg) override { std::visit([&](auto& arg) { (*this)(arg); }, msg); }
 
 	void Tick() override 
 	{
@@ -241,7 +321,7 @@ protected:
 		const auto start_time = Utils::GetTime();
 		{
 			STAT_TIME_SCOPE(renderer_data_manager, tick);
-			// 1. Wait for last update (5). Reopen CL, reset upload.
+			// 1. Wait for last update (5), the meshes are sent to RT once uploaded. Reclaim and resize the upload buffer, reopen CL.
 			fence_.WaitForGPU(commands_);
 			waiting_meshes_.FlipActive();
 			auto send_loaded_meshes = [](std::vector<std::shared_ptr<Mesh>>& ready_to_register)
@@ -253,47 +333,84 @@ protected:
 					}
 				};
 			send_loaded_meshes(waiting_meshes_.GetActive());
-			commands_.Reopen();
-			upload_buffer_.reset();
+			upload_buffer_.retire(fence_.GetCompletedValue());
+			IF_DO_STAT(upload_stats_.pass(upload_buffer_));
+			upload_buffer_.adapt_size(IRenderer::GetRendererCommon().device.Get());
+			commands_.Reopen(fence_);
 			actual_batch_++;
 
 			// 2. Update Nodes
+			[[maybe_unused]] const uint32_t moved_instances = scene_.ApplyTransforms();
+			IF_DO_STAT(moved_instances_stat_.PassValue(moved_instances));
+			ticks_since_rebuild_++;
+			if (rebuild_period_ && (ticks_since_rebuild_ >= rebuild_period_) && scene_.HasChangedSinceRebuild())
+			{
+				STAT_TIME_SCOPE(renderer_data_manager, nodes_rebuild);
+				scene_.RebuildHierarchy();
+				ticks_since_rebuild_ = 0;
+			}
 			scene_.CompactNodes();
+			[[maybe_unused]] const uint32_t nodes_refit = scene_.RefitNodes();
+			IF_DO_STAT(nodes_refit_stat_.PassValue(nodes_refit));
 			const uint32_t nodes_num = scene_.NumNodes();
 			assert(nodes_num < Const::kStaticNodesCapacity);
 			const bool nodes_update_requiried = scene_.NeedsNodesUpdate();
 			if (nodes_update_requiried)
 			{
-				nodes_.FlipActive();
+				IF_DO_STAT(node_volume_ratio_stat_.PassValue(scene_.GetNodeVolumeRatio()));
+				if (build_bvh_)
+				{
+					STAT_TIME_SCOPE(renderer_data_manager, bvh_build);
+					scene_.BuildBvh();
+				}
+				// Blocks only when the renderer may still use every node buffer.
+				nodes_.Advance([&](std::shared_future<IRenderer::SyncGPU>& rt_future) { fence_.WaitForRT(rt_future, open_); });
 				scene_.UpdateNodes(nodes_.GetActive().bounding_sphere, commands_.GetCommandList(), upload_buffer_);
 				scene_.UpdateInstancesInNodes(nodes_.GetActive().instances_per_node, commands_.GetCommandList(), upload_buffer_);
 			}
 
-			//3. Update instances
-			bool must_sync_rt = false;
-			while (true)
+			//3. Update instances, in the next instance buffer. Blocks only when the renderer may still use every one.
+			bool must_sync_rt = nodes_update_requiried;
+			if (scene_.QueueInstancesUpdates())
 			{
-				if (!IsRunning())
-					return;
-				const EUpdateResult local_status = scene_.UpdateInstancesBuffer(instances_buffer_, commands_.GetCommandList(), upload_buffer_);
-				if (local_status == EUpdateResult::NoUpdateRequired && !nodes_update_requiried)
-					break;
-				commands_.Execute();
-				fence_.WaitForGPU(commands_);
-				commands_.Reopen();
-				upload_buffer_.reset();
 				must_sync_rt = true;
-				if (local_status != EUpdateResult::UpdateStillNeeded)
-					break;
+				instances_.Advance([&](std::shared_future<IRenderer::SyncGPU>& rt_future) { fence_.WaitForRT(rt_future, open_); });
+				while (scene_.UpdateInstancesBuffer(instances_.GetActiveIndex(), instances_.GetActive(), commands_.GetCommandList(), upload_buffer_) == EUpdateResult::UpdateStillNeeded)
+				{
+					if (!IsRunning())
+						return;
+					SubmitUploadsAndReclaim();
+				}
+			}
+			if (must_sync_rt)
+			{
+				// RT reads the buffers as soon as they are sent (4), so the upload must be complete.
+				fence_.WaitForValue(ExecuteUploads());
+				upload_buffer_.retire(fence_.GetCompletedValue());
+				commands_.Reopen(fence_);
 			}
 
-			// 4. Send new node buff to Render Thread. -> Get fence ?
+			// 4. Send new node buff to Render Thread. It resolves the promise with the fence of the last frame, that used the previously sent buffers.
+			std::shared_future<IRenderer::SyncGPU> previous_buffers_retired;
 			if (must_sync_rt)
 			{
-				std::promise<IRenderer::SyncGPU> rt_promise = fence_.MakePromiseRT();
+				std::promise<IRenderer::SyncGPU> rt_promise;
+				previous_buffers_retired = rt_promise.get_future().share();
+				const uint32_t active_nodes_idx = nodes_.GetActiveIndex();
+				if ((published_nodes_idx_ != Const::kInvalid32) && (published_nodes_idx_ != active_nodes_idx))
+				{
+					nodes_.SetRetireToken(published_nodes_idx_, std::shared_future(previous_buffers_retired));
+				}
+				published_nodes_idx_ = active_nodes_idx;
+				const uint32_t active_instances_idx = instances_.GetActiveIndex();
+				if ((published_instances_idx_ != Const::kInvalid32) && (published_instances_idx_ != active_instances_idx))
+				{
+					instances_.SetRetireToken(published_instances_idx_, std::shared_future(previous_buffers_retired));
+				}
+				published_instances_idx_ = active_instances_idx;
 				IRenderer::EnqueueMsg({ IRenderer::RT_MSG_StaticBuffers {
 						nodes_.GetActive().bounding_sphere.get_srv_handle(),
-						instances_buffer_.get_srv_handle(),
+						instances_.GetActive().get_srv_handle(),
 						nodes_.GetActive().instances_per_node.get_srv_handle(),
 						nodes_num, std::move(rt_promise)} });
 			}
@@ -304,24 +421,23 @@ protected:
 				const EUpdateResult all_meshes_updated = meshes_.Update(mesh_buffer_, commands_.GetCommandList(), upload_buffer_);
 				if (all_meshes_updated == EUpdateResult::NoUpdateRequired)
 					break;
-				commands_.Execute(); // we'll wait for it in 1st step
 				if (all_meshes_updated == EUpdateResult::Updated)
+				{
+					ExecuteUploads(); // we'll wait for it in 1st step
 					break;
-				fence_.WaitForGPU(commands_);
-				commands_.Reopen();
-				upload_buffer_.reset();
+				}
+				SubmitUploadsAndReclaim();
 			}
 
 			// 6. Add new nodes (locally on CPU)
 			scene_.AddPendingInstances();
 
-			// 7. Wait until [n-1] node buff is no longer used by RT. (fence from 4th step)
-			if (must_sync_rt)
+			// 7. Remove pending IB/VB and meshes. Removed meshes may still be drawn with the previously sent buffers, so only
+			// a removal waits for the Render Thread.
+			if (previous_buffers_retired.valid() && meshes_.HasPendingRemove())
 			{
-				fence_.WaitForRT(open_);
+				fence_.WaitForRT(previous_buffers_retired, open_);
 			}
-
-			// 8. Remove pending IB/VB and meshes.
 			meshes_.FlushPendingRemove();
 		}
 		const auto duration = Utils::GetTime() - start_time;
@@ -334,6 +450,10 @@ protected:
 	}
 
 	std::string_view GetName() const override { return "RenderDataManager"; }
+
+	// Fits the scratch data of SceneManager::RebuildHierarchy at full capacity, under 64 bytes per instance. It's rewound
+	// after each rebuild, so the second rebuild of a tick (after adding the pending instances) reuses the same space.
+	std::size_t GetFrameArenaSize() const override { return 64 * std::size_t(Const::kStaticInstancesCapacity); }
 };
 
 IBaseSystem* IRenderDataManager::CreateSystem() { return new RenderDataManager(); }
@@ -342,22 +462,22 @@ void MeshHandle::Initialize(std::shared_ptr<Mesh>&& mesh, Transform&& transform)
 {
 	assert(render_data_manager);
 	component_ = render_data_manager->Allocate(std::forward<std::shared_ptr<Mesh>>(mesh), std::forward<Transform>(transform));
-	render_data_manager->EnqueueMsg(RDM_MSG{ RDM_MSG_AddComponent{ component_ } });
+	render_data_manager->EmplaceMsg<RDM_MSG_AddComponent>(component_);
 }
 
-void MeshHandle::UpdateTransform(Transform)
+void MeshHandle::UpdateTransform(Transform transform)
 {
-	//render_data_manager->EnqueueMsg(RDM_MSG{ RDM_MSG_UpdateTransform{ component_, transform } });
-
+	assert(render_data_manager && component_.IsValid());
+	render_data_manager->EmplaceMsg<RDM_MSG_UpdateTransform>(component_, transform);
 }
 
 void MeshHandle::Cleanup()
 {
-	if (component_)
+	if (component_.IsValid())
 	{
 		assert(render_data_manager);
-		render_data_manager->EnqueueMsg(RDM_MSG{ RDM_MSG_RemoveComponent{ component_ } });
-		component_ = nullptr;
+		render_data_manager->EmplaceMsg<RDM_MSG_RemoveComponent>(component_);
+		component_ = MeshComponentHandle();
 	}
 }
 
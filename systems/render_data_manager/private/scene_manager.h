@@ -1,18 +1,50 @@
 #pragma once
 
 #include "rdm_base.h"
+#include "memory/page_memory.h"
+#include "node_grid.h"
+#include "node_bvh.h"
+#include "node_lbvh.h"
+#include "transform_updates.h"
+#include "hierarchical_bitmap.h"
+#include "primitives/sphere_fit.h"
 
 class SceneManager
 {
+	// Fewer instances, that became ready at once, are added one by one.
+	static constexpr uint32_t kMinBulkInstances = 1024;
+	// Consecutive instances are uploaded with a single copy, up to this many.
+	static constexpr uint32_t kMaxUploadRun = 1024;
+
+	// Scanned or copied to the upload buffer every tick, so they live in their own pages (large, when the config
+	// allows it), instead of inside the object. The hot arrays start at a cache line.
+	struct StaticArrays
+	{
+		preallocated_container<MeshComponent, Const::kStaticInstancesCapacity> instances; //SIZE: 48 * 16 * 4096 = 3MB
+
+		alignas(kCacheLineSize) preallocated_container<BoundingSphere, Const::kStaticNodesCapacity> nodes; //SIZE: 20 * 4096 = 80KB
+		alignas(kCacheLineSize) std::array<InstancesInNodeGPU, Const::kStaticNodesCapacity> inst_in_node_gpu; //SIZE: 32 * 4096 = 128KB
+	};
+	PageBacked<StaticArrays> arrays_{ PageMemory::PolicyFromConfig() };
+
 	// <== only safe operations allowed
-	preallocated_container<MeshComponent, Const::kStaticInstancesCapacity> instances_; //SIZE: 48 * 16 * 4096 = 3MB
+	decltype(StaticArrays::instances)& instances_ = arrays_->instances;
 
-	preallocated_container<BoundingSphere, Const::kStaticNodesCapacity> nodes_; //SIZE: 20 * 4096 = 80KB
-	std::array<InstancesInNodeGPU, Const::kStaticNodesCapacity> inst_in_node_gpu_; //SIZE: 32 * 4096 = 128KB
+	decltype(StaticArrays::nodes)& nodes_ = arrays_->nodes;
+	decltype(StaticArrays::inst_in_node_gpu)& inst_in_node_gpu_ = arrays_->inst_in_node_gpu;
+	NodeGrid node_grid_;
+	// Nodes, whose members changed since the last RefitNodes. Their spheres may be loose.
+	HierarchicalBitmap<Const::kStaticNodesCapacity> refit_pending_;
+	NodeBvh bvh_;
 
 	std::vector<MeshComponent*> pending_instances_; //wait until mesh is ready
-	std::vector<MeshComponent*> pending_gpu_instances_updates_;
+	HierarchicalBitmap<Const::kStaticInstancesCapacity> pending_gpu_instances_updates_;
+	// Instances, whose data in an instance buffer is older than in instances_. The renderer may still read the other
+	// buffers, so a buffer gets the updates it missed when it becomes active again.
+	std::array<HierarchicalBitmap<Const::kStaticInstancesCapacity>, Const::kStaticInstancesBuffersNum> stale_in_buffer_;
+	TransformUpdates transform_updates_;
 	uint32_t num_nodes_ = 0;
+	uint32_t changes_since_rebuild_ = 0;
 	bool dirty_ = false;
 
 	bool IsNodeEmpty(uint32_t node_idx) const
@@ -25,6 +57,17 @@ class SceneManager
 		return true;
 	}
 
+	uint32_t NumMembers(uint32_t node_idx) const
+	{
+		uint32_t num = 0;
+		for (int idx = 0; idx < Const::kMaxInstancesPerNode; idx++)
+		{
+			if (inst_in_node_gpu_[node_idx].instances[idx] != InstancesInNodeGPU::kInvalid)
+				num++;
+		}
+		return num;
+	}
+
 	std::optional<uint32_t> FreeSlotInNode(uint32_t node_idx) const
 	{
 		for (int idx = 0; idx < Const::kMaxInstancesPerNode; idx++)
@@ -44,31 +87,34 @@ class SceneManager
 			if (!IsNodeEmpty(node_idx))
 			{
 				BoundingSphere::CreateMerged(node, node, inst_sphere);
+				refit_pending_.set(node_idx);
 			}
+			node_grid_.Update(node_idx, node);
 			assert(!instance.is_sync_gpu());
 			instance.node_idx = node_idx;
 			assert(inst_in_node_gpu_[node_idx].instances[slot_in_node] == InstancesInNodeGPU::kInvalid);
 			inst_in_node_gpu_[node_idx].instances[slot_in_node] = static_cast<InstancesInNodeGPU::TIndex>(instances_.safe_get_index(&instance));
-			pending_gpu_instances_updates_.push_back(&instance);
+			pending_gpu_instances_updates_.set(instances_.safe_get_index(&instance));
 		};
 
 		assert(!instance.is_sync_gpu());
 		dirty_ = true;
+		changes_since_rebuild_++;
 		uint32_t best_node = Const::kInvalid32;
 		uint32_t best_node_slot = Const::kInvalid32;
 		{
 			const float max_wanted_dist = 8.0f * instance.mesh->radius * instance.transform.scale;
 			const float min_wanted_radius = instance.mesh->radius / 4.0f;
-			const float max_wanted_radius = instance.mesh->radius * 4.0f;
+			const float max_wanted_radius = MaxNodeRadius(instance);
 			float best_dist_sq = -1.0f;
-			auto find_best_node = [&](const BoundingSphere& node)
+			auto find_best_node = [&](uint32_t local_idx)
 			{
 				auto distance_sq = [&](const auto& a, const auto& b) -> float
 				{
 					const XMFLOAT3 diff(a.x - b.x, a.y - b.y, a.z - b.z);
 					return diff.x * diff.x + diff.y * diff.y + diff.z * diff.z;
 				};
-				const uint32_t local_idx = nodes_.safe_get_index(&node);
+				const BoundingSphere& node = nodes_[local_idx];
 				const float dist_sq = distance_sq(instance.transform.translate, node.Center);
 				const bool good = (max_wanted_dist > dist_sq)
 					&& (min_wanted_radius < node.Radius)
@@ -83,7 +129,15 @@ class SceneManager
 				best_node = local_idx;
 				best_node_slot = *free_slot;
 			};
-			nodes_.for_each(find_best_node);
+			// max_wanted_dist is compared with the squared distance.
+			const float max_dist = std::sqrt(max_wanted_dist);
+			// Probing the grid costs more than a node check, so with few nodes, or a search distance far larger than
+			// the node radius, all nodes are checked.
+			if (!node_grid_.ForEachCandidate(instance.transform.translate, max_dist, min_wanted_radius, max_wanted_radius, num_nodes_, find_best_node))
+			{
+				auto check_node = [&](const BoundingSphere& node) { find_best_node(nodes_.safe_get_index(&node)); };
+				nodes_.for_each(check_node);
+			}
 		}
 		if ((best_node != Const::kInvalid32) && (best_node_slot != Const::kInvalid32))
 		{
@@ -91,17 +145,22 @@ class SceneManager
 		}
 		else
 		{
-			const float3 trans = instance.transform.translate;
-			BoundingSphere* node = nodes_.allocate(XMFLOAT3(trans.x, trans.y, trans.z), instance.mesh->radius);
+			BoundingSphere* node = nodes_.allocate(instance.get_bounding_sphere());
 			assert(node);
 			num_nodes_++;
-			add_instance_to_node(nodes_.safe_get_index(node), 0);
+			const uint32_t node_idx = nodes_.safe_get_index(node);
+			assert(IsNodeEmpty(node_idx));
+			add_instance_to_node(node_idx, 0);
+			assert(NumMembers(node_idx) == 1);
 		}
 	}
 
-	void RemoveFromHierarchy(MeshComponent& instance)
+	// Nodes an instance is added to, or stays in, are smaller than this.
+	static float MaxNodeRadius(const MeshComponent& instance) { return instance.mesh->radius * 4.0f; }
+
+	// Takes the instance out of its node. The node is freed, when it becomes empty.
+	void DetachFromNode(MeshComponent& instance)
 	{
-		dirty_ = true;
 		InstancesInNodeGPU& local_instances = inst_in_node_gpu_[instance.node_idx];
 		const InstancesInNodeGPU::TIndex inst_idx = static_cast<InstancesInNodeGPU::TIndex>(instances_.safe_get_index(&instance));
 		auto found = std::find(local_instances.instances.begin(), local_instances.instances.end(), inst_idx);
@@ -109,13 +168,29 @@ class SceneManager
 		*found = InstancesInNodeGPU::kInvalid;
 		if (IsNodeEmpty(instance.node_idx))
 		{
+			node_grid_.Remove(instance.node_idx);
+			refit_pending_.clear(instance.node_idx);
 			nodes_.free(&nodes_[instance.node_idx]);
 			num_nodes_--;
 		}
 		else
 		{
-			//TODO: recalculate Bounding Sphere size
+			refit_pending_.set(instance.node_idx);
 		}
+		instance.node_idx = Const::kInvalid32;
+	}
+
+	void RemoveFromHierarchy(MeshComponent& instance)
+	{
+		dirty_ = true;
+		changes_since_rebuild_++;
+		const uint32_t inst_idx = instances_.safe_get_index(&instance);
+		pending_gpu_instances_updates_.clear(inst_idx);
+		for (auto& stale : stale_in_buffer_)
+		{
+			stale.clear(inst_idx);
+		}
+		DetachFromNode(instance);
 		instances_.safe_free(&instance);
 	}
 
@@ -139,32 +214,60 @@ public:
 			, upload_buffer.get_resource(), offset, num_nodes_ * sizeof(InstancesInNodeGPU));
 	}
 
-	EUpdateResult UpdateInstancesBuffer(StructBuffer& instances_buffer, ID3D12GraphicsCommandList* command_list, UploadBuffer& upload_buffer)
+	// Marks the instances changed since the last call as stale in every instance buffer. Returns false, when none changed.
+	bool QueueInstancesUpdates()
+	{
+		if (pending_gpu_instances_updates_.find_first_set() == decltype(pending_gpu_instances_updates_)::npos)
+			return false;
+		pending_gpu_instances_updates_.for_each_set([&](std::size_t inst_idx)
+		{
+			for (auto& stale : stale_in_buffer_)
+			{
+				stale.set(inst_idx);
+			}
+		});
+		pending_gpu_instances_updates_.clear_all();
+		return true;
+	}
+
+	// Uploads the stale instances of the buffer buffer_idx, in index order, a run of consecutive ones with a single
+	// copy. Uploaded instances are cleared, so after UpdateStillNeeded the next call continues with the rest.
+	EUpdateResult UpdateInstancesBuffer(uint32_t buffer_idx, StructBuffer& instances_buffer, ID3D12GraphicsCommandList* command_list, UploadBuffer& upload_buffer)
 	{
-		const int32_t local_size = static_cast<int32_t>(pending_gpu_instances_updates_.size());
-		if (!local_size)
+		auto& stale = stale_in_buffer_[buffer_idx];
+		constexpr auto npos = HierarchicalBitmap<Const::kStaticInstancesCapacity>::npos;
+		std::size_t first = stale.find_first_set();
+		if (first == npos)
 			return EUpdateResult::NoUpdateRequired;
-		for (int32_t idx = local_size - 1; idx >= 0; idx--)
+		for (; first != npos; first = stale.find_next_set(first))
 		{
-			MeshComponent* inst = pending_gpu_instances_updates_[idx];
-			assert(inst && instances_.is_set(inst) && inst->mesh);
-			const auto reserved_mem = upload_buffer.reserve_space(sizeof(MeshInstanceGPU), alignof(MeshInstanceGPU));
+			uint32_t run = 1;
+			while ((run < kMaxUploadRun) && (first + run < Const::kStaticInstancesCapacity) && stale.test(first + run))
+			{
+				run++;
+			}
+			const auto reserved_mem = upload_buffer.reserve_space(run * sizeof(MeshInstanceGPU), alignof(MeshInstanceGPU));
 			if (!reserved_mem.has_value())
 				return EUpdateResult::UpdateStillNeeded;
 			auto [offset, dst_ptr] = *reserved_mem;
+			MeshInstanceGPU* const run_data = reinterpret_cast<MeshInstanceGPU*>(dst_ptr);
+			for (uint32_t idx = 0; idx < run; idx++)
 			{
-				Mesh& mesh = *inst->mesh;
-				MeshInstanceGPU& data = *reinterpret_cast<MeshInstanceGPU*>(dst_ptr);
+				const MeshComponent& inst = instances_[first + idx];
+				assert(inst.mesh && inst.is_sync_gpu());
+				Mesh& mesh = *inst.mesh;
+				MeshInstanceGPU& data = run_data[idx];
 				data.mesh_index = static_cast<uint16_t>(mesh.index);
 				data.radius = mesh.radius;
-				data.transform = inst->transform;
+				data.transform = inst.transform;
 				const float max_draw_distance = mesh.get_max_draw_distance();
 				data.max_distance = ((max_draw_distance > 0xFFFF) || (max_draw_distance <= 0.0f)) 
 					? 0xFFFF : static_cast<uint16_t>(max_draw_distance);
 			}
 			command_list->CopyBufferRegion(instances_buffer.get_resource()
-				, instances_.safe_get_index(inst) * sizeof(MeshInstanceGPU)
-				, upload_buffer.get_resource(), offset, sizeof(MeshInstanceGPU));
+				, first * sizeof(MeshInstanceGPU)
+				, upload_buffer.get_resource(), offset, run * sizeof(MeshInstanceGPU));
+			stale.clear_range(first, run);
 		}
 		return EUpdateResult::Updated;
 	}
@@ -191,6 +294,7 @@ public:
 		assert(instance.mesh->instances);
 		std::shared_ptr<Mesh> mesh = instance.mesh;
 		instance.mesh->instances--;
+		transform_updates_.Remove(static_cast<uint32_t>(instances_.safe_get_index(&instance)));
 		if (instance.is_sync_gpu())
 		{
 			RemoveFromHierarchy(instance);
@@ -204,16 +308,60 @@ public:
 		return !mesh->instances ? mesh : nullptr;
 	}
 
+	void SetTransform(MeshComponent& instance, const Transform& transform)
+	{
+		assert(instances_.is_set(&instance));
+		transform_updates_.Set(static_cast<uint32_t>(instances_.safe_get_index(&instance)), transform);
+	}
+
+	// Applies the transforms set since the last call. A node is touched only, when an instance left its sphere: it's
+	// grown and refit, while it stays smaller than MaxNodeRadius. An instance, that left the node entirely or would
+	// make it too large, is added to the hierarchy again. Instances waiting for their mesh just take the transform.
+	// Returns the number of moved instances.
+	uint32_t ApplyTransforms()
+	{
+		return transform_updates_.Apply([&](uint32_t inst_idx, const Transform& transform)
+		{
+			MeshComponent& instance = instances_[inst_idx];
+			instance.transform = transform;
+			if (!instance.is_sync_gpu())
+				return;
+			pending_gpu_instances_updates_.set(inst_idx);
+			const BoundingSphere inst_sphere = instance.get_bounding_sphere();
+			BoundingSphere& node = nodes_[instance.node_idx];
+			const ContainmentType containment = node.Contains(inst_sphere);
+			if (containment == CONTAINS)
+				return;
+			if (containment == INTERSECTS)
+			{
+				BoundingSphere grown;
+				BoundingSphere::CreateMerged(grown, node, inst_sphere);
+				if (grown.Radius < MaxNodeRadius(instance))
+				{
+					node = grown;
+					node_grid_.Update(instance.node_idx, node);
+					refit_pending_.set(instance.node_idx);
+					dirty_ = true;
+					return;
+				}
+			}
+			DetachFromNode(instance);
+			AddToHierarchy(instance);
+		});
+	}
+
 	void CompactNodes()
 	{
-		constexpr auto lnpos = Bitset2::bitset2<Const::kStaticNodesCapacity>::npos;
+		constexpr auto lnpos = decltype(StaticArrays::nodes)::npos;
+		// Nodes past num_nodes_ are moved in order, so the search for the next taken one continues from the last.
+		std::size_t taken_idx = num_nodes_ - 1;
 		for(std::size_t first_free = nodes_.find_first_free(); 
 			(first_free < num_nodes_) && (first_free != lnpos);
 			first_free = nodes_.find_first_free())
 		{
 			dirty_ = true;
 
-			const std::size_t taken_idx = nodes_.find_next_taken(num_nodes_ - 1);
+			taken_idx = nodes_.find_next_taken(taken_idx);
 			assert(taken_idx != lnpos);
 			assert(nodes_.is_set(taken_idx));
 
@@ -224,7 +372,14 @@ public:
 			const uint32_t new_node_idx = nodes_.safe_get_index(&new_node);
 			assert(new_node_idx < num_nodes_);
 
+			node_grid_.Move(static_cast<uint32_t>(taken_idx), new_node_idx);
+			if (refit_pending_.test(taken_idx))
+			{
+				refit_pending_.clear(taken_idx);
+				refit_pending_.set(new_node_idx);
+			}
 			inst_in_node_gpu_[new_node_idx] = std::move(inst_in_node_gpu_[taken_idx]);
+			inst_in_node_gpu_[taken_idx].instances.fill(InstancesInNodeGPU::kInvalid);
 			for (uint32_t idx = 0; idx < Const::kMaxInstancesPerNode; idx++)
 			{
 				const InstancesInNodeGPU::TIndex inst_idx = inst_in_node_gpu_[new_node_idx].instances[idx];
@@ -252,38 +407,191 @@ public:
 		};
 		instances_.for_each(conditional_free);
 		pending_instances_.clear();
-		pending_gpu_instances_updates_.clear();
+		pending_gpu_instances_updates_.clear_all();
+		for (auto& stale : stale_in_buffer_)
+		{
+			stale.clear_all();
+		}
+		transform_updates_.Clear();
 		nodes_.reset();
+		node_grid_.Clear();
+		refit_pending_.clear_all();
 		num_nodes_ = 0;
+		changes_since_rebuild_ = 0;
 		dirty_ = false;
 	}
 
+	// Fits the spheres of the nodes, whose members changed since the last call, to the member spheres. Adding merges
+	// a node with the new member and removing doesn't touch it, so both stay O(1), and the spheres only grow until
+	// this call. Returns the number of refit nodes.
+	uint32_t RefitNodes()
+	{
+		uint32_t refit_num = 0;
+		std::array<BoundingSphere, Const::kMaxInstancesPerNode> members;
+		refit_pending_.for_each_set([&](std::size_t node_idx)
+		{
+			uint32_t members_num = 0;
+			for (const InstancesInNodeGPU::TIndex inst_idx : inst_in_node_gpu_[node_idx].instances)
+			{
+				if (inst_idx != InstancesInNodeGPU::kInvalid)
+				{
+					members[members_num++] = instances_[inst_idx].get_bounding_sphere();
+				}
+			}
+			assert(members_num);
+			BoundingSphere& node = nodes_[node_idx];
+			node = SphereFit::Enclose({ members.data(), members_num });
+			node_grid_.Update(static_cast<uint32_t>(node_idx), node);
+			refit_num++;
+		});
+		if (refit_num)
+		{
+			refit_pending_.clear_all();
+			dirty_ = true;
+		}
+		return refit_num;
+	}
+
+	// Sum of the node volumes divided by the sum of the instance volumes. 1 when the nodes are tight, and instances
+	// don't overlap.
+	double GetNodeVolumeRatio() const
+	{
+		double nodes_volume = 0.0;
+		double instances_volume = 0.0;
+		auto add_node = [&](const BoundingSphere& node)
+		{
+			nodes_volume += double(node.Radius) * node.Radius * node.Radius;
+			for (const InstancesInNodeGPU::TIndex inst_idx : inst_in_node_gpu_[nodes_.safe_get_index(&node)].instances)
+			{
+				if (inst_idx != InstancesInNodeGPU::kInvalid)
+				{
+					const float radius = instances_[inst_idx].get_bounding_sphere().Radius;
+					instances_volume += double(radius) * radius * radius;
+				}
+			}
+		};
+		nodes_.for_each(add_node);
+		return (instances_volume > 0.0) ? (nodes_volume / instances_volume) : 1.0;
+	}
+
+	// After CompactNodes, the nodes [0, num_nodes_) are all taken.
+	void BuildBvh()
+	{
+		bvh_.Build({ nodes_.safe_get_data(), num_nodes_ });
+	}
+
+	const NodeBvh& GetBvh() const { return bvh_; }
+
+	// Rebuilds all the nodes from scratch with NodeLbvh, together with the added instances. The nodes are allocated
+	// in Morton order, so nodes close in memory are close in space. Used for bulk adds (a level load), and to
+	// periodically undo the degradation of the incremental adds and removes. The scratch data lives in the frame arena
+	// of the calling system.
+	void RebuildHierarchy(std::span<MeshComponent* const> added = {})
+	{
+		// A tick may rebuild twice, the scratch data is released at the end of each rebuild.
+		FrameArena::RewindScope rewind(FrameArena::Current());
+		std::pmr::memory_resource* const scratch = FrameArena::CurrentResource();
+		std::pmr::vector<MeshComponent*> members(scratch);
+		members.reserve(Const::kStaticInstancesCapacity);
+		auto add_member = [&](MeshComponent& instance)
+		{
+			if (instance.is_sync_gpu())
+			{
+				members.push_back(&instance);
+			}
+		};
+		instances_.for_each(add_member);
+		for (MeshComponent* instance : added)
+		{
+			assert(instance && !instance->is_sync_gpu());
+			members.push_back(instance);
+			pending_gpu_instances_updates_.set(instances_.safe_get_index(instance));
+		}
+
+		const uint32_t members_num = static_cast<uint32_t>(members.size());
+		std::pmr::vector<BoundingSphere> spheres(members_num, scratch);
+		Jobs::ParallelFor(members_num, NodeLbvh::kBatchSize, [&](uint32_t idx) { spheres[idx] = members[idx]->get_bounding_sphere(); });
+		const NodeLbvh::Clusters clusters = NodeLbvh::Build(spheres, Const::kMaxInstancesPerNode, Const::kStaticNodesCapacity - 1, scratch);
+		const uint32_t leaves_num = static_cast<uint32_t>(clusters.leaves.size());
+
+		std::pmr::vector<BoundingSphere> leaf_spheres(leaves_num, scratch);
+		Jobs::ParallelFor(leaves_num, 64, [&](uint32_t leaf_idx)
+		{
+			const NodeLbvh::Leaf& leaf = clusters.leaves[leaf_idx];
+			std::array<BoundingSphere, Const::kMaxInstancesPerNode> leaf_members;
+			for (uint32_t idx = 0; idx < leaf.Size(); idx++)
+			{
+				leaf_members[idx] = spheres[clusters.order[leaf.begin + idx]];
+			}
+			leaf_spheres[leaf_idx] = SphereFit::Enclose({ leaf_members.data(), leaf.Size() });
+		});
+
+		auto clear_members = [&](const BoundingSphere& node) { inst_in_node_gpu_[nodes_.safe_get_index(&node)].instances.fill(InstancesInNodeGPU::kInvalid); };
+		nodes_.for_each(clear_members);
+		nodes_.reset();
+		node_grid_.Clear();
+		refit_pending_.clear_all();
+		num_nodes_ = 0;
+		for (uint32_t leaf_idx = 0; leaf_idx < leaves_num; leaf_idx++)
+		{
+			BoundingSphere* const node = nodes_.allocate(leaf_spheres[leaf_idx]);
+			assert(node);
+			const uint32_t node_idx = nodes_.safe_get_index(node);
+			assert(node_idx == leaf_idx);
+			num_nodes_++;
+			const NodeLbvh::Leaf& leaf = clusters.leaves[leaf_idx];
+			assert(leaf.Size() <= Const::kMaxInstancesPerNode);
+			// The slot may not have been taken before the rebuild, so its members are reset too.
+			inst_in_node_gpu_[node_idx].instances.fill(InstancesInNodeGPU::kInvalid);
+			for (uint32_t idx = 0; idx < leaf.Size(); idx++)
+			{
+				MeshComponent& instance = *members[clusters.order[leaf.begin + idx]];
+				instance.node_idx = node_idx;
+				inst_in_node_gpu_[node_idx].instances[idx] = static_cast<InstancesInNodeGPU::TIndex>(instances_.safe_get_index(&instance));
+			}
+			node_grid_.Update(node_idx, *node);
+		}
+		changes_since_rebuild_ = 0;
+		dirty_ = true;
+	}
+
+	bool HasChangedSinceRebuild() const { return changes_since_rebuild_ != 0; }
+
 	bool NeedsNodesUpdate() const { return dirty_; }
 
 	void SetUpToDate() { dirty_ = false; }
 
 	void AddPendingInstances()
 	{
-		for (uint32_t idx = 0; idx < pending_instances_.size();)
+		const auto ready_begin = std::partition(pending_instances_.begin(), pending_instances_.end(), [](const MeshComponent* it)
 		{
-			MeshComponent* it = pending_instances_[idx];
 			assert(it && it->mesh);
-			if (it->mesh->ready_to_render())
+			return !it->mesh->ready_to_render();
+		});
+		const std::span<MeshComponent* const> ready(ready_begin, pending_instances_.end());
+		if (ready.size() >= kMinBulkInstances)
+		{
+			RebuildHierarchy(ready);
+		}
+		else
+		{
+			for (MeshComponent* it : ready)
 			{
 				AddToHierarchy(*it);
-				RemoveSwap(pending_instances_, idx);
-			}
-			else
-			{
-				idx++;
 			}
 		}
+		pending_instances_.erase(ready_begin, pending_instances_.end());
 	}
 
-	MeshComponent* Allocate(std::shared_ptr<Mesh>&& mesh, Transform&& transform)
+	// Thread safe.
+	MeshComponentHandle Allocate(std::shared_ptr<Mesh>&& mesh, Transform&& transform)
 	{
-		return instances_.safe_allocate(std::forward<std::shared_ptr<Mesh>>(mesh), std::forward<Transform>(transform));
+		MeshComponent* instance = instances_.safe_allocate(std::forward<std::shared_ptr<Mesh>>(mesh), std::forward<Transform>(transform));
+		assert(instance);
+		return instances_.get_handle(instance);
 	}
 
+	MeshComponent* Get(MeshComponentHandle handle) { return instances_.get(handle); }
+
 	uint32_t NumNodes() const { return num_nodes_; }
 };
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "rdm_base.h"
+#include <vector>
+
+// Transforms set since the last Apply, stored SoA: the instance indices are scanned apart from the transforms. A later
+// write to an instance overwrites the earlier one in place, so each instance is applied once, with its last transform.
+class TransformUpdates
+{
+	std::vector<uint32_t> instances_;	// kInvalid32 for dropped entries
+	std::vector<Transform> transforms_;
+	std::array<uint32_t, Const::kStaticInstancesCapacity> slots_;	// entry of an instance, kInvalid32 when none
+
+public:
+	TransformUpdates() { slots_.fill(Const::kInvalid32); }
+
+	void Set(uint32_t instance_idx, const Transform& transform)
+	{
+		uint32_t& slot = slots_[instance_idx];
+		if (slot != Const::kInvalid32)
+		{
+			transforms_[slot] = transform;
+			return;
+		}
+		slot = static_cast<uint32_t>(instances_.size());
+		instances_.push_back(instance_idx);
+		transforms_.push_back(transform);
+	}
+
+	// The instance is removed, its transform is dropped.
+	void Remove(uint32_t instance_idx)
+	{
+		uint32_t& slot = slots_[instance_idx];
+		if (slot != Const::kInvalid32)
+		{
+			instances_[slot] = Const::kInvalid32;
+			slot = Const::kInvalid32;
+		}
+	}
+
+	void Clear()
+	{
+		for (const uint32_t instance_idx : instances_)
+		{
+			if (instance_idx != Const::kInvalid32)
+			{
+				slots_[instance_idx] = Const::kInvalid32;
+			}
+		}
+		instances_.clear();
+		transforms_.clear();
+	}
+
+	// func(uint32_t instance_idx, const Transform&) in the order of the first writes. Returns the number of calls.
+	template<typename F>
+	uint32_t Apply(F&& func)
+	{
+		uint32_t applied = 0;
+		for (std::size_t idx = 0; idx < instances_.size(); idx++)
+		{
+			const uint32_t instance_idx = instances_[idx];
+			if (instance_idx == Const::kInvalid32)
+				continue;
+			slots_[instance_idx] = Const::kInvalid32;
+			func(instance_idx, transforms_[idx]);
+			applied++;
+		}
+		instances_.clear();
+		transforms_.clear();
+		return applied;
+	}
+};
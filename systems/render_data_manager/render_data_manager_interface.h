@@ -10,19 +10,20 @@ namespace IRenderDataManager
 	IBaseSystem* CreateSystem();
 
 	struct MeshComponent;
+	using MeshComponentHandle = SlotHandle;
 
 	class MeshHandle
 	{
-		MeshComponent* component_ = nullptr;
+		MeshComponentHandle component_;
 	public:
 		void Initialize(std::shared_ptr<Mesh>&& mesh, mathfu::Transform&& transform);
 		void UpdateTransform(Transform transform);
 		void Cleanup();
 
-		bool IsValid() const { return !!component_; }
+		bool IsValid() const { return component_.IsValid(); }
 		MeshHandle() = default;
 		MeshHandle(MeshHandle&& other) : MeshHandle() { std::swap(component_, other.component_); }
-		MeshHandle& operator=(MeshHandle&& other) { std::swap(component_, other.component_); }
+		MeshHandle& operator=(MeshHandle&& other) { std::swap(component_, other.component_); return *this; }
 		MeshHandle(const MeshHandle&) = delete;
 		MeshHandle& operator=(const MeshHandle&) = delete;
 		~MeshHandle() { Cleanup(); }
@@ -66,6 +66,12 @@ void BaseRenderer::StaticEnqueueMsg(RT_MSG&& msg)
 	renderer_inst->EnqueueMsg(std::forward<RT_MSG>(msg));
 }
 
+RT_CMD_Stream& BaseRenderer::StaticGetCommandStream()
+{
+	assert(renderer_inst);
+	return renderer_inst->command_stream_;
+}
+
 BaseRenderer::BaseRenderer(HWND hWnd, uint32_t width, uint32_t height, BaseApp& app)
 	: hwnd_(hWnd), width_(width), height_(height), app_(app)
 {
@@ -203,6 +209,7 @@ void BaseRenderer::Tick()
 	auto& sync = GetSync();
 	sync.Wait();
 
+	HandleCommands();
 	Draw();
 	Present();
 
@@ -212,7 +219,7 @@ void BaseRenderer::Tick()
 		STAT_TIME_SCOPE(renderer, tick_broadcast);
 		const auto new_time = Utils::GetTime();
 		const Utils::TimeSpan delta = new_time - time_;
-		app_.ReceiveMsgToBroadcast(CommonMsg::Frame{ frame_counter, delta });
+		CommonMsg::Publish(CommonMsg::Frame{ frame_counter, delta });
 		time_ = new_time;
 		frame_counter++;
 	}
@@ -22,7 +22,7 @@ struct SyncPerFrame
 	void Close();
 };
 
-class BaseRenderer : public BaseSystemImpl<RT_MSG>
+class BaseRenderer : public BaseSystemImpl<RT_MSG, LaneQueue_SingleConsumer<RT_MSG>>
 {
 protected:
 	RendererCommon common_;
@@ -50,6 +50,8 @@ protected:
 	std::array<SyncPerFrame, Const::kFrameCount> sync_;
 	uint32 frame_index_ = 0;
 
+	RT_CMD_Stream command_stream_;
+
 	uint64 frame_counter = 0;
 	Utils::TimeType time_;
 	BaseApp& app_;
@@ -67,6 +69,7 @@ public:
 	virtual ~BaseRenderer();
 	static const RendererCommon& GetCommon();
 	static void StaticEnqueueMsg(RT_MSG&& msg);
+	static RT_CMD_Stream& StaticGetCommandStream();
 
 protected:
 	static void GetHardwareAdapter(IDXGIFactory2* pFactory, IDXGIAdapter1** ppAdapter);
@@ -77,6 +80,9 @@ protected:
 
 	void Tick() override final;
 
+	// Drains command_stream_, called once per frame before Draw.
+	virtual void HandleCommands() = 0;
+
 	virtual void Draw() = 0;
 
 	ID3D12Resource* GetRTResource() const
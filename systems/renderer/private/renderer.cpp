@@ -6,6 +6,7 @@
 #include "graphics/root_signature.h"
 #include "graphics/pipeline_state.h"
 #include "stat/stat.h"
+#include "config/config.h"
 #include <cstddef>
 
 #include "base_renderer.h"
@@ -138,6 +139,7 @@ protected:
 	CommitedBuffer reset_counter_src_;
 
 	std::array<PerFrame, Const::kFrameCount> per_frame_;
+	IF_DO_STAT(UploadStats upload_stats_{ "renderer" };)
 
 	DescriptorHeapElementRef imgui_font_;
 	DescriptorHeapElementRef meshes_buff_;
@@ -151,7 +153,7 @@ protected:
 	uint32 static_buffers_frame_idx = 0;
 	uint64 static_buffers_fence_value = 0;
 
-	std::function<void()> hud_func_;
+	DrawHudFunction hud_func_;
 public:
 	Renderer(HWND hWnd, uint32_t width, uint32_t height, BaseApp& in_app)
 		: BaseRenderer(hWnd, width, height, in_app)
@@ -166,14 +168,24 @@ public:
 protected:
 	PerFrame& GetPerFrame() { return per_frame_[GetFrameIndex()]; }
 
-	void operator()(RT_MSG_UpdateCamera) {}
+	void operator()(RT_CMD_UpdateCamera&) {}
 
-	void operator()(RT_MSG_MeshBuffer msg)
+	void operator()(RT_CMD_MeshBuffer& cmd)
 	{
-		meshes_buff_ = msg.meshes_buff;
+		meshes_buff_ = cmd.meshes_buff;
 	}
 
-	void operator()(RT_MSG_StaticBuffers msg)
+	void operator()(RT_CMD_ToogleFullScreen& cmd)
+	{
+		SetupFullscreen(cmd.forced_mode);
+	}
+
+	void operator()(RT_CMD_RegisterDrawHud& cmd)
+	{
+		hud_func_ = std::move(cmd.func);
+	}
+
+	void operator()(RT_MSG_StaticBuffers& msg)
 	{
 		static_nodes_ = msg.nodes;
 		static_instances_ = msg.instances;
@@ -187,12 +199,7 @@ protected:
 		static_buffers_fence_value = GetSync().fence_value;
 	}
 
-	void operator()(RT_MSG_ToogleFullScreen msg)
-	{
-		SetupFullscreen(msg.forced_mode);
-	}
-
-	void operator()(RT_MSG_RegisterMeshes msg)
+	void operator()(RT_MSG_RegisterMeshes& msg)
 	{
 		if (!to_register_.size())
 		{
@@ -204,12 +211,9 @@ protected:
 		}
 	}
 
-	void operator()(RT_MSG_RegisterDrawHud msg)
-	{
-		hud_func_ = std::move(msg.func);
-	}
+	void HandleSingleMessage(RT_MSG& msg) override { std::visit([&](auto& arg) { (*this)(arg); }, msg); }
 
-	void HandleSingleMessage(RT_MSG& msg) override { std::visit([&](auto&& arg) { (*this)(std::move(arg)); }, msg); }
+	void HandleCommands() override { command_stream_.ConsumeAll([&](auto& cmd) { (*this)(cmd); }); }
 
 	void Draw() override
 	{
@@ -228,9 +232,10 @@ protected:
 		}
 
 		auto& pf = GetPerFrame();
-		pf.upload_buffer.reset();
-
 		auto device = common_.device.Get();
+		pf.upload_buffer.reset();
+		IF_DO_STAT(upload_stats_.pass(pf.upload_buffer));
+		pf.upload_buffer.adapt_size(device);
 
 		//INITIAL COMMAND LIST
 		{
@@ -265,15 +270,15 @@ protected:
 			pf.tm.wait_for(pf.scene_manager_params.transition_barrier(D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
 		}
 
-		uint32_t buffer_heap_offset = 0;
-		//HEAP
+		//HEAP, linear: the copies below take consecutive slots, so each descriptor table is contiguous.
+		const uint32_t static_buffers_offset = 0;
 		{
-			pf.buffers_heap.clear(64);
-			CopyDescriptor(device, pf.buffers_heap, static_nodes_, buffer_heap_offset++);
-			CopyDescriptor(device, pf.buffers_heap, static_instances_, buffer_heap_offset++);
-			CopyDescriptor(device, pf.buffers_heap, static_instances_in_node, buffer_heap_offset++);
-			CopyDescriptor(device, pf.buffers_heap, meshes_buff_, buffer_heap_offset++);
-			CopyDescriptor(device, pf.buffers_heap, imgui_font_, buffer_heap_offset++);
+			pf.buffers_heap.clear();
+			CopyDescriptor(device, pf.buffers_heap, static_nodes_);
+			CopyDescriptor(device, pf.buffers_heap, static_instances_);
+			CopyDescriptor(device, pf.buffers_heap, static_instances_in_node);
+			CopyDescriptor(device, pf.buffers_heap, meshes_buff_);
+			CopyDescriptor(device, pf.buffers_heap, imgui_font_);
 
 			ID3D12DescriptorHeap* heaps = pf.buffers_heap.get_heap();
 			command_list_->SetDescriptorHeaps(1, &heaps);
@@ -290,20 +295,17 @@ protected:
 			uav.reset_counter(command_list_.Get(), reset_counter_src_.get_resource(), 0);
 			pf.tm.wait_for(uav.transition_barrier(D3D12_RESOURCE_STATE_UNORDERED_ACCESS), srv ? srv->get_resource() : nullptr);
 
-			uint32_t local_heap_offset = buffer_heap_offset;
-			CopyDescriptor(device, pf.buffers_heap, uav.get_uav_handle(), local_heap_offset++);
+			const uint32_t pass_heap_offset = CopyDescriptor(device, pf.buffers_heap, uav.get_uav_handle()).get_index();
 			if (srv)
 			{
-				CopyDescriptor(device, pf.buffers_heap, srv->get_counter_srv_handle(), local_heap_offset++);
-				CopyDescriptor(device, pf.buffers_heap, srv->get_srv_handle(), local_heap_offset++);
+				CopyDescriptor(device, pf.buffers_heap, srv->get_counter_srv_handle());
+				CopyDescriptor(device, pf.buffers_heap, srv->get_srv_handle());
 			}
 
 			command_list_->SetComputeRootSignature(pass.root_signature_.Get());
 			command_list_->SetComputeRootConstantBufferView(0, pf.scene_manager_params.get_resource()->GetGPUVirtualAddress());
-			const uint32_t static_buffers_offset = 0;
 			command_list_->SetComputeRootDescriptorTable(1, pf.buffers_heap.get_gpu_handle(static_buffers_offset));
-			command_list_->SetComputeRootDescriptorTable(2, pf.buffers_heap.get_gpu_handle(buffer_heap_offset));
-			buffer_heap_offset = local_heap_offset;
+			command_list_->SetComputeRootDescriptorTable(2, pf.buffers_heap.get_gpu_handle(pass_heap_offset));
 
 			command_list_->SetPipelineState(pass.pipeline_state_.Get());
 			command_list_->Dispatch(pass.max_dispatch / pass.k_threads_x, 1, 1);
@@ -478,10 +480,13 @@ protected:
 		ThrowIfFailed(common_.device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, GetActiveAllocator(), nullptr, IID_PPV_ARGS(&command_list_)));
 		NAME_D3D12_OBJECT(command_list_);
 
+		const uint64_t upload_min_size = Config::GetNumber<uint64_t>("renderer", "upload_min_kb").value_or(1) * 1024;
+		const uint64_t upload_max_size = Config::GetNumber<uint64_t>("renderer", "upload_max_kb").value_or(1024) * 1024;
 		for (auto& pf : per_frame_)
 		{
-			pf.upload_buffer.initialize(common_.device.Get(), 1024);
-			pf.buffers_heap.create(common_.device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE, 64);
+			pf.upload_buffer.set_size_limits(upload_min_size, std::max(upload_min_size, upload_max_size));
+			pf.upload_buffer.initialize(common_.device.Get(), static_cast<uint32_t>(upload_min_size));
+			pf.buffers_heap.create(common_.device.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE, 64, 0, DescriptorAllocator::EMode::Linear);
 
 			Construct<IndirectCommandGPU, UavCountedBuffer>(pf.indirect_draw_commands, nullptr, Const::kStaticInstancesCapacity, common_.device.Get(), command_list_.Get()
 				, pf.upload_buffer, &persistent_descriptor_heap_, { D3D12_RESOURCE_STATE_COPY_DEST });
@@ -553,4 +558,6 @@ const RendererCommon& IRenderer::GetRendererCommon() { return BaseRenderer::GetC
 
 void IRenderer::EnqueueMsg(RT_MSG&& msg) { BaseRenderer::StaticEnqueueMsg(std::forward<RT_MSG>(msg)); }
 
+IRenderer::RT_CMD_Stream& IRenderer::GetCommandStream() { return BaseRenderer::StaticGetCommandStream(); }
+
 IBaseSystem* IRenderer::CreateSystem(HWND hWnd, uint32_t width, uint32_t height, BaseApp& app) { return new Renderer(hWnd, width, height, app); }
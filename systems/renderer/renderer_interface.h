@@ -1,6 +1,8 @@
 #pragma once
 
 #include "base_system.h"
+#include "command_stream.h"
+#include "inline_function.h"
 #include "graphics/gpu_containers.h"
 #include "primitives/mesh_data.h"
 
@@ -11,7 +13,10 @@ namespace Const
 	constexpr uint32_t kFrameCount = 2;
 	constexpr uint32_t kMeshCapacity = 4096;
 	constexpr uint32_t kStaticNodesCapacity = 4096;
+	constexpr uint32_t kStaticNodesBuffersNum = 3;
+	constexpr uint32_t kStaticInstancesBuffersNum = 3;
 	constexpr uint32_t kStaticInstancesCapacity = kStaticNodesCapacity * kMaxInstancesPerNode;
+	constexpr uint32_t kRendererCommandStreamSize = 16 * 1024;
 };
 
 namespace IRenderer
@@ -19,10 +24,21 @@ namespace IRenderer
 	using Microsoft::WRL::ComPtr;
 	using SyncGPU = std::pair<ComPtr<ID3D12Fence>, uint64_t>;
 
-	struct RT_MSG_UpdateCamera { DirectX::XMFLOAT3 position; DirectX::XMFLOAT3 direction; };
-	struct RT_MSG_ToogleFullScreen { std::optional<bool> forced_mode; };
-	
-	struct RT_MSG_MeshBuffer { DescriptorHeapElementRef meshes_buff; }; // update fragment
+	// Small, frequent commands go through the command stream. Each takes only its own size in the ring.
+	using DrawHudFunction = InlineFunction<void(), 64>;
+
+	struct RT_CMD_UpdateCamera { DirectX::XMFLOAT3 position; DirectX::XMFLOAT3 direction; };
+	struct RT_CMD_ToogleFullScreen { std::optional<bool> forced_mode; };
+	struct RT_CMD_MeshBuffer { DescriptorHeapElementRef meshes_buff; }; // update fragment
+	struct RT_CMD_RegisterDrawHud { DrawHudFunction func; };
+
+	using RT_CMD_Stream = CommandStream_SingleConsumer<Const::kRendererCommandStreamSize,
+		RT_CMD_UpdateCamera,
+		RT_CMD_ToogleFullScreen,
+		RT_CMD_MeshBuffer,
+		RT_CMD_RegisterDrawHud>;
+
+	// Messages carrying ownership or synchronization.
 	struct RT_MSG_StaticBuffers 
 	{ 
 		DescriptorHeapElementRef nodes;
@@ -34,15 +50,9 @@ namespace IRenderer
 
 	struct RT_MSG_RegisterMeshes { std::vector<std::shared_ptr<Mesh>> to_register; };
 
-	struct RT_MSG_RegisterDrawHud { std::function<void()> func; };
-
 	using RT_MSG = std::variant<
-		RT_MSG_UpdateCamera,
-		RT_MSG_MeshBuffer,
 		RT_MSG_StaticBuffers,
-		RT_MSG_ToogleFullScreen,
-		RT_MSG_RegisterMeshes,
-		RT_MSG_RegisterDrawHud>;
+		RT_MSG_RegisterMeshes>;
 
 	struct RendererCommon
 	{
@@ -51,6 +61,14 @@ namespace IRenderer
 
 	const RendererCommon& GetRendererCommon();
 	void EnqueueMsg(RT_MSG&&);
+	RT_CMD_Stream& GetCommandStream();
+
+	// Thread safe. The command is built in place in the stream, and handled at the start of the next frame.
+	template<typename TCmd, typename... Args>
+	void EmplaceCommand(Args&&... args)
+	{
+		GetCommandStream().Emplace<TCmd>(std::forward<Args>(args)...);
+	}
 	IBaseSystem* CreateSystem(HWND hWnd, uint32_t width, uint32_t height, BaseApp& app);
 };
 
@@ -25,10 +25,51 @@ namespace Statistics
 		g_instance->ReceiveStat(index, mode, value);
 	}
 
+	// Released on the render thread, when the HUD is replaced.
+	class HudArenaLease
+	{
+		std::atomic_bool* in_use_ = nullptr;
+	public:
+		explicit HudArenaLease(std::atomic_bool& in_use) : in_use_(&in_use) {}
+		HudArenaLease(HudArenaLease&& other) noexcept : in_use_(std::exchange(other.in_use_, nullptr)) {}
+		HudArenaLease(const HudArenaLease&) = delete;
+		~HudArenaLease()
+		{
+			if (in_use_)
+			{
+				in_use_->store(false, std::memory_order_release);
+			}
+		}
+	};
+
+	struct HudText
+	{
+		HudArenaLease lease; // declared first, so the lines are destroyed before the arena is released
+		std::pmr::vector<std::pmr::string> lines;
+	};
+
 	void System::ThreadInitialize()
 	{
 		Stat::Id::SetHandleStatsFunction(&PassStat);
 		enabled_.set(); // ?
+		for (HudArena& it : hud_arenas_)
+		{
+			it.arena.emplace(kHudArenaSize);
+		}
+	}
+
+	System::HudArena* System::LeaseHudArena()
+	{
+		for (HudArena& it : hud_arenas_)
+		{
+			bool expected = false;
+			if (it.in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+			{
+				it.arena->Reset();
+				return &it;
+			}
+		}
+		return nullptr;
 	}
 
 	void System::ThreadCleanUp()
@@ -52,16 +93,21 @@ namespace Statistics
 		}
 	}
 
-	void System::operator()(CommonMsg::Message msg)
+	void System::HandleCommonMessage(CommonMsg::Message msg)
 	{
 		if (const CommonMsg::Frame* frame = std::get_if<CommonMsg::Frame>(&msg))
 		{
 			buffers_.FlipActive();
 
-			std::vector<std::string> text;
+			HudArena* const hud = LeaseHudArena();
+			std::pmr::vector<std::pmr::string> text(hud ? &*hud->arena : std::pmr::null_memory_resource());
 
 			auto& full_bufff = buffers_.GetInactive();
 			const std::span<const Stat::Details> details = Stat::Id::AllStatsDetails();
+			if (hud)
+			{
+				text.reserve(details.size());
+			}
 			for (uint32 idx = 0; idx < details.size(); idx++)
 			{
 				if (!enabled_[idx])
@@ -71,8 +117,11 @@ namespace Statistics
 				const double value = elem.value.load(std::memory_order_relaxed);
 				const uint32 counter = elem.counter.load(std::memory_order_relaxed);
 
-				std::string str = std::format("{}:{} {} / {}", detail.group, detail.name, value, counter);
-				text.push_back(std::move(str));
+				if (hud)
+				{
+					std::pmr::string& str = text.emplace_back();
+					std::format_to(std::back_inserter(str), "{}:{} {} / {}", detail.group, detail.name, value, counter);
+				}
 
 				if (detail.mode == Stat::EMode::PerFrame)
 				{
@@ -81,26 +130,29 @@ namespace Statistics
 				}
 			}
 
-			auto draw_hud = [text = std::move(text), delta_ms = Utils::ToMiliseconds(frame->delta)]()
+			if (!hud)
+				return; // The render thread still holds both previous HUDs, keep the current one.
+
+			auto draw_hud = [text = HudText{ HudArenaLease(hud->in_use), std::move(text) }, delta_ms = Utils::ToMiliseconds(frame->delta)]()
 			{
 				ImGui::Begin("Stats");
 				ImGui::Text("frame %f ms", delta_ms);
-				for (const auto& it : text)
+				for (const auto& it : text.lines)
 				{
 					ImGui::Text(it.data());
 				}
 				if (ImGui::Button("Show Render"))
 				{
-					g_instance->EnqueueMsg(StartDisplay{ "renderer" });
+					g_instance->EmplaceMsg<StartDisplay>("renderer");
 				}
 				if (ImGui::Button("Hide Render"))
 				{
-					g_instance->EnqueueMsg(StopDisplay{ "renderer" });
+					g_instance->EmplaceMsg<StopDisplay>("renderer");
 				}
 				ImGui::End();
 			};
 
-			IRenderer::EnqueueMsg(IRenderer::RT_MSG_RegisterDrawHud{ std::move(draw_hud) });
+			IRenderer::EmplaceCommand<IRenderer::RT_CMD_RegisterDrawHud>(std::move(draw_hud));
 		}
 	}
 
@@ -116,12 +168,12 @@ namespace Statistics
 		}
 	}
 
-	void System::operator()(StartDisplay msg)
+	void System::operator()(StartDisplay& msg)
 	{
 		SetByGroup(msg.group_name, enabled_, true);
 	}
 
-	void System::operator()(StopDisplay msg)
+	void System::operator()(StopDisplay& msg)
 	{
 		SetByGroup(msg.group_name, enabled_, false);
 	}
@@ -17,7 +17,7 @@ namespace Statistics
 	{
 		std::string group_name;
 	};
-	using Message = std::variant<StartDisplay, StopDisplay, CommonMsg::Message>;
+	using Message = std::variant<StartDisplay, StopDisplay>;
 
 	class System : public BaseSystemImpl<Message>
 	{
@@ -26,12 +26,14 @@ namespace Statistics
 
 		void ThreadCleanUp() override;
 
-		void ReceiveCommonMessage(CommonMsg::Message msg) override
-		{
-			EnqueueMsg(Message{ msg });
-		}
+		CommonMsg::TypeMask GetCommonMessageTypes() const override { return CommonMsg::MaskOf<CommonMsg::Frame>(); }
+
+		void HandleCommonMessage(CommonMsg::Message msg) override;
 
-		void HandleSingleMessage(Message& msg) override { std::visit([&](auto&& arg) { (*this)(std::move(arg)); }, msg); }
+		ETickMode GetTickMode() const override { return ETickMode::OnMessage; }
+		EExecution GetExecution() const override { return EExecution::Pooled; }
+
+		void HandleSingleMessage(Message& msg) override { std::visit([&](auto& arg) { (*this)(arg); }, msg); }
 
 		void Destroy() override;
 
@@ -40,11 +42,9 @@ namespace Statistics
 		// Thread safe
 		void ReceiveStat(uint32 index, Stat::EMode mode, double value);
 	protected:
-		void System::operator()(CommonMsg::Message msg);
-
-		void operator()(StartDisplay msg);
+		void operator()(StartDisplay& msg);
 
-		void operator()(StopDisplay msg);
+		void operator()(StopDisplay& msg);
 		struct StatValue
 		{
 			std::atomic<double> value = 0.0;
@@ -54,6 +54,19 @@ namespace Statistics
 		Twins<ValueArray> buffers_;
 
 		std::bitset<Stat::kMaxSupportedStats> enabled_;
+
+		// The HUD text lives on the render thread until the next HUD replaces it, so it cannot use the frame arena.
+		// Two arenas alternate instead, each leased by the HUD that uses it.
+		static constexpr std::size_t kHudArenaSize = 16 * 1024;
+		struct HudArena
+		{
+			std::optional<FrameArena> arena;
+			std::atomic_bool in_use = false;
+		};
+		std::array<HudArena, 2> hud_arenas_;
+
+		// Returns nullptr when both arenas are still used.
+		HudArena* LeaseHudArena();
 	};
 
 	IBaseSystem* CreateSystem();
@@ -0,0 +1,93 @@
+#include "harness.h"
+#include "hierarchical_bitmap.h"
+#include "third_party/bitset2/bitset2.hpp"
+#include <memory>
+#include <random>
+
+// HierarchicalBitmap against bitset2 at the sizes the containers use: the first set bit of a nearly empty bitmap,
+// iteration over the set bits at 1% and 50% density, and setting a range.
+namespace
+{
+	template<typename F>
+	double NanosecondsPerCall(uint64 calls, F&& func)
+	{
+		const Harness::Clock::time_point begin = Harness::Clock::now();
+		for (uint64 call = 0; call < calls; call++)
+		{
+			func(call);
+		}
+		return static_cast<double>(Harness::Nanoseconds(Harness::Clock::now() - begin)) / static_cast<double>(calls);
+	}
+
+	void Report(std::size_t bits, const char* operation, double bitset, double bitmap)
+	{
+		REPORT("  %5zu bits, %-24s bitset2 %10.1f ns, hierarchical %10.1f ns\n", bits, operation, bitset, bitmap);
+	}
+
+	template<std::size_t N>
+	void ReportSize()
+	{
+		using Bitset = Bitset2::bitset2<N>;
+		auto bitset = std::make_unique<Bitset>();
+		auto bitmap = std::make_unique<HierarchicalBitmap<N>>();
+		const uint64 calls = Harness::Iterations(N >= 16384 ? 20'000 : 200'000);
+
+		bitset->set(N - 1, true);
+		bitmap->set(N - 1);
+		const double find_bitset = NanosecondsPerCall(calls, [&](uint64) { Harness::DoNotOptimize(bitset->find_first()); });
+		const double find_bitmap = NanosecondsPerCall(calls, [&](uint64) { Harness::DoNotOptimize(bitmap->find_first_set()); });
+		Report(N, "find first, last bit set", find_bitset, find_bitmap);
+
+		for (const uint32 percent : { 1u, 50u })
+		{
+			std::mt19937 random(percent);
+			bitset->reset();
+			bitmap->clear_all();
+			for (std::size_t idx = 0; idx < N; idx++)
+			{
+				if ((random() % 100) < percent)
+				{
+					bitset->set(idx, true);
+					bitmap->set(idx);
+				}
+			}
+			const uint64 iterate_calls = std::max<uint64>(calls / 16, 1);
+			std::size_t sum = 0;
+			const double iterate_bitset = NanosecondsPerCall(iterate_calls, [&](uint64)
+			{
+				for (std::size_t idx = bitset->find_first(); idx != Bitset::npos; idx = bitset->find_next(idx))
+				{
+					sum += idx;
+				}
+			});
+			const double iterate_bitmap = NanosecondsPerCall(iterate_calls, [&](uint64)
+			{
+				bitmap->for_each_set([&](std::size_t idx) { sum += idx; });
+			});
+			Harness::DoNotOptimize(sum);
+			Report(N, (percent == 1) ? "iterate, 1% set" : "iterate, 50% set", iterate_bitset, iterate_bitmap);
+		}
+
+		const std::size_t range = N / 4;
+		const double range_bitset = NanosecondsPerCall(calls / 16 + 1, [&](uint64 call)
+		{
+			const std::size_t first = (call * 61) % (N - range);
+			for (std::size_t idx = first; idx < first + range; idx++)
+			{
+				bitset->set(idx, true);
+			}
+		});
+		const double range_bitmap = NanosecondsPerCall(calls / 16 + 1, [&](uint64 call)
+		{
+			bitmap->set_range((call * 61) % (N - range), range);
+		});
+		Report(N, "set a quarter range", range_bitset, range_bitmap);
+	}
+}
+
+BENCH(hierarchical_bitmap_vs_bitset2)
+{
+	ReportSize<4096>();
+	ReportSize<16384>();
+	ReportSize<65536>();
+}
@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "base_system.h"
+#include <array>
+
+// Four systems fed by the main thread, each on its own thread, and then as pooled jobs on the workers.
+namespace
+{
+	template<EExecution kExecution>
+	class BenchSystem : public BaseSystemImpl<uint32>
+	{
+		uint32 work_ = 0;
+		uint64 hash_ = 0;
+
+	public:
+		std::atomic<uint64> handled = 0;
+
+		BenchSystem(uint32 work) : work_(work) {}
+
+	protected:
+		void HandleSingleMessage(uint32& msg) override
+		{
+			for (uint32 idx = 0; idx < work_; idx++)
+			{
+				hash_ = (hash_ ^ (msg + idx)) * 0x100000001b3ull;
+			}
+			Harness::DoNotOptimize(hash_);
+			handled.store(handled.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+		ETickMode GetTickMode() const override { return ETickMode::OnMessage; }
+		EExecution GetExecution() const override { return kExecution; }
+		std::string_view GetName() const override { return "bench"; }
+	};
+
+	constexpr uint32 kSystems = 4;
+
+	template<EExecution kExecution>
+	double MeasureThroughput(uint32 messages, uint32 work)
+	{
+		std::vector<std::unique_ptr<BenchSystem<kExecution>>> systems;
+		for (uint32 idx = 0; idx < kSystems; idx++)
+		{
+			systems.push_back(std::make_unique<BenchSystem<kExecution>>(work));
+			static_cast<IBaseSystem&>(*systems.back()).Start();
+		}
+		const Harness::Clock::time_point begin = Harness::Clock::now();
+		for (uint32 idx = 0; idx < messages; idx++)
+		{
+			systems[idx % kSystems]->EnqueueMsg(uint32(idx));
+		}
+		for (auto& system : systems)
+		{
+			while (system->handled.load(std::memory_order_acquire) < messages / kSystems)
+			{
+				std::this_thread::yield();
+			}
+		}
+		const double seconds = Harness::Seconds(Harness::Clock::now() - begin);
+		for (auto& system : systems)
+		{
+			static_cast<IBaseSystem&>(*system).Stop();
+		}
+		return messages / seconds;
+	}
+}
+
+BENCH(jobs_four_systems_thread_vs_pooled)
+{
+	Jobs::Initialize(kSystems);
+	const uint32 messages = static_cast<uint32>(Harness::Iterations(400'000)) * kSystems;
+	for (const uint32 work : { 0u, 256u, 4096u })
+	{
+		const double threads = MeasureThroughput<EExecution::DedicatedThread>(messages, work);
+		const double pooled = MeasureThroughput<EExecution::Pooled>(messages, work);
+		REPORT("  work %4u: dedicated threads %8.3f Mmsg/s, pooled %8.3f Mmsg/s\n", work, threads / 1e6, pooled / 1e6);
+	}
+	Jobs::Shutdown();
+}
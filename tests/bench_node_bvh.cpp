@@ -0,0 +1,65 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "node_bvh.h"
+#include <cmath>
+#include <random>
+
+// The BVH over the static nodes: the time of NodeBvh::Build from 1K to 1M leaves, and of NodeBvh::Cull for a camera
+// in the middle of the scene, against a test of every leaf sphere with the frustum.
+namespace
+{
+	constexpr uint32 kCullRuns = 64;
+}
+
+BENCH(node_bvh_build_and_cull)
+{
+	std::mt19937 random(37);
+	for (const uint32 full_num : { 1'000u, 10'000u, 100'000u, 1'000'000u })
+	{
+		const uint32 num = static_cast<uint32>(std::max<uint64>(Harness::Iterations(full_num), 100));
+		// The density of the nodes: radius 4, with about 16 instances each.
+		const float side = 16.0f * std::cbrt(static_cast<float>(num));
+		std::uniform_real_distribution<float> coord(0.0f, side);
+		std::vector<BoundingSphere> leaves;
+		leaves.reserve(num);
+		for (uint32 idx = 0; idx < num; idx++)
+		{
+			leaves.emplace_back(XMFLOAT3(coord(random), coord(random), coord(random)), 4.0f);
+		}
+
+		NodeBvh bvh;
+		const Harness::Clock::time_point build_begin = Harness::Clock::now();
+		bvh.Build(leaves);
+		const double build_seconds = Harness::Seconds(Harness::Clock::now() - build_begin);
+
+		// Looking along +z from the center of the scene, seeing about a tenth of it.
+		const BoundingFrustum frustum(XMFLOAT3(side / 2, side / 2, side / 2), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), 1.0f, -1.0f, 0.577f, -0.577f, 0.5f, side / 2);
+		const uint32 runs = Harness::IsQuick() ? 1 : kCullRuns;
+		uint32 visible = 0;
+		const Harness::Clock::time_point cull_begin = Harness::Clock::now();
+		for (uint32 run = 0; run < runs; run++)
+		{
+			visible = 0;
+			bvh.Cull(frustum, [&](uint32) { visible++; });
+			Harness::DoNotOptimize(visible);
+		}
+		const double cull_seconds = Harness::Seconds(Harness::Clock::now() - cull_begin) / runs;
+
+		uint32 brute_visible = 0;
+		const Harness::Clock::time_point brute_begin = Harness::Clock::now();
+		for (uint32 run = 0; run < runs; run++)
+		{
+			brute_visible = 0;
+			for (const BoundingSphere& leaf : leaves)
+			{
+				brute_visible += (frustum.Contains(leaf) != DISJOINT) ? 1 : 0;
+			}
+			Harness::DoNotOptimize(brute_visible);
+		}
+		const double brute_seconds = Harness::Seconds(Harness::Clock::now() - brute_begin) / runs;
+
+		REPORT("  %7u leaves: build %8.2f ms, %6.1f ns/leaf, %6u nodes | cull %8.1f us, %6u visible | every leaf %9.1f us, %6u visible\n",
+			num, build_seconds * 1e3, build_seconds * 1e9 / num, static_cast<uint32>(bvh.GetNodes().size()),
+			cull_seconds * 1e6, visible, brute_seconds * 1e6, brute_visible);
+	}
+}
@@ -0,0 +1,136 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "node_grid.h"
+#include <cmath>
+#include <random>
+
+// Bulk insertion of instances into the nodes, the search of SceneManager::AddToHierarchy: the candidates come from
+// NodeGrid, against the former scan over every live node. 10K to 65K instances of radius 1, spread uniformly or in
+// clusters.
+namespace
+{
+	constexpr float kRadius = 1.0f;
+
+	enum class EDistribution { Uniform, Clustered };
+
+	std::vector<BoundingSphere> MakeInstances(uint32 num, EDistribution distribution)
+	{
+		std::mt19937 random(13);
+		std::vector<BoundingSphere> instances;
+		instances.reserve(num);
+		const float side = 1.5f * std::cbrt(static_cast<float>(num));
+		if (distribution == EDistribution::Uniform)
+		{
+			std::uniform_real_distribution<float> coord(0.0f, side);
+			for (uint32 idx = 0; idx < num; idx++)
+			{
+				instances.emplace_back(XMFLOAT3(coord(random), coord(random), coord(random)), kRadius);
+			}
+			return instances;
+		}
+		std::uniform_real_distribution<float> cluster_coord(0.0f, 2.0f * side);
+		std::vector<XMFLOAT3> clusters(64);
+		for (XMFLOAT3& center : clusters)
+		{
+			center = XMFLOAT3(cluster_coord(random), cluster_coord(random), cluster_coord(random));
+		}
+		std::normal_distribution<float> offset(0.0f, side / 16.0f);
+		for (uint32 idx = 0; idx < num; idx++)
+		{
+			const XMFLOAT3& center = clusters[random() % clusters.size()];
+			instances.emplace_back(XMFLOAT3(center.x + offset(random), center.y + offset(random), center.z + offset(random)), kRadius);
+		}
+		return instances;
+	}
+
+	// The node search and the node updates of AddToHierarchy, for instances with mesh radius kRadius and scale 1.
+	class Hierarchy
+	{
+		preallocated_container<BoundingSphere, Const::kStaticNodesCapacity> nodes_;
+		std::array<uint8, Const::kStaticNodesCapacity> members_ = {};
+		NodeGrid grid_;
+		uint32 num_nodes_ = 0;
+		bool use_grid_ = true;
+
+	public:
+		explicit Hierarchy(bool use_grid) : use_grid_(use_grid) {}
+
+		uint32 NumNodes() const { return num_nodes_; }
+
+		// False when there is no free node left.
+		bool Add(const BoundingSphere& instance)
+		{
+			const float max_wanted_dist = 8.0f * kRadius;
+			const float min_wanted_radius = kRadius / 4.0f;
+			const float max_wanted_radius = kRadius * 4.0f;
+			uint32 best_node = Const::kInvalid32;
+			float best_dist_sq = -1.0f;
+			auto find_best_node = [&](uint32_t node_idx)
+			{
+				const BoundingSphere& node = nodes_[node_idx];
+				const XMFLOAT3 diff(instance.Center.x - node.Center.x, instance.Center.y - node.Center.y, instance.Center.z - node.Center.z);
+				const float dist_sq = diff.x * diff.x + diff.y * diff.y + diff.z * diff.z;
+				const bool good = (max_wanted_dist > dist_sq)
+					&& (min_wanted_radius < node.Radius)
+					&& (max_wanted_radius > node.Radius)
+					&& ((best_dist_sq < 0) || (dist_sq < best_dist_sq))
+					&& (members_[node_idx] < Const::kMaxInstancesPerNode);
+				if (!good)
+					return;
+				best_dist_sq = dist_sq;
+				best_node = node_idx;
+			};
+			const float3 center{ instance.Center.x, instance.Center.y, instance.Center.z };
+			if (!use_grid_ || !grid_.ForEachCandidate(center, std::sqrt(max_wanted_dist), min_wanted_radius, max_wanted_radius, num_nodes_, find_best_node))
+			{
+				auto check_node = [&](const BoundingSphere& node) { find_best_node(nodes_.safe_get_index(&node)); };
+				nodes_.for_each(check_node);
+			}
+
+			if (best_node == Const::kInvalid32)
+			{
+				BoundingSphere* const node = nodes_.allocate(instance);
+				if (!node)
+					return false;
+				num_nodes_++;
+				best_node = nodes_.safe_get_index(node);
+			}
+			else
+			{
+				BoundingSphere::CreateMerged(nodes_[best_node], nodes_[best_node], instance);
+			}
+			members_[best_node]++;
+			if (use_grid_)
+			{
+				grid_.Update(best_node, nodes_[best_node]);
+			}
+			return true;
+		}
+	};
+}
+
+BENCH(node_grid_bulk_insert)
+{
+	for (const EDistribution distribution : { EDistribution::Uniform, EDistribution::Clustered })
+	{
+		for (const uint32 full_num : { 10'000u, 32'000u, 65'000u })
+		{
+			const uint32 num = static_cast<uint32>(std::max<uint64>(Harness::Iterations(full_num), 100));
+			const std::vector<BoundingSphere> instances = MakeInstances(num, distribution);
+			for (const bool use_grid : { true, false })
+			{
+				auto hierarchy = std::make_unique<Hierarchy>(use_grid);
+				uint32 added = 0;
+				const Harness::Clock::time_point begin = Harness::Clock::now();
+				for (const BoundingSphere& instance : instances)
+				{
+					added += hierarchy->Add(instance) ? 1 : 0;
+				}
+				const double seconds = Harness::Seconds(Harness::Clock::now() - begin);
+				REPORT("  %-9s %6u instances, %-6s %9.1f ms, %7.2f us/instance, %4u nodes, %5u not added\n",
+					(distribution == EDistribution::Uniform) ? "uniform" : "clustered", num, use_grid ? "grid" : "scan",
+					seconds * 1e3, seconds * 1e6 / num, hierarchy->NumNodes(), num - added);
+			}
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "node_lbvh.h"
+#include <cmath>
+#include <random>
+
+// Bulk build of the nodes with NodeLbvh: the time of NodeLbvh::Build (Morton codes, the parallel radix sort and the
+// split into leaves) from 1K to 1M instances, and the locality of the result. The locality is the mean distance
+// between the centers of consecutive instances, in the Morton order against the insertion order.
+namespace
+{
+	double MeanStep(const std::vector<BoundingSphere>& spheres, auto&& index_of)
+	{
+		double sum = 0.0;
+		for (std::size_t idx = 1; idx < spheres.size(); idx++)
+		{
+			const XMFLOAT3& a = spheres[index_of(idx - 1)].Center;
+			const XMFLOAT3& b = spheres[index_of(idx)].Center;
+			sum += std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+		}
+		return sum / static_cast<double>(spheres.size() - 1);
+	}
+}
+
+BENCH(node_lbvh_build)
+{
+	Jobs::Initialize();
+	std::mt19937 random(31);
+	for (const uint32 full_num : { 1'000u, 10'000u, 65'536u, 1'000'000u })
+	{
+		const uint32 num = static_cast<uint32>(std::max<uint64>(Harness::Iterations(full_num), 100));
+		const float side = 4.0f * std::cbrt(static_cast<float>(num));
+		std::uniform_real_distribution<float> coord(0.0f, side);
+		std::vector<BoundingSphere> spheres;
+		spheres.reserve(num);
+		for (uint32 idx = 0; idx < num; idx++)
+		{
+			spheres.emplace_back(XMFLOAT3(coord(random), coord(random), coord(random)), 1.0f);
+		}
+
+		const uint32 max_leaves = (num + Const::kMaxInstancesPerNode - 1) / Const::kMaxInstancesPerNode * 2;
+		const Harness::Clock::time_point begin = Harness::Clock::now();
+		const NodeLbvh::Clusters clusters = NodeLbvh::Build(spheres, Const::kMaxInstancesPerNode, max_leaves);
+		const double seconds = Harness::Seconds(Harness::Clock::now() - begin);
+
+		const double morton_step = MeanStep(spheres, [&](std::size_t idx) { return clusters.order[idx]; });
+		const double insertion_step = MeanStep(spheres, [](std::size_t idx) { return idx; });
+		REPORT("  %7u instances: %8.2f ms, %6.1f ns/instance, %6u leaves, mean step %6.2f (insertion order %6.2f)\n",
+			num, seconds * 1e3, seconds * 1e9 / num, static_cast<uint32>(clusters.leaves.size()), morton_step, insertion_step);
+	}
+	Jobs::Shutdown();
+}
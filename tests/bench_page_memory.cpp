@@ -0,0 +1,126 @@
+#include "harness.h"
+#include "small_container.h"
+#include "memory/page_memory.h"
+#include <cstring>
+#include <numeric>
+#include <random>
+
+// The per-tick scans of the SceneManager arrays, with the arrays on the heap, in their own regular pages and in
+// large pages (PageBacked): the bulk copy to the upload buffer (UpdateNodes), the sequential for_each over the
+// instances, and the scattered reads of an instance and its node (AddToHierarchy, ApplyTransforms). The scattered
+// reads miss the TLB the most, with 4 KB pages every instance is on another page than its node.
+namespace
+{
+	constexpr int kInstances = 65536;
+	constexpr int kNodes = 4096;
+
+	struct Instance
+	{
+		float transform[10] = {};
+		float radius = 1.0f;
+		uint32 node_idx = 0;
+	};
+	static_assert(sizeof(Instance) == 48, "the size of MeshComponent");
+
+	struct Sphere
+	{
+		float center[3] = {};
+		float radius = 1.0f;
+	};
+
+	struct InstancesInNode
+	{
+		uint16 instances[16] = {};
+	};
+
+	struct StaticArrays
+	{
+		preallocated_container<Instance, kInstances> instances;
+		alignas(kCacheLineSize) preallocated_container<Sphere, kNodes> nodes;
+		alignas(kCacheLineSize) std::array<InstancesInNode, kNodes> inst_in_node;
+	};
+
+	void Fill(StaticArrays& arrays)
+	{
+		for (uint32 idx = 0; idx < kNodes; idx++)
+		{
+			arrays.nodes.allocate()->radius = static_cast<float>(idx);
+		}
+		for (uint32 idx = 0; idx < kInstances; idx++)
+		{
+			arrays.instances.allocate()->node_idx = (idx * 2654435761u) % kNodes;
+		}
+	}
+
+	struct Result
+	{
+		double copy_gb_per_s = 0.0;
+		double scan_ns = 0.0;		// per instance
+		double gather_ns = 0.0;		// per instance
+	};
+
+	Result Measure(StaticArrays& arrays, const std::vector<uint32>& order)
+	{
+		const uint64 rounds = Harness::Iterations(200);
+		std::vector<std::byte> upload(sizeof(Instance) * kInstances + sizeof(arrays.inst_in_node));
+		Result result;
+		Harness::Clock::time_point begin = Harness::Clock::now();
+		for (uint64 round = 0; round < rounds; round++)
+		{
+			std::memcpy(upload.data(), arrays.instances.safe_get_data(), sizeof(Instance) * kInstances);
+			std::memcpy(upload.data() + sizeof(Instance) * kInstances, arrays.inst_in_node.data(), sizeof(arrays.inst_in_node));
+			Harness::DoNotOptimize(upload.data());
+		}
+		result.copy_gb_per_s = static_cast<double>(upload.size() * rounds) / Harness::Seconds(Harness::Clock::now() - begin) / 1e9;
+
+		float sum = 0.0f;
+		auto add_instance = [&](const Instance& instance) { sum += instance.radius; };
+		begin = Harness::Clock::now();
+		for (uint64 round = 0; round < rounds; round++)
+		{
+			arrays.instances.for_each(add_instance);
+		}
+		result.scan_ns = static_cast<double>(Harness::Nanoseconds(Harness::Clock::now() - begin)) / static_cast<double>(rounds * kInstances);
+
+		const Instance* const instances = arrays.instances.safe_get_data();
+		const Sphere* const nodes = arrays.nodes.safe_get_data();
+		begin = Harness::Clock::now();
+		for (uint64 round = 0; round < rounds; round++)
+		{
+			for (const uint32 idx : order)
+			{
+				const Instance& instance = instances[idx];
+				sum += instance.radius + nodes[instance.node_idx].radius;
+			}
+		}
+		result.gather_ns = static_cast<double>(Harness::Nanoseconds(Harness::Clock::now() - begin)) / static_cast<double>(rounds * kInstances);
+		Harness::DoNotOptimize(sum);
+		return result;
+	}
+
+	void ReportResult(const char* layout, const Result& result)
+	{
+		REPORT("  %-24s copy %6.2f GB/s, for_each %5.2f ns/instance, scattered %5.2f ns/instance\n",
+			layout, result.copy_gb_per_s, result.scan_ns, result.gather_ns);
+	}
+}
+
+BENCH(page_memory_scene_scans)
+{
+	std::vector<uint32> order(kInstances);
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), std::mt19937(5));
+
+	{
+		auto arrays = std::make_unique<StaticArrays>();
+		Fill(*arrays);
+		ReportResult("heap", Measure(*arrays, order));
+	}
+	for (const bool large_pages : { false, true })
+	{
+		PageBacked<StaticArrays> arrays(PageMemory::Policy{ .large_pages = large_pages });
+		Fill(*arrays);
+		ReportResult(arrays.IsLargePages() ? "pages, large" : (large_pages ? "pages, large unavailable" : "pages, regular"),
+			Measure(*arrays, order));
+	}
+}
@@ -0,0 +1,89 @@
+#include "harness.h"
+#include "small_container.h"
+#include "third_party/bitset2/bitset2.hpp"
+#include <mutex>
+
+// Allocation and free of preallocated_container slots from 1 to 16 threads at once, lock-free, against the previous
+// scheme: a mutex around bitset2::find_first. Each thread takes a batch of slots and gives it back, repeatedly, in a
+// container whose lower 3/4 are already taken (a late mass spawn).
+namespace
+{
+	constexpr int kSlots = 65536;
+	constexpr uint32 kBatch = 64;
+
+	struct Item
+	{
+		uint64 data[8] = {};
+	};
+
+	class MutexSlots
+	{
+		Bitset2::bitset2<kSlots> free_;
+		std::mutex mutex_;
+
+	public:
+		MutexSlots() { free_.set(); }
+
+		std::size_t Allocate()
+		{
+			std::lock_guard lock(mutex_);
+			const std::size_t idx = free_.find_first();
+			if (idx != Bitset2::bitset2<kSlots>::npos)
+			{
+				free_.set(idx, false);
+			}
+			return idx;
+		}
+
+		void Free(std::size_t idx)
+		{
+			std::lock_guard lock(mutex_);
+			free_.set(idx, true);
+		}
+	};
+
+	template<typename FAllocate, typename FFree>
+	double MeasurePairs(uint32 threads, FAllocate&& allocate, FFree&& free)
+	{
+		const uint64 rounds = std::max<uint64>(Harness::Iterations(20'000) / threads, 1);
+		const double seconds = Harness::RunThreads(threads, [&](uint32)
+		{
+			std::array<std::size_t, kBatch> taken;
+			for (uint64 round = 0; round < rounds; round++)
+			{
+				for (std::size_t& idx : taken)
+				{
+					idx = allocate();
+				}
+				for (const std::size_t idx : taken)
+				{
+					free(idx);
+				}
+			}
+		});
+		return static_cast<double>(rounds * threads * kBatch) / seconds;
+	}
+}
+
+BENCH(preallocated_container_contention)
+{
+	auto container = std::make_unique<preallocated_container<Item, kSlots>>();
+	auto mutex_slots = std::make_unique<MutexSlots>();
+	for (uint32 idx = 0; idx < kSlots / 4 * 3; idx++)
+	{
+		container->allocate();
+		mutex_slots->Allocate();
+	}
+
+	for (const uint32 threads : { 1u, 2u, 4u, 8u, 16u })
+	{
+		const double lock_free = MeasurePairs(threads,
+			[&]() { return container->safe_get_index(container->safe_allocate()); },
+			[&](std::size_t idx) { container->safe_free(&container->safe_get_data()[idx]); });
+		const double locked = MeasurePairs(threads,
+			[&]() { return mutex_slots->Allocate(); },
+			[&](std::size_t idx) { mutex_slots->Free(idx); });
+		REPORT("  threads %2u: lock-free %8.2f M alloc+free/s, mutex + bitset2 %8.2f M alloc+free/s\n",
+			threads, lock_free / 1e6, locked / 1e6);
+	}
+}
@@ -0,0 +1,163 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "mpsc_queue.h"
+#include "ring_queue.h"
+#include "lane_queue.h"
+#include "message_queue.h"
+#include "command_stream.h"
+#include <atomic>
+#include <memory>
+
+// Every inbox queue of the systems with 1 to 32 producers, payloads from 8 to 512 bytes and two enqueue patterns:
+// steady - one message after each piece of producer work, burst - kBurst messages back to back after kBurst pieces.
+// Reports the throughput, the enqueue to dequeue latency percentiles and the heap allocations per message.
+namespace
+{
+	constexpr uint64 kWindow = 8192;	// max messages in flight, the 16 bit count of LockFreeQueue_SingleConsumer
+	constexpr uint32 kBurst = 256;
+	constexpr uint32 kWorkPerMessage = 64;
+
+	template<uint32 kSize>
+	struct Payload
+	{
+		static_assert(kSize > sizeof(uint64));
+		uint64 stamp = 0;	// enqueue time, ns
+		std::byte data[kSize - sizeof(uint64)] = {};
+	};
+
+	template<>
+	struct Payload<sizeof(uint64)>
+	{
+		uint64 stamp = 0;
+	};
+
+	enum class EPattern { Steady, Burst };
+
+	struct Result
+	{
+		double ops = 0.0;
+		uint64 p50 = 0;
+		uint64 p99 = 0;
+		uint64 p999 = 0;
+		double allocations = 0.0;
+	};
+
+	uint64 Now(Harness::Clock::time_point base) { return Harness::Nanoseconds(Harness::Clock::now() - base); }
+
+	void ProducerWork(uint64& state, uint32 pieces)
+	{
+		for (uint32 idx = 0; idx < pieces * kWorkPerMessage; idx++)
+		{
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+		}
+		Harness::DoNotOptimize(state);
+	}
+
+	template<typename TQueue, typename TPayload>
+	Result Measure(uint32 producers, EPattern pattern)
+	{
+		auto queue = std::make_unique<TQueue>();
+		if constexpr (requires(TQueue& it) { it.Preallocate(64); })
+		{
+			queue->Preallocate(64);
+		}
+		const uint64 per_producer = std::max<uint64>(Harness::Iterations(400'000) / producers, kBurst);
+		const uint64 total = per_producer * producers;
+		std::vector<uint64> latencies;
+		latencies.reserve(total);
+		std::atomic<uint64> received = 0;
+		uint64 allocations = 0;
+		const Harness::Clock::time_point base = Harness::Clock::now();
+
+		const double seconds = Harness::RunThreads(producers + 1, [&](uint32 thread_idx)
+		{
+			if (thread_idx == producers)
+			{
+				const uint64 allocations_before = Harness::NumAllocations();
+				uint64 num = 0;
+				while (num < total)
+				{
+					const uint32 consumed = queue->ConsumeAll([&](const auto& payload)
+					{
+						latencies.push_back(Now(base) - payload.stamp);
+					});
+					num += consumed;
+					received.store(num, std::memory_order_release);
+					if constexpr (requires(TQueue& it) { it.Trim(1024); })
+					{
+						if (consumed)
+						{
+							queue->Trim(1024);
+						}
+					}
+				}
+				allocations = Harness::NumAllocations() - allocations_before;
+				return;
+			}
+
+			uint64 work_state = thread_idx;
+			const uint32 group = (pattern == EPattern::Burst) ? kBurst : 1;
+			for (uint64 sent = 0; sent < per_producer; sent += group)
+			{
+				ProducerWork(work_state, group);
+				while ((sent * producers) > (received.load(std::memory_order_acquire) + kWindow))
+				{
+					std::this_thread::yield();
+				}
+				for (uint64 idx = 0; idx < std::min<uint64>(group, per_producer - sent); idx++)
+				{
+					TPayload payload;
+					payload.stamp = Now(base);
+					queue->Enqueue(std::move(payload));
+				}
+			}
+		});
+
+		std::sort(latencies.begin(), latencies.end());
+		Result result;
+		result.ops = static_cast<double>(total) / seconds;
+		result.p50 = Harness::Percentile(latencies, 0.5);
+		result.p99 = Harness::Percentile(latencies, 0.99);
+		result.p999 = Harness::Percentile(latencies, 0.999);
+		result.allocations = static_cast<double>(allocations) / static_cast<double>(total);
+		CHECK(latencies.size() == total);
+		return result;
+	}
+
+	template<template<typename> typename TQueueOf, typename TPayload>
+	void ReportPayload(const char* queue_name)
+	{
+		for (const EPattern pattern : { EPattern::Steady, EPattern::Burst })
+		{
+			for (const uint32 producers : { 1u, 2u, 4u, 8u, 16u, 32u })
+			{
+				const Result result = Measure<TQueueOf<TPayload>, TPayload>(producers, pattern);
+				REPORT("  %-14s %4zuB %-6s producers %2u: %8.3f Mmsg/s  p50 %8llu ns  p99 %9llu ns  p999 %9llu ns  %.4f alloc/msg\n",
+					queue_name, sizeof(TPayload), (pattern == EPattern::Steady) ? "steady" : "burst", producers, result.ops / 1e6,
+					static_cast<unsigned long long>(result.p50), static_cast<unsigned long long>(result.p99),
+					static_cast<unsigned long long>(result.p999), result.allocations);
+			}
+		}
+	}
+
+	template<template<typename> typename TQueueOf>
+	void ReportQueue(const char* queue_name)
+	{
+		ReportPayload<TQueueOf, Payload<8>>(queue_name);
+		ReportPayload<TQueueOf, Payload<64>>(queue_name);
+		ReportPayload<TQueueOf, Payload<88>>(queue_name);	// over a cache line, not a multiple of it
+		ReportPayload<TQueueOf, Payload<512>>(queue_name);
+	}
+
+	template<typename T> using BlockQueueOf = LockFreeQueue_SingleConsumer<T, 32>;
+	template<typename T> using RingQueueOf = RingQueue_SingleConsumer<T, 4096>;
+	template<typename T> using LaneQueueOf = LaneQueue_SingleConsumer<T>;
+	template<typename T> using NodeQueueOf = TMessageQueue<T>;
+	template<typename T> using CommandStreamOf = CommandStream_SingleConsumer<64 * 1024, T>;
+}
+
+BENCH(queue_suite_lock_free_queue) { ReportQueue<BlockQueueOf>("LockFreeQueue"); }
+BENCH(queue_suite_ring_queue) { ReportQueue<RingQueueOf>("RingQueue"); }
+BENCH(queue_suite_lane_queue) { ReportQueue<LaneQueueOf>("LaneQueue"); }
+BENCH(queue_suite_message_queue) { ReportQueue<NodeQueueOf>("TMessageQueue"); }
+BENCH(queue_suite_command_stream) { ReportQueue<CommandStreamOf>("CommandStream"); }
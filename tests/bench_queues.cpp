@@ -0,0 +1,88 @@
+#include "harness.h"
+#include "mpsc_queue.h"
+#include "ring_queue.h"
+#include <atomic>
+#include <memory>
+
+// Throughput of the system inbox queues at 1, 4 and 16 producers, with a single consumer draining either one
+// message at a time (Pop) or in batches (ConsumeAll). The producers stay at most kWindow messages ahead of the
+// consumer, as the systems do within a frame, so the backlog fits the 16 bit count of LockFreeQueue_SingleConsumer.
+namespace
+{
+	constexpr uint64 kWindow = 8192;
+
+	struct Message
+	{
+		uint64 producer = 0;
+		uint64 sequence = 0;
+	};
+
+	enum class EDrain { Pop, ConsumeAll };
+
+	template<typename TQueue>
+	double MeasureThroughput(uint32 producers, uint64 per_producer, EDrain drain)
+	{
+		auto queue = std::make_unique<TQueue>();
+		const uint64 total = producers * per_producer;
+		std::vector<uint64> next_sequence(producers, 0);
+		std::atomic<uint64> received = 0;
+		bool ordered = true;
+		auto receive = [&](const Message& msg)
+		{
+			ordered &= (next_sequence[msg.producer]++ == msg.sequence);
+			received.store(received.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		};
+		const double seconds = Harness::RunThreads(producers + 1, [&](uint32 thread_idx)
+		{
+			if (thread_idx == producers)
+			{
+				while (received < total)
+				{
+					if (drain == EDrain::Pop)
+					{
+						if (std::optional<Message> msg = queue->Pop())
+						{
+							receive(*msg);
+						}
+					}
+					else
+					{
+						queue->ConsumeAll(receive);
+					}
+				}
+				return;
+			}
+			for (uint64 sequence = 0; sequence < per_producer; sequence++)
+			{
+				while ((sequence * producers) > (received.load(std::memory_order_acquire) + kWindow))
+				{
+					std::this_thread::yield();
+				}
+				queue->Emplace(Message{ thread_idx, sequence });
+			}
+		});
+		CHECK(ordered && (received == total));
+		return static_cast<double>(total) / seconds;
+	}
+
+	template<typename TQueue>
+	void ReportThroughput(const char* queue_name)
+	{
+		for (const EDrain drain : { EDrain::Pop, EDrain::ConsumeAll })
+		{
+			for (const uint32 producers : { 1u, 4u, 16u })
+			{
+				const uint64 per_producer = Harness::Iterations(2'000'000) / producers;
+				const double ops = MeasureThroughput<TQueue>(producers, per_producer, drain);
+				REPORT("  %-28s %-10s producers %2u: %8.2f Mmsg/s\n", queue_name,
+					(drain == EDrain::Pop) ? "Pop" : "ConsumeAll", producers, ops / 1e6);
+			}
+		}
+	}
+}
+
+BENCH(queue_ring_vs_block_throughput)
+{
+	ReportThroughput<LockFreeQueue_SingleConsumer<Message, 32>>("LockFreeQueue_SingleConsumer");
+	ReportThroughput<RingQueue_SingleConsumer<Message, 1024>>("RingQueue_SingleConsumer");
+}
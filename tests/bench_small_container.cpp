@@ -0,0 +1,92 @@
+#include "harness.h"
+#include "small_container.h"
+#include <string>
+
+// Many short containers, like the node lists of the grid cells: fill each with a few elements, read them back and
+// drop them. small_container (inline storage, small_vector style) against std::vector, for the stored element types.
+namespace
+{
+	constexpr uint32 kContainers = 1024;
+
+	template<typename T>
+	T MakeElement(uint32 idx)
+	{
+		if constexpr (std::is_same_v<T, std::string>)
+		{
+			return std::string(24, static_cast<char>('a' + idx % 26));
+		}
+		else if constexpr (std::is_pointer_v<T>)
+		{
+			return reinterpret_cast<T>(static_cast<uintptr_t>(idx + 1) * 16);
+		}
+		else
+		{
+			return static_cast<T>(idx);
+		}
+	}
+
+	template<typename T>
+	uint64 Weight(const T& element)
+	{
+		if constexpr (std::is_same_v<T, std::string>)
+		{
+			return element.size();
+		}
+		else if constexpr (std::is_pointer_v<T>)
+		{
+			return reinterpret_cast<uintptr_t>(element);
+		}
+		else
+		{
+			return element;
+		}
+	}
+
+	template<typename TContainer, typename T>
+	double NanosecondsPerElement(uint32 elements)
+	{
+		const uint64 rounds = std::max<uint64>(Harness::Iterations(2'000'000) / (kContainers * elements), 1);
+		uint64 sum = 0;
+		const Harness::Clock::time_point begin = Harness::Clock::now();
+		for (uint64 round = 0; round < rounds; round++)
+		{
+			std::vector<TContainer> containers(kContainers);
+			for (TContainer& container : containers)
+			{
+				for (uint32 idx = 0; idx < elements; idx++)
+				{
+					container.emplace_back(MakeElement<T>(idx));
+				}
+			}
+			for (const TContainer& container : containers)
+			{
+				for (const T& element : container)
+				{
+					sum += Weight(element);
+				}
+			}
+		}
+		Harness::DoNotOptimize(sum);
+		return static_cast<double>(Harness::Nanoseconds(Harness::Clock::now() - begin)) / static_cast<double>(rounds * kContainers * elements);
+	}
+
+	template<typename T>
+	void ReportType(const char* type_name)
+	{
+		for (const uint32 elements : { 1u, 4u, 16u, 64u })
+		{
+			const double vector = NanosecondsPerElement<std::vector<T>, T>(elements);
+			const double small = NanosecondsPerElement<small_container<T, 4>, T>(elements);
+			REPORT("  %-12s %2u elements: std::vector %7.2f ns/element, small_container<4> %7.2f ns/element\n",
+				type_name, elements, vector, small);
+		}
+	}
+}
+
+BENCH(small_container_vs_vector)
+{
+	ReportType<uint16>("uint16");
+	ReportType<uint32>("uint32");
+	ReportType<const void*>("pointer");
+	ReportType<std::string>("std::string");
+}
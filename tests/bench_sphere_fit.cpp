@@ -0,0 +1,56 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "primitives/sphere_fit.h"
+#include <random>
+
+using DirectX::BoundingSphere;
+using DirectX::XMFLOAT3;
+
+// Refit of a node from its member spheres: SphereFit::Enclose against the former merge of each member in turn
+// (BoundingSphere::CreateMerged in insertion order). Reports the time per fit and the mean radius of the fits
+// relative to the merged ones, for nodes of 4 to 64 members.
+BENCH(sphere_fit_node_refit)
+{
+	constexpr uint32 kSets = 1024;
+	std::mt19937 random(19);
+	std::uniform_real_distribution<float> coord(-8.0f, 8.0f);
+	std::uniform_real_distribution<float> radius(0.5f, 2.0f);
+	for (const uint32 members : { 4u, 16u, 64u })
+	{
+		std::vector<BoundingSphere> spheres;
+		for (uint32 idx = 0; idx < kSets * members; idx++)
+		{
+			spheres.emplace_back(XMFLOAT3(coord(random), coord(random), coord(random)), radius(random));
+		}
+		const uint64 rounds = std::max<uint64>(Harness::Iterations(2'000'000) / (kSets * members), 1);
+
+		double fit_radius = 0.0;
+		Harness::Clock::time_point begin = Harness::Clock::now();
+		for (uint64 round = 0; round < rounds; round++)
+		{
+			for (uint32 set = 0; set < kSets; set++)
+			{
+				fit_radius += SphereFit::Enclose({ spheres.data() + set * members, members }).Radius;
+			}
+		}
+		const double fit_ns = static_cast<double>(Harness::Nanoseconds(Harness::Clock::now() - begin)) / static_cast<double>(rounds * kSets);
+
+		double merged_radius = 0.0;
+		begin = Harness::Clock::now();
+		for (uint64 round = 0; round < rounds; round++)
+		{
+			for (uint32 set = 0; set < kSets; set++)
+			{
+				BoundingSphere merged = spheres[set * members];
+				for (uint32 idx = 1; idx < members; idx++)
+				{
+					BoundingSphere::CreateMerged(merged, merged, spheres[set * members + idx]);
+				}
+				merged_radius += merged.Radius;
+			}
+		}
+		const double merged_ns = static_cast<double>(Harness::Nanoseconds(Harness::Clock::now() - begin)) / static_cast<double>(rounds * kSets);
+		REPORT("  %2u members: Enclose %7.1f ns/fit, CreateMerged chain %7.1f ns/fit, radius %.3f of the chain\n",
+			members, fit_ns, merged_ns, fit_radius / merged_radius);
+	}
+}
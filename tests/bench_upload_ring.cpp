@@ -0,0 +1,88 @@
+#include "harness.h"
+#include "graphics/upload_ring.h"
+#include <random>
+
+// Mesh streaming: every kBurstEvery frames a burst of meshes (64 KB to 1 MB each) is uploaded, and the GPU completes
+// a frame kLatency frames after it was submitted. When an allocation fails the producer must wait for the GPU. The ring
+// waits for the oldest batch only, the linear allocator (the former UploadBuffer) is reclaimed only by a reset, after
+// everything is done.
+namespace
+{
+	constexpr uint64 kMB = 1024 * 1024;
+	constexpr uint64 kCapacity = 32 * kMB;
+	constexpr uint64 kLatency = 2;
+	constexpr uint64 kBurstEvery = 8;
+
+	struct Result
+	{
+		uint64 stalls = 0;
+		uint64 frames_waited = 0;	// frames of GPU work the producer waited for
+		double ns_per_allocation = 0.0;
+	};
+
+	Result Simulate(bool ring_mode, uint32 frames, uint32 burst_meshes)
+	{
+		UploadRing ring;
+		ring.initialize(kCapacity);
+		std::mt19937 random(3);
+		Result result;
+		uint64 allocations = 0;
+		uint64 checksum = 0;
+		uint64 completed = 0;
+		const Harness::Clock::time_point begin = Harness::Clock::now();
+		for (uint64 frame = 1; frame <= frames; frame++)
+		{
+			completed = std::max(completed, (frame > kLatency) ? (frame - kLatency) : 0);
+			if (ring_mode)
+			{
+				ring.retire(completed);
+			}
+			const uint32 meshes = (frame % kBurstEvery) ? 4 : burst_meshes;
+			for (uint32 mesh = 0; mesh < meshes; mesh++)
+			{
+				const uint64 size = (64 * 1024) << (random() % 5);
+				uint64 offset = ring.allocate(size, 256);
+				while (offset == UploadRing::kInvalidOffset)
+				{
+					result.stalls++;
+					if (ring_mode && ring.has_in_flight())
+					{
+						const uint64 wait_for = ring.get_oldest_fence_value();
+						result.frames_waited += wait_for - completed;
+						completed = wait_for;
+						ring.retire(completed);
+					}
+					else
+					{
+						// The pending copies are submitted as frame, then the whole buffer is waited for.
+						result.frames_waited += frame - completed;
+						completed = frame;
+						ring.reset();
+					}
+					offset = ring.allocate(size, 256);
+				}
+				checksum += offset;
+				allocations++;
+			}
+			ring.submit(frame);
+		}
+		Harness::DoNotOptimize(checksum);
+		result.ns_per_allocation = static_cast<double>(Harness::Nanoseconds(Harness::Clock::now() - begin)) / static_cast<double>(allocations);
+		return result;
+	}
+}
+
+BENCH(upload_ring_mesh_streaming_bursts)
+{
+	const uint32 frames = static_cast<uint32>(Harness::Iterations(100'000));
+	for (const uint32 burst_meshes : { 16u, 48u, 128u })
+	{
+		for (const bool ring_mode : { false, true })
+		{
+			const Result result = Simulate(ring_mode, frames, burst_meshes);
+			REPORT("  %-6s bursts of %3u meshes: %8llu stalls, %8llu frames waited, %6.1f ns/allocation\n",
+				ring_mode ? "ring" : "linear", burst_meshes, static_cast<unsigned long long>(result.stalls),
+				static_cast<unsigned long long>(result.frames_waited), result.ns_per_allocation);
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#include "harness.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+
+namespace Harness
+{
+	namespace
+	{
+		struct Entry
+		{
+			const char* name = nullptr;
+			Function func = nullptr;
+			bool bench = false;
+		};
+
+		std::vector<Entry>& Registry()
+		{
+			static std::vector<Entry> registry;
+			return registry;
+		}
+
+		bool g_quick = false;
+		std::atomic<uint64> g_allocations = 0;
+	}
+
+	Registrar::Registrar(const char* name, Function func, bool bench)
+	{
+		Registry().push_back(Entry{ name, func, bench });
+	}
+
+	void Fail(const char* expression, const char* file, int line)
+	{
+		throw Failure{ expression, file, line };
+	}
+
+	bool IsQuick() { return g_quick; }
+
+	uint64 NumAllocations() { return g_allocations.load(std::memory_order_relaxed); }
+}
+
+void* operator new(std::size_t size)
+{
+	Harness::g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+int main(int argc, char** argv)
+{
+	using namespace Harness;
+	bool bench = false;
+	std::string_view filter;
+	for (int idx = 1; idx < argc; idx++)
+	{
+		const std::string_view arg = argv[idx];
+		if (arg == "--bench")
+		{
+			bench = true;
+		}
+		else if (arg == "--quick")
+		{
+			g_quick = true;
+		}
+		else
+		{
+			filter = arg;
+		}
+	}
+
+	uint32 run = 0;
+	uint32 failed = 0;
+	for (const Entry& entry : Registry())
+	{
+		if ((entry.bench != bench) || (std::string_view(entry.name).find(filter) == std::string_view::npos))
+			continue;
+		run++;
+		std::printf("[ RUN  ] %s\n", entry.name);
+		std::fflush(stdout);
+		try
+		{
+			entry.func();
+			std::printf("[  OK  ] %s\n", entry.name);
+		}
+		catch (const Failure& failure)
+		{
+			failed++;
+			std::printf("[ FAIL ] %s\n  %s:%d: CHECK(%s)\n", entry.name, failure.file, failure.line, failure.expression);
+		}
+		std::fflush(stdout);
+	}
+	std::printf("%u run, %u failed\n", run, failed);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <latch>
+#include <algorithm>
+#include <cstdio>
+#include "common/base_types.h"
+
+// Minimal registry of unit tests and benchmarks for the platform independent parts of utils/, so they build and
+// run without the engine or a third party framework.
+//   engine_tests [filter]					runs the tests
+//   engine_tests --bench [--quick] [filter]	runs the benchmarks, --quick with tiny sizes (smoke run)
+namespace Harness
+{
+	using Function = void (*)();
+
+	struct Registrar
+	{
+		Registrar(const char* name, Function func, bool bench);
+	};
+
+	struct Failure
+	{
+		const char* expression = nullptr;
+		const char* file = nullptr;
+		int line = 0;
+	};
+
+	[[noreturn]] void Fail(const char* expression, const char* file, int line);
+
+	// Benchmarks run with their smallest sizes.
+	bool IsQuick();
+	inline uint64 Iterations(uint64 full) { return IsQuick() ? std::max<uint64>(full / 1000, 1) : full; }
+
+	// Calls of the global operator new, on all threads.
+	uint64 NumAllocations();
+
+	using Clock = std::chrono::steady_clock;
+	inline double Seconds(Clock::duration duration) { return std::chrono::duration<double>(duration).count(); }
+	inline uint64 Nanoseconds(Clock::duration duration) { return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(); }
+
+	// Value at p (0..1) of sorted samples.
+	template<typename T>
+	T Percentile(const std::vector<T>& sorted, double p)
+	{
+		if (sorted.empty())
+			return T{};
+		const std::size_t idx = std::min(sorted.size() - 1, static_cast<std::size_t>(p * static_cast<double>(sorted.size())));
+		return sorted[idx];
+	}
+
+	// Runs func(thread_idx) on num threads released together. Returns the wall time in seconds.
+	template<typename F>
+	double RunThreads(uint32 num, F&& func)
+	{
+		std::latch start(num + 1);
+		std::vector<std::thread> threads;
+		threads.reserve(num);
+		for (uint32 idx = 0; idx < num; idx++)
+		{
+			threads.emplace_back([&, idx]() { start.arrive_and_wait(); func(idx); });
+		}
+		const Clock::time_point begin = Clock::now();
+		start.arrive_and_wait();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		return Seconds(Clock::now() - begin);
+	}
+
+	// Keeps the compiler from dropping a computed value.
+	template<typename T>
+	void DoNotOptimize(const T& value)
+	{
+#if defined(_MSC_VER)
+		static volatile const void* sink;
+		sink = &value;
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+}
+
+#define HARNESS_CONCAT_INNER(A, B) A##B
+#define HARNESS_CONCAT(A, B) HARNESS_CONCAT_INNER(A, B)
+#define HARNESS_REGISTER(NAME, BENCH) static void NAME(); \
+	static Harness::Registrar HARNESS_CONCAT(NAME, _registrar)(#NAME, &NAME, BENCH); \
+	static void NAME()
+
+#define TEST(NAME) HARNESS_REGISTER(NAME, false)
+#define BENCH(NAME) HARNESS_REGISTER(NAME, true)
+#define CHECK(X) do { if (!(X)) Harness::Fail(#X, __FILE__, __LINE__); } while (false)
+#define REPORT(...) std::printf(__VA_ARGS__)
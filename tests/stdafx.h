@@ -0,0 +1,24 @@
+#pragma once
+
+// Stands in for the engine's precompiled header, when utils/ sources are built into the tests.
+#if defined(_WIN32)
+#include "../stdafx.h"
+#else
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+#include "utils/mpsc_queue.h"
+
+using UINT_PTR = uintptr_t;
+#endif
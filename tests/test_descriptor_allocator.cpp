@@ -0,0 +1,84 @@
+#include "harness.h"
+#include "graphics/descriptor_allocator.h"
+#include <random>
+
+TEST(descriptor_allocator_free_list_reuses_freed_slots)
+{
+	DescriptorAllocator allocator;
+	allocator.initialize(8, DescriptorAllocator::EMode::FreeList, 2);
+	CHECK(allocator.is_set(0) && allocator.is_set(1) && !allocator.is_set(2));
+	for (uint32 idx = 2; idx < 8; idx++)
+	{
+		CHECK(allocator.allocate() == idx);
+	}
+	CHECK(allocator.allocate() == DescriptorAllocator::kInvalidIndex);
+	CHECK(allocator.get_num_allocated() == 8);
+
+	// The last freed slot is reused first.
+	allocator.free(3);
+	allocator.free(6);
+	CHECK(!allocator.is_set(3) && !allocator.is_set(6));
+	CHECK(allocator.allocate() == 6);
+	CHECK(allocator.allocate() == 3);
+	CHECK(allocator.allocate() == DescriptorAllocator::kInvalidIndex);
+
+	allocator.clear(1);
+	CHECK(allocator.get_num_allocated() == 1);
+	CHECK(allocator.allocate() == 1);
+}
+
+// Random allocate and free, compared with the set of taken slots after each one.
+TEST(descriptor_allocator_free_list_matches_model)
+{
+	constexpr uint32 kCapacity = 100;
+	DescriptorAllocator allocator;
+	allocator.initialize(kCapacity, DescriptorAllocator::EMode::FreeList);
+	std::vector<bool> expected(kCapacity, false);
+	std::vector<uint32> taken;
+	std::mt19937 random(11);
+	for (uint32 step = 0; step < 5000; step++)
+	{
+		if (taken.empty() || (random() % 2))
+		{
+			const uint32 idx = allocator.allocate();
+			if (taken.size() == kCapacity)
+			{
+				CHECK(idx == DescriptorAllocator::kInvalidIndex);
+				continue;
+			}
+			CHECK((idx < kCapacity) && !expected[idx]);
+			expected[idx] = true;
+			taken.push_back(idx);
+		}
+		else
+		{
+			const std::size_t pos = random() % taken.size();
+			const uint32 idx = taken[pos];
+			taken[pos] = taken.back();
+			taken.pop_back();
+			allocator.free(idx);
+			expected[idx] = false;
+		}
+		CHECK(allocator.get_num_allocated() == taken.size());
+	}
+	for (uint32 idx = 0; idx < kCapacity; idx++)
+	{
+		CHECK(allocator.is_set(idx) == expected[idx]);
+	}
+}
+
+TEST(descriptor_allocator_linear_ranges_and_clear)
+{
+	DescriptorAllocator allocator;
+	allocator.initialize(16, DescriptorAllocator::EMode::Linear, 4);
+	CHECK(allocator.allocate(3) == 4);
+	CHECK(allocator.allocate() == 7);
+	CHECK(allocator.allocate(9) == DescriptorAllocator::kInvalidIndex);
+	CHECK(allocator.allocate(8) == 8);
+	CHECK(allocator.allocate() == DescriptorAllocator::kInvalidIndex);
+	CHECK(allocator.is_set(15) && (allocator.get_num_allocated() == 16));
+
+	allocator.clear(4);
+	CHECK(allocator.is_set(3) && !allocator.is_set(4));
+	CHECK(allocator.allocate(12) == 4);
+}
@@ -0,0 +1,98 @@
+#include "harness.h"
+#include "memory/frame_arena.h"
+#include <memory_resource>
+
+TEST(frame_arena_aligns_addresses)
+{
+	FrameArena arena(4096);
+	for (const std::size_t alignment : { 1, 8, 16, 64, 256, 1024 })
+	{
+		Harness::DoNotOptimize(arena.allocate(1, 1));
+		void* const ptr = arena.allocate(64, alignment);
+		CHECK((reinterpret_cast<uintptr_t>(ptr) % alignment) == 0);
+	}
+	CHECK(arena.GetFallbackNum() == 0);
+	CHECK(arena.GetUsed() <= arena.GetCapacity());
+}
+
+TEST(frame_arena_falls_back_and_resets)
+{
+	FrameArena arena(1024);
+	void* const first = arena.allocate(1000, 8);
+	CHECK(arena.GetUsed() == 1000);
+	void* const fallback = arena.allocate(100, 8);
+	CHECK(fallback && (fallback != first));
+	CHECK(arena.GetFallbackNum() == 1);
+	CHECK(arena.GetUsed() == 1000);
+
+	arena.Reset();
+	CHECK((arena.GetUsed() == 0) && (arena.GetFallbackNum() == 0) && (arena.GetPeak() == 1000));
+	CHECK(arena.allocate(1024, 8) == first);
+}
+
+TEST(frame_arena_scope_sets_the_current_resource)
+{
+	CHECK(FrameArena::Current() == nullptr);
+	CHECK(FrameArena::CurrentResource() == std::pmr::get_default_resource());
+	FrameArena arena(4096);
+	{
+		FrameArena::Scope scope(&arena);
+		CHECK(FrameArena::Current() == &arena);
+		std::pmr::vector<uint64> scratch(FrameArena::CurrentResource());
+		const uint64 allocations = Harness::NumAllocations();
+		scratch.resize(100);
+		CHECK(Harness::NumAllocations() == allocations);
+		CHECK(arena.GetUsed() >= 100 * sizeof(uint64));
+	}
+	CHECK(FrameArena::Current() == nullptr);
+}
+
+namespace
+{
+	// Upstream resource counting the live allocations.
+	class CountingResource : public std::pmr::memory_resource
+	{
+	public:
+		uint32 live = 0;
+
+	protected:
+		void* do_allocate(std::size_t bytes, std::size_t alignment) override
+		{
+			live++;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+		void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+		{
+			live--;
+			std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+	};
+}
+
+TEST(frame_arena_rewinds_to_a_mark)
+{
+	CountingResource upstream;
+	FrameArena arena(1024, &upstream);
+	void* const kept = arena.allocate(200, 8);
+	const FrameArena::Mark mark = arena.GetMark();
+	void* const scratch = arena.allocate(800, 8);
+	CHECK(arena.allocate(100, 8) && (upstream.live == 1));
+
+	arena.Rewind(mark);
+	CHECK((arena.GetUsed() == 200) && (upstream.live == 0) && (arena.GetFallbackNum() == 1));
+	CHECK(arena.allocate(800, 8) == scratch);
+	CHECK(kept != scratch);
+
+	// Twice the scratch of the capacity, one after the other, fits without a fallback.
+	arena.Reset();
+	for (uint32 pass = 0; pass < 2; pass++)
+	{
+		FrameArena::RewindScope rewind(&arena);
+		Harness::DoNotOptimize(arena.allocate(1000, 8));
+	}
+	CHECK((arena.GetUsed() == 0) && (arena.GetFallbackNum() == 0));
+
+	// Without an arena it does nothing.
+	FrameArena::RewindScope no_arena(nullptr);
+}
@@ -0,0 +1,192 @@
+#include "harness.h"
+#include "hierarchical_bitmap.h"
+#include <bitset>
+#include <random>
+
+// Random operations, compared with std::bitset after each one. N is not a multiple of 64, so the last leaf is partial.
+TEST(hierarchical_bitmap_matches_bitset)
+{
+	constexpr std::size_t N = 64 * 64 + 37;
+	using Bitmap = HierarchicalBitmap<N>;
+	Bitmap bitmap;
+	std::bitset<N> expected;
+	std::mt19937 random(7);
+
+	auto find_from = [&](bool value, std::size_t start)
+	{
+		for (std::size_t idx = start; idx < N; idx++)
+		{
+			if (expected[idx] == value)
+				return idx;
+		}
+		return Bitmap::npos;
+	};
+
+	for (uint32 step = 0; step < 2000; step++)
+	{
+		const std::size_t idx = random() % N;
+		switch (random() % 4)
+		{
+		case 0: bitmap.set(idx); expected.set(idx); break;
+		case 1: bitmap.clear(idx); expected.reset(idx); break;
+		case 2:
+		{
+			const std::size_t num = random() % (N - idx + 1);
+			bitmap.set_range(idx, num);
+			for (std::size_t it = idx; it < idx + num; it++) { expected.set(it); }
+			break;
+		}
+		default:
+		{
+			const std::size_t num = random() % (N - idx + 1);
+			bitmap.clear_range(idx, num);
+			for (std::size_t it = idx; it < idx + num; it++) { expected.reset(it); }
+			break;
+		}
+		}
+
+		CHECK(bitmap.count() == expected.count());
+		CHECK(bitmap.find_first_set() == find_from(true, 0));
+		CHECK(bitmap.find_first_clear() == find_from(false, 0));
+		CHECK(bitmap.find_next_set(idx) == find_from(true, idx + 1));
+		CHECK(bitmap.find_next_clear(idx) == find_from(false, idx + 1));
+	}
+
+	std::size_t visited = 0;
+	bool in_order = true;
+	std::size_t previous = 0;
+	bitmap.for_each_set([&](std::size_t idx)
+	{
+		in_order &= expected[idx] && (!visited || (idx > previous));
+		previous = idx;
+		visited++;
+	});
+	CHECK(in_order && (visited == expected.count()));
+}
+
+TEST(atomic_hierarchical_bitmap_acquires_each_bit_once)
+{
+	constexpr std::size_t N = 4096;
+	AtomicHierarchicalBitmap<N> bitmap;
+	bitmap.set_all();
+	std::vector<std::atomic<uint32>> taken(N);
+	constexpr uint32 kThreads = 8;
+	Harness::RunThreads(kThreads, [&](uint32 thread_idx)
+	{
+		for (std::size_t idx = bitmap.acquire_set(thread_idx * 512); idx != bitmap.npos; idx = bitmap.acquire_set(idx))
+		{
+			taken[idx]++;
+		}
+	});
+	CHECK(std::all_of(taken.begin(), taken.end(), [](const std::atomic<uint32>& it) { return it == 1; }));
+	CHECK(bitmap.find_first_set() == bitmap.npos);
+}
+
+// acquire_set and set against std::bitset, the clear bits are searched through the clear summary. Two summary words,
+// the last leaf is partial.
+TEST(atomic_hierarchical_bitmap_matches_bitset)
+{
+	constexpr std::size_t N = 2 * 64 * 64 + 37;
+	using Bitmap = AtomicHierarchicalBitmap<N>;
+	Bitmap bitmap;
+	std::bitset<N> expected;
+	std::mt19937 random(11);
+
+	auto find_from = [&](bool value, std::size_t start)
+	{
+		for (std::size_t idx = start; idx < N; idx++)
+		{
+			if (expected[idx] == value)
+				return idx;
+		}
+		return Bitmap::npos;
+	};
+
+	for (uint32 step = 0; step < 4000; step++)
+	{
+		const std::size_t idx = random() % N;
+		switch (random() % 8)
+		{
+		case 0:
+			bitmap.set_all();
+			expected.set();
+			break;
+		case 1: case 2: case 3:
+		{
+			// The lowest set bit from the leaf of the hint, wrapping around.
+			const std::size_t in_leaves_after = find_from(true, idx - idx % 64);
+			const std::size_t acquired = bitmap.acquire_set(idx);
+			CHECK(acquired == ((in_leaves_after != Bitmap::npos) ? in_leaves_after : find_from(true, 0)));
+			if (acquired != Bitmap::npos)
+			{
+				CHECK(expected[acquired]);
+				expected.reset(acquired);
+			}
+			break;
+		}
+		default:
+			if (!expected[idx])
+			{
+				bitmap.set(idx);
+				expected.set(idx);
+			}
+			break;
+		}
+
+		CHECK(bitmap.find_first_set() == find_from(true, 0));
+		CHECK(bitmap.find_first_clear() == find_from(false, 0));
+		CHECK(bitmap.find_next_clear(idx) == find_from(false, idx + 1));
+	}
+
+	std::size_t visited = 0;
+	bool in_order = true;
+	std::size_t previous = 0;
+	bitmap.for_each_clear([&](std::size_t idx)
+	{
+		in_order &= !expected[idx] && (!visited || (idx > previous));
+		previous = idx;
+		visited++;
+	});
+	CHECK(in_order && (visited == N - expected.count()));
+}
+
+// Threads acquire bits and give some of them back. Afterwards the clear bits, found through the clear summary, are
+// the ones still held.
+TEST(atomic_hierarchical_bitmap_clear_summary_after_churn)
+{
+	constexpr std::size_t N = 4096;
+	AtomicHierarchicalBitmap<N> bitmap;
+	bitmap.set_all();
+	std::vector<std::atomic<uint32>> held(N);
+	constexpr uint32 kThreads = 8;
+	Harness::RunThreads(kThreads, [&](uint32 thread_idx)
+	{
+		std::mt19937 random(thread_idx);
+		for (uint32 it = 0; it < 2000; it++)
+		{
+			const std::size_t idx = bitmap.acquire_set(random() % N);
+			if (idx == bitmap.npos)
+				continue;
+			if (random() % 4)
+			{
+				bitmap.set(idx);
+			}
+			else
+			{
+				held[idx]++;
+			}
+		}
+	});
+	std::size_t visited = 0;
+	bool only_held = true;
+	std::size_t first = bitmap.npos;
+	bitmap.for_each_clear([&](std::size_t idx)
+	{
+		only_held &= (held[idx] == 1);
+		first = std::min(first, idx);
+		visited++;
+	});
+	const std::size_t num_held = std::count_if(held.begin(), held.end(), [](const std::atomic<uint32>& it) { return it == 1; });
+	CHECK(only_held && (visited == num_held));
+	CHECK(bitmap.find_first_clear() == first);
+}
@@ -0,0 +1,96 @@
+#include "harness.h"
+#include "jobs/jobs.h"
+#include <atomic>
+
+namespace
+{
+	struct WorkersScope
+	{
+		WorkersScope(uint32 num_workers) { Jobs::Initialize(num_workers); }
+		~WorkersScope() { Jobs::Shutdown(); }
+	};
+}
+
+TEST(jobs_parallel_for_covers_range)
+{
+	WorkersScope workers(3);
+	std::vector<std::atomic<uint32>> visits(10'000);
+	Jobs::ParallelFor(static_cast<uint32>(visits.size()), 64, [&](uint32 idx) { visits[idx]++; });
+	CHECK(std::all_of(visits.begin(), visits.end(), [](const std::atomic<uint32>& it) { return it == 1; }));
+}
+
+TEST(jobs_schedule_after_dependency)
+{
+	WorkersScope workers(2);
+	std::atomic<uint32> done = 0;
+	bool dependency_done_first = true;
+	Jobs::Counter first;
+	Jobs::Counter second;
+	for (uint32 idx = 0; idx < 16; idx++)
+	{
+		Jobs::Schedule([&]() { done++; }, &first);
+	}
+	Jobs::ScheduleAfter(first, [&]() { dependency_done_first = (done == 16); }, &second);
+	Jobs::Wait(second);
+	CHECK(dependency_done_first);
+}
+
+// The only worker is busy, so an unrelated job waits in the injected queue while the main thread waits for its
+// ParallelFor. The main thread must not run it.
+TEST(jobs_wait_runs_only_the_waited_jobs)
+{
+	WorkersScope workers(1);
+	std::atomic_bool blocker_started = false;
+	std::atomic_bool release_blocker = false;
+	Jobs::Counter blocker;
+	Jobs::Schedule([&]()
+	{
+		blocker_started = true;
+		while (!release_blocker) { std::this_thread::yield(); }
+	}, &blocker);
+	while (!blocker_started) { std::this_thread::yield(); }
+
+	std::atomic<std::thread::id> unrelated_thread;
+	Jobs::Counter unrelated;
+	Jobs::Schedule([&]() { unrelated_thread = std::this_thread::get_id(); }, &unrelated);
+
+	std::atomic<uint32> visits = 0;
+	Jobs::ParallelFor(64, 1, [&](uint32) { visits++; });
+	CHECK(visits == 64);
+	CHECK(unrelated_thread.load() == std::thread::id());
+
+	release_blocker = true;
+	Jobs::Wait(blocker);
+	Jobs::Wait(unrelated);
+	CHECK(unrelated_thread.load() != std::this_thread::get_id());
+}
+
+// A job waiting for its nested ParallelFor helps with the nested batches, but not with the outer ones.
+TEST(jobs_nested_wait_helps_children)
+{
+	WorkersScope workers(1);
+	std::atomic<uint32> visits = 0;
+	Jobs::ParallelFor(8, 1, [&](uint32)
+	{
+		Jobs::ParallelFor(32, 1, [&](uint32) { visits++; });
+	});
+	CHECK(visits == 8 * 32);
+}
+
+// Jobs come from the pool. Under 256 jobs in flight it never grows, however many jobs the workers happen to cache.
+TEST(jobs_schedule_does_not_allocate_when_warm)
+{
+	WorkersScope workers(2);
+	std::atomic<uint64> sum = 0;
+	auto run = [&]() { Jobs::ParallelFor(256, 1, [&](uint32 idx) { sum += idx; }); };
+	for (uint32 it = 0; it < 64; it++)
+	{
+		run();
+	}
+	const uint64 allocations = Harness::NumAllocations();
+	for (uint32 it = 0; it < 64; it++)
+	{
+		run();
+	}
+	CHECK(Harness::NumAllocations() == allocations);
+}
@@ -0,0 +1,92 @@
+#include "harness.h"
+#include "lane_queue.h"
+#include <atomic>
+#include <memory>
+
+namespace
+{
+	struct Message
+	{
+		uint32 producer = 0;
+		uint32 sequence = 0;
+	};
+
+	using Queue = LaneQueue_SingleConsumer<Message, 16, 4>;
+}
+
+// Producer threads come and go, one at a time. Each takes over the lane of the exited one, so the lanes never run
+// out and the order of all the messages is kept.
+TEST(lane_queue_recycles_lanes_of_exited_threads)
+{
+	auto queue = std::make_unique<Queue>();
+	constexpr uint32 kProducers = 64;
+	constexpr uint32 kPerProducer = 40;
+	for (uint32 producer = 0; producer < kProducers; producer++)
+	{
+		std::thread([&]()
+		{
+			for (uint32 sequence = 0; sequence < kPerProducer; sequence++)
+			{
+				queue->Emplace(Message{ producer, sequence });
+			}
+		}).join();
+	}
+	CHECK(queue->NumLanes() == 1);
+
+	uint32 expected = 0;
+	bool ordered = true;
+	queue->ConsumeAll([&](const Message& msg)
+	{
+		ordered &= (msg.producer * kPerProducer + msg.sequence) == expected++;
+	});
+	CHECK(ordered);
+	CHECK(expected == kProducers * kPerProducer);
+}
+
+// More concurrent producers than lanes: the rest share the fallback queue, every message arrives in its producer's
+// order. Once they exit, the lanes are free again.
+TEST(lane_queue_falls_back_when_lanes_are_taken)
+{
+	auto queue = std::make_unique<Queue>();
+	constexpr uint32 kProducers = 12;
+	constexpr uint32 kPerProducer = 1000;
+	std::latch all_registered(kProducers);
+	Harness::RunThreads(kProducers, [&](uint32 producer)
+	{
+		queue->Emplace(Message{ producer, 0 });
+		all_registered.arrive_and_wait();
+		for (uint32 sequence = 1; sequence < kPerProducer; sequence++)
+		{
+			queue->Emplace(Message{ producer, sequence });
+		}
+	});
+	CHECK(queue->NumLanes() == 4);
+
+	std::vector<uint32> next_sequence(kProducers, 0);
+	bool ordered = true;
+	const uint32 consumed = queue->ConsumeAll([&](const Message& msg) { ordered &= (next_sequence[msg.producer]++ == msg.sequence); });
+	CHECK(ordered);
+	CHECK(consumed == kProducers * kPerProducer);
+
+	std::thread([&]() { queue->Emplace(Message{}); }).join();
+	CHECK(queue->NumLanes() == 4);
+	CHECK(queue->Pop().has_value());
+}
+
+// A queue destroyed before its producer thread exits is not touched by the exiting thread.
+TEST(lane_queue_destroyed_before_producer_exits)
+{
+	std::atomic_bool sent = false;
+	std::atomic_bool destroyed = false;
+	auto queue = std::make_unique<Queue>();
+	std::thread producer([&]()
+	{
+		queue->Emplace(Message{});
+		sent = true;
+		while (!destroyed) { std::this_thread::yield(); }
+	});
+	while (!sent) { std::this_thread::yield(); }
+	queue.reset();
+	destroyed = true;
+	producer.join();
+}
@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "node_bvh.h"
+#include <cmath>
+#include <random>
+
+namespace
+{
+	// Frustum at the origin with the given orientation, 90 degrees wide and 60 degrees high.
+	BoundingFrustum MakeFrustum(const XMFLOAT3& origin, const XMFLOAT4& orientation, float far_plane)
+	{
+		return BoundingFrustum(origin, orientation, 1.0f, -1.0f, 0.577f, -0.577f, 0.5f, far_plane);
+	}
+
+	// Normalized random rotation.
+	XMFLOAT4 RandomOrientation(std::mt19937& random)
+	{
+		std::normal_distribution<float> component(0.0f, 1.0f);
+		XMFLOAT4 q(component(random), component(random), component(random), component(random));
+		const float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		return XMFLOAT4(q.x / length, q.y / length, q.z / length, q.w / length);
+	}
+
+	// The largest distance of the bounding box of the sphere from the frustum planes, the same test as NodeBvh::Cull
+	// for a single box: positive when the box is outside.
+	float BoxDistance(const BoundingSphere& sphere, const std::array<XMFLOAT4, 6>& planes)
+	{
+		float max_dist = -FLT_MAX;
+		for (const XMFLOAT4& plane : planes)
+		{
+			const float px = sphere.Center.x + ((plane.x > 0.0f) ? -sphere.Radius : sphere.Radius);
+			const float py = sphere.Center.y + ((plane.y > 0.0f) ? -sphere.Radius : sphere.Radius);
+			const float pz = sphere.Center.z + ((plane.z > 0.0f) ? -sphere.Radius : sphere.Radius);
+			max_dist = std::max(max_dist, plane.x * px + plane.y * py + plane.z * pz + plane.w);
+		}
+		return max_dist;
+	}
+
+	std::array<XMFLOAT4, 6> GetPlanes(const BoundingFrustum& frustum)
+	{
+		XMVECTOR vectors[6];
+		frustum.GetPlanes(&vectors[0], &vectors[1], &vectors[2], &vectors[3], &vectors[4], &vectors[5]);
+		std::array<XMFLOAT4, 6> planes;
+		for (uint32 idx = 0; idx < 6; idx++)
+		{
+			XMStoreFloat4(&planes[idx], vectors[idx]);
+		}
+		return planes;
+	}
+}
+
+TEST(node_bvh_empty)
+{
+	NodeBvh bvh;
+	bvh.Build({});
+	CHECK(bvh.GetNodes().empty());
+	uint32 visited = 0;
+	bvh.Cull(MakeFrustum(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), 100.0f), [&](uint32) { visited++; });
+	CHECK(visited == 0);
+}
+
+// Random leaves and frustums, against a brute force test of every leaf: a leaf clearly inside is visited, one clearly
+// outside is not, and every sphere intersecting the frustum is visited. Leaves with no radius are never visited.
+TEST(node_bvh_cull_matches_brute_force)
+{
+	std::mt19937 random(41);
+	std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> radius(0.2f, 4.0f);
+	for (const uint32 num : { 1u, 2u, 5u, 100u, 3000u })
+	{
+		std::vector<BoundingSphere> leaves;
+		for (uint32 idx = 0; idx < num; idx++)
+		{
+			// Some freed nodes, which the build skips.
+			leaves.emplace_back(XMFLOAT3(coord(random), coord(random), coord(random)), (random() % 8) ? radius(random) : 0.0f);
+		}
+		NodeBvh bvh;
+		bvh.Build(leaves);
+
+		for (uint32 round = 0; round < 20; round++)
+		{
+			const BoundingFrustum frustum = MakeFrustum(XMFLOAT3(coord(random), coord(random), coord(random)), RandomOrientation(random), 150.0f);
+			std::vector<uint32> visits(num, 0);
+			bvh.Cull(frustum, [&](uint32 node_idx)
+			{
+				CHECK(node_idx < num);
+				visits[node_idx]++;
+			});
+
+			const std::array<XMFLOAT4, 6> planes = GetPlanes(frustum);
+			for (uint32 idx = 0; idx < num; idx++)
+			{
+				const BoundingSphere& leaf = leaves[idx];
+				CHECK(visits[idx] <= 1);
+				if (leaf.Radius <= 0.0f)
+				{
+					CHECK(visits[idx] == 0);
+					continue;
+				}
+				const float dist = BoxDistance(leaf, planes);
+				if (dist < -1e-3f)
+					CHECK(visits[idx] == 1);
+				if (dist > 1e-3f)
+					CHECK(visits[idx] == 0);
+				if (frustum.Contains(leaf) != DISJOINT)
+					CHECK(visits[idx] == 1);
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "node_lbvh.h"
+#include <random>
+
+namespace
+{
+	struct WorkersScope
+	{
+		WorkersScope(uint32 num_workers) { Jobs::Initialize(num_workers); }
+		~WorkersScope() { Jobs::Shutdown(); }
+	};
+}
+
+TEST(node_lbvh_morton_code_interleaves_axes)
+{
+	CHECK(NodeLbvh::Encode(1, 0, 0) == 4);
+	CHECK(NodeLbvh::Encode(0, 1, 0) == 2);
+	CHECK(NodeLbvh::Encode(0, 0, 1) == 1);
+	CHECK(NodeLbvh::Encode(3, 0, 0) == 0b100100);
+	CHECK(NodeLbvh::Encode(0x1fffff, 0x1fffff, 0x1fffff) == (uint64(1) << 63) - 1);
+}
+
+// Keys spanning several blocks, compared with std::stable_sort: the parallel radix sort is stable too.
+TEST(node_lbvh_sort_matches_stable_sort)
+{
+	WorkersScope workers(3);
+	std::mt19937_64 random(23);
+	for (const uint32 code_bits : { 30u, 63u })
+	{
+		std::pmr::vector<NodeLbvh::Key> keys(3 * NodeLbvh::kBatchSize * 4 + 17);
+		for (uint32 idx = 0; idx < keys.size(); idx++)
+		{
+			// Few distinct codes, so the order of equal codes is checked.
+			keys[idx] = NodeLbvh::Key{ (random() % 512) << (code_bits - 9), idx };
+		}
+		std::vector<NodeLbvh::Key> expected(keys.begin(), keys.end());
+		std::stable_sort(expected.begin(), expected.end(), [](const NodeLbvh::Key& a, const NodeLbvh::Key& b) { return a.code < b.code; });
+		NodeLbvh::SortByCode(keys, code_bits);
+		CHECK(std::equal(keys.begin(), keys.end(), expected.begin(),
+			[](const NodeLbvh::Key& a, const NodeLbvh::Key& b) { return (a.code == b.code) && (a.idx == b.idx); }));
+	}
+}
+
+// The leaves cover the Morton ordered permutation of the spheres without gaps, and hold at most max_leaf_size each.
+TEST(node_lbvh_build_clusters_all_spheres)
+{
+	WorkersScope workers(3);
+	std::mt19937 random(29);
+	std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+	std::vector<BoundingSphere> spheres;
+	for (uint32 idx = 0; idx < 10'000; idx++)
+	{
+		spheres.emplace_back(XMFLOAT3(coord(random), coord(random), coord(random)), 1.0f);
+	}
+	for (const uint32 max_leaves : { 4096u, 10'000u / 16 + 1 })
+	{
+		const NodeLbvh::Clusters clusters = NodeLbvh::Build(spheres, 16, max_leaves);
+		CHECK(clusters.leaves.size() <= max_leaves);
+		uint32 next = 0;
+		for (const NodeLbvh::Leaf& leaf : clusters.leaves)
+		{
+			CHECK((leaf.begin == next) && leaf.Size() && (leaf.Size() <= 16));
+			next = leaf.end;
+		}
+		CHECK(next == spheres.size());
+		std::vector<bool> seen(spheres.size(), false);
+		for (const uint32 idx : clusters.order)
+		{
+			CHECK((idx < spheres.size()) && !seen[idx]);
+			seen[idx] = true;
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#include "harness.h"
+#include "memory/page_memory.h"
+
+TEST(page_memory_blocks_are_zeroed_and_page_aligned)
+{
+	for (const bool large_pages : { false, true })
+	{
+		PageMemory::Block block = PageMemory::Allocate(3 * 4096 + 100, PageMemory::Policy{ .large_pages = large_pages });
+		CHECK(block.ptr && (block.size >= 3 * 4096 + 100));
+		CHECK((reinterpret_cast<uintptr_t>(block.ptr) % 4096) == 0);
+		const std::byte* const bytes = static_cast<const std::byte*>(block.ptr);
+		CHECK(std::all_of(bytes, bytes + block.size, [](std::byte it) { return it == std::byte{ 0 }; }));
+		PageMemory::Free(block);
+		CHECK(!block.ptr && !block.size);
+	}
+}
+
+TEST(page_backed_constructs_and_destroys_the_object)
+{
+	struct Object
+	{
+		alignas(64) uint64 data[1024];
+		uint32& destroyed;
+
+		explicit Object(uint32& counter) : data{ 1 }, destroyed(counter) {}
+		~Object() { destroyed++; }
+	};
+	uint32 destroyed = 0;
+	{
+		PageBacked<Object> object(PageMemory::Policy{}, destroyed);
+		CHECK((object->data[0] == 1) && (object->data[1] == 0));
+		CHECK((reinterpret_cast<uintptr_t>(&*object) % 64) == 0);
+	}
+	CHECK(destroyed == 1);
+}
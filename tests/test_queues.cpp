@@ -0,0 +1,68 @@
+#include "harness.h"
+#include "mpsc_queue.h"
+#include "ring_queue.h"
+#include <atomic>
+#include <memory>
+
+namespace
+{
+	struct Message
+	{
+		uint32 producer = 0;
+		uint32 sequence = 0;
+	};
+
+	// Every producer's messages arrive once and in order. A consumer, that sleeps on a slot reserved but not yet
+	// written, has to be woken by the producer writing it, or the test hangs.
+	template<typename TQueue>
+	void CheckProducersOrder(uint32 producers, uint32 per_producer)
+	{
+		auto queue = std::make_unique<TQueue>();
+		std::vector<uint32> next_sequence(producers, 0);
+		std::atomic<uint32> received = 0;
+		bool ordered = true;
+		Harness::RunThreads(producers + 1, [&](uint32 thread_idx)
+		{
+			if (thread_idx < producers)
+			{
+				for (uint32 sequence = 0; sequence < per_producer; sequence++)
+				{
+					while (sequence * producers > received.load(std::memory_order_acquire) + 4096)
+					{
+						std::this_thread::yield();
+					}
+					queue->Emplace(Message{ thread_idx, sequence });
+				}
+				return;
+			}
+			while (received.load(std::memory_order_relaxed) < producers * per_producer)
+			{
+				queue->ConsumeAll([&](const Message& msg)
+				{
+					ordered &= (next_sequence[msg.producer]++ == msg.sequence);
+					received.fetch_add(1, std::memory_order_release);
+				});
+				if (std::optional<Message> msg = queue->Pop())
+				{
+					ordered &= (next_sequence[msg->producer]++ == msg->sequence);
+					received.fetch_add(1, std::memory_order_release);
+				}
+			}
+		});
+		CHECK(ordered);
+		CHECK(received == producers * per_producer);
+		CHECK(!queue->Pop());
+	}
+}
+
+TEST(mpsc_queue_producers_order)
+{
+	CheckProducersOrder<LockFreeQueue_SingleConsumer<Message, 32>>(1, 100'000);
+	CheckProducersOrder<LockFreeQueue_SingleConsumer<Message, 32>>(8, 20'000);
+}
+
+TEST(ring_queue_producers_order)
+{
+	CheckProducersOrder<RingQueue_SingleConsumer<Message, 256>>(1, 100'000);
+	CheckProducersOrder<RingQueue_SingleConsumer<Message, 256>>(8, 20'000);
+}
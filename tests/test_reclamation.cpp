@@ -0,0 +1,62 @@
+#include "harness.h"
+#include "memory/epoch_reclamation.h"
+#include <atomic>
+
+namespace
+{
+	std::atomic<uint32> g_freed = 0;
+
+	void CountFree(void*) { g_freed++; }
+}
+
+// More threads than fit a record block are inside guards at once. A pointer retired meanwhile is freed only after
+// all of them left, including those with records in the added blocks.
+TEST(reclamation_grows_thread_records)
+{
+	constexpr uint32 kThreads = 2 * Reclamation::kRecordsPerBlock + 8;
+	std::atomic<uint32> entered = 0;
+	std::atomic_bool release = false;
+	std::thread holders([&]()
+	{
+		Harness::RunThreads(kThreads, [&](uint32)
+		{
+			Reclamation::Guard guard;
+			entered++;
+			while (!release) { std::this_thread::yield(); }
+		});
+	});
+	while (entered < kThreads) { std::this_thread::yield(); }
+
+	g_freed = 0;
+	static int object = 0;
+	Reclamation::Retire(&object, &CountFree);
+	for (uint32 it = 0; it < 4; it++)
+	{
+		Reclamation::Collect();
+	}
+	CHECK(!g_freed);
+
+	release = true;
+	holders.join();
+	for (uint32 it = 0; it < 4; it++)
+	{
+		Reclamation::Collect();
+	}
+	CHECK(g_freed == 1);
+}
+
+// Records of exited threads are reused, so waves of short lived threads don't keep adding blocks.
+TEST(reclamation_reuses_records_of_exited_threads)
+{
+	for (uint32 wave = 0; wave < 8; wave++)
+	{
+		Harness::RunThreads(Reclamation::kRecordsPerBlock, [](uint32) { Reclamation::Guard guard; });
+	}
+	auto allocations_of = [](auto&& func)
+	{
+		const uint64 before = Harness::NumAllocations();
+		std::thread(func).join();
+		return Harness::NumAllocations() - before;
+	};
+	CHECK(allocations_of([]() { Reclamation::Guard guard; }) == allocations_of([]() {}));
+}
@@ -0,0 +1,105 @@
+#include "harness.h"
+#include "small_container.h"
+#include <memory_resource>
+#include <string>
+
+namespace
+{
+	// Counts live instances, so a leaked or doubly destroyed element shows up.
+	struct Tracked
+	{
+		static inline int32 alive = 0;
+		std::string value;
+
+		Tracked(std::string in_value) : value(std::move(in_value)) { alive++; }
+		Tracked(Tracked&& other) noexcept : value(std::move(other.value)) { alive++; }
+		Tracked& operator=(Tracked&& other) noexcept { value = std::move(other.value); return *this; }
+		~Tracked() { alive--; }
+	};
+
+	template<typename TContainer>
+	void Fill(TContainer& container, uint32 num)
+	{
+		for (uint32 idx = 0; idx < num; idx++)
+		{
+			container.emplace_back(std::to_string(idx));
+		}
+	}
+
+	template<typename TContainer>
+	bool Holds(const TContainer& container, uint32 num)
+	{
+		if (container.size() != num)
+			return false;
+		for (uint32 idx = 0; idx < num; idx++)
+		{
+			if (container[idx].value != std::to_string(idx))
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST(small_container_empty_allocator_takes_no_space)
+{
+	CHECK(sizeof(small_container<uint32, 2>) == sizeof(void*) + 2 * sizeof(uint32));
+}
+
+TEST(small_container_move_construct)
+{
+	{
+		small_container<Tracked, 2> inline_source;
+		Fill(inline_source, 2);
+		small_container<Tracked, 2> inline_moved(std::move(inline_source));
+		CHECK(Holds(inline_moved, 2) && !inline_source.size());
+
+		small_container<Tracked, 2> heap_source;
+		Fill(heap_source, 40);
+		const Tracked* const heap = heap_source.begin();
+		small_container<Tracked, 2> heap_moved(std::move(heap_source));
+		CHECK(Holds(heap_moved, 40) && !heap_source.size());
+		CHECK(heap_moved.begin() == heap);
+
+		heap_source.emplace_back("reused");
+		CHECK(heap_source.size() == 1);
+	}
+	CHECK(!Tracked::alive);
+}
+
+TEST(small_container_move_assign)
+{
+	{
+		small_container<Tracked, 2> target;
+		Fill(target, 10);
+		small_container<Tracked, 2> source;
+		Fill(source, 30);
+		target = std::move(source);
+		CHECK(Holds(target, 30) && !source.size());
+
+		small_container<Tracked, 2> inline_source;
+		Fill(inline_source, 1);
+		target = std::move(inline_source);
+		CHECK(Holds(target, 1) && (target.capacity() == small_container<Tracked, 2>::kInlineCapacity));
+	}
+	CHECK(!Tracked::alive);
+}
+
+// A polymorphic_allocator doesn't propagate on move assignment: the elements move into the target's own arena.
+TEST(small_container_move_assign_keeps_arena)
+{
+	using Container = small_container<Tracked, 1, GrowDouble, std::pmr::polymorphic_allocator<Tracked>>;
+	{
+		std::pmr::monotonic_buffer_resource source_arena;
+		std::pmr::monotonic_buffer_resource target_arena;
+		Container source{ std::pmr::polymorphic_allocator<Tracked>(&source_arena) };
+		Container target{ std::pmr::polymorphic_allocator<Tracked>(&target_arena) };
+		Fill(source, 20);
+		const Tracked* const source_heap = source.begin();
+		target = std::move(source);
+		CHECK(Holds(target, 20) && (target.begin() != source_heap));
+
+		Container moved(std::move(target));
+		CHECK(Holds(moved, 20) && !target.size());
+	}
+	CHECK(!Tracked::alive);
+}
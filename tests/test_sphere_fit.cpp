@@ -0,0 +1,61 @@
+#include "stdafx.h"
+#include "harness.h"
+#include "primitives/sphere_fit.h"
+#include <cmath>
+#include <cfloat>
+#include <random>
+
+using DirectX::BoundingSphere;
+using DirectX::XMFLOAT3;
+
+namespace
+{
+	bool Encloses(const BoundingSphere& outer, const BoundingSphere& inner)
+	{
+		const float dx = inner.Center.x - outer.Center.x;
+		const float dy = inner.Center.y - outer.Center.y;
+		const float dz = inner.Center.z - outer.Center.z;
+		return (std::sqrt(dx * dx + dy * dy + dz * dz) + inner.Radius) <= (outer.Radius * 1.0001f + 1e-4f);
+	}
+}
+
+TEST(sphere_fit_single_sphere)
+{
+	const BoundingSphere sphere(XMFLOAT3(1.0f, -2.0f, 3.0f), 0.5f);
+	const BoundingSphere fit = SphereFit::Enclose({ &sphere, 1 });
+	CHECK((fit.Center.x == 1.0f) && (fit.Center.y == -2.0f) && (fit.Center.z == 3.0f) && (fit.Radius == 0.5f));
+}
+
+TEST(sphere_fit_two_spheres_are_tight)
+{
+	const BoundingSphere spheres[] = { BoundingSphere(XMFLOAT3(-4.0f, 0.0f, 0.0f), 1.0f), BoundingSphere(XMFLOAT3(4.0f, 0.0f, 0.0f), 1.0f) };
+	const BoundingSphere fit = SphereFit::Enclose(spheres);
+	CHECK(std::abs(fit.Radius - 5.0f) < 1e-4f);
+	CHECK(std::abs(fit.Center.x) < 1e-4f);
+}
+
+// Random sets of 1 to kMaxSpheres spheres: the fit contains every sphere, and it is not larger than the bounding
+// sphere of their bounding box.
+TEST(sphere_fit_encloses_random_sets)
+{
+	std::mt19937 random(17);
+	std::uniform_real_distribution<float> coord(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> radius(0.1f, 5.0f);
+	for (uint32 round = 0; round < 2000; round++)
+	{
+		const std::size_t num = 1 + random() % SphereFit::kMaxSpheres;
+		std::vector<BoundingSphere> spheres;
+		XMFLOAT3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (std::size_t idx = 0; idx < num; idx++)
+		{
+			const BoundingSphere& sphere = spheres.emplace_back(XMFLOAT3(coord(random), coord(random), coord(random)), radius(random));
+			min = XMFLOAT3(std::min(min.x, sphere.Center.x - sphere.Radius), std::min(min.y, sphere.Center.y - sphere.Radius), std::min(min.z, sphere.Center.z - sphere.Radius));
+			max = XMFLOAT3(std::max(max.x, sphere.Center.x + sphere.Radius), std::max(max.y, sphere.Center.y + sphere.Radius), std::max(max.z, sphere.Center.z + sphere.Radius));
+		}
+		const BoundingSphere fit = SphereFit::Enclose(spheres);
+		CHECK(std::all_of(spheres.begin(), spheres.end(), [&](const BoundingSphere& sphere) { return Encloses(fit, sphere); }));
+		const XMFLOAT3 box(max.x - min.x, max.y - min.y, max.z - min.z);
+		CHECK(fit.Radius <= 0.5f * std::sqrt(box.x * box.x + box.y * box.y + box.z * box.z) * 1.0001f);
+	}
+}
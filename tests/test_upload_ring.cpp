@@ -0,0 +1,105 @@
+#include "harness.h"
+#include "graphics/upload_ring.h"
+
+// The fence values are fake: retire(value) stands for the GPU having signaled value.
+TEST(upload_ring_retires_in_fence_order)
+{
+	UploadRing ring;
+	ring.initialize(1024);
+	CHECK(ring.allocate(300, 1) == 0);
+	ring.submit(1);
+	CHECK(ring.allocate(300, 1) == 300);
+	ring.submit(2);
+	CHECK(ring.allocate(300, 1) == 600);
+	ring.submit(3);
+	CHECK(ring.get_oldest_fence_value() == 1);
+	CHECK(ring.allocate(300, 1) == UploadRing::kInvalidOffset);
+	CHECK(ring.get_overflow_num() == 1);
+
+	// Only the batches with completed fences are reclaimed.
+	ring.retire(2);
+	CHECK(ring.has_in_flight() && (ring.get_oldest_fence_value() == 3));
+	CHECK(ring.get_used() == 300);
+	ring.retire(3);
+	CHECK(!ring.has_in_flight() && (ring.get_used() == 0));
+	CHECK(ring.get_high_water() == 900);
+
+	// Idle, so it starts over from the beginning.
+	CHECK(ring.allocate(1000, 1) == 0);
+}
+
+TEST(upload_ring_skips_the_end_instead_of_wrapping)
+{
+	UploadRing ring;
+	ring.initialize(1024);
+	CHECK(ring.allocate(700, 1) == 0);
+	ring.submit(1);
+	CHECK(ring.allocate(200, 1) == 700);
+	ring.submit(2);
+	ring.retire(1);
+
+	// 124 bytes are left at the end, so the allocation starts at 0, below the tail at 700.
+	CHECK(ring.allocate(300, 1) == 0);
+	CHECK(ring.get_used() == 624);
+	CHECK(ring.allocate(500, 1) == UploadRing::kInvalidOffset);
+	CHECK(ring.allocate(400, 1) == 300);
+	CHECK(ring.allocate(1, 1) == UploadRing::kInvalidOffset);
+	ring.submit(3);
+
+	ring.retire(2);
+	CHECK(ring.get_used() == 824);
+	CHECK(ring.allocate(256, 256) == UploadRing::kInvalidOffset);
+	ring.retire(3);
+	CHECK(ring.allocate(256, 256) == 0);
+}
+
+TEST(upload_ring_aligns_allocations)
+{
+	UploadRing ring;
+	ring.initialize(4096);
+	CHECK(ring.allocate(10, 1) == 0);
+	CHECK(ring.allocate(10, 256) == 256);
+	CHECK(ring.allocate(10, 16) == 272);
+	CHECK(ring.get_used() == 282);
+
+	// Without submit it is a linear allocator, cleared by reset.
+	ring.retire(~uint64(0));
+	CHECK(ring.get_used() == 282);
+	ring.reset();
+	CHECK(ring.get_used() == 0);
+	CHECK(ring.get_high_water() == 282);
+	ring.clear_usage();
+	CHECK(ring.get_high_water() == 0);
+}
+
+TEST(upload_size_policy_grows_and_shrinks)
+{
+	constexpr uint64 kMB = 1024 * 1024;
+	UploadSizePolicy policy{ .min_size = 2 * kMB, .max_size = 64 * kMB };
+	CHECK(policy.next_size(2 * kMB, 2 * kMB, 1) == 4 * kMB);
+	CHECK(policy.next_size(4 * kMB, 4 * kMB, 3) == 8 * kMB);
+	CHECK(policy.next_size(64 * kMB, 64 * kMB, 1) == 64 * kMB);
+
+	// Shrinks to twice the peak of the quiet periods, only after kShrinkPeriods of them in a row.
+	uint64 size = 64 * kMB;
+	for (uint32 period = 1; period < UploadSizePolicy::kShrinkPeriods; period++)
+	{
+		size = policy.next_size(size, (period == 7) ? 3 * kMB : kMB, 0);
+		CHECK(size == 64 * kMB);
+	}
+	size = policy.next_size(size, kMB, 0);
+	CHECK(size == 8 * kMB);
+
+	// A busy period restarts the streak.
+	for (uint32 period = 1; period < UploadSizePolicy::kShrinkPeriods; period++)
+	{
+		size = policy.next_size(size, 0, 0);
+	}
+	size = policy.next_size(size, 4 * kMB, 0);
+	CHECK(size == 8 * kMB);
+	size = policy.next_size(size, 0, 0);
+	CHECK(size == 8 * kMB);
+
+	UploadSizePolicy fixed{ .min_size = kMB };
+	CHECK(fixed.next_size(kMB, kMB, 5) == kMB);
+}
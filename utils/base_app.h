@@ -14,7 +14,6 @@ public:
 	virtual void ToggleFullscreenWindow() = 0;
 	virtual void OnKeyDown(UINT8 /*key*/)	{}
 	virtual void OnKeyUp(UINT8 /*key*/)		{}
-	virtual void ReceiveMsgToBroadcast(CommonMsg::Message) = 0; // Thread Safe
 
 	const WCHAR* GetTitle() const { return L"SceneEngine"; }
 	void SetCustomWindowText(LPCWSTR text);
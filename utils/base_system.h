@@ -1,10 +1,31 @@
 #pragma once
 #include "small_container.h"
 #include "message_queue.h"
+#include "mpsc_queue.h"
+#include "ring_queue.h"
+#include "lane_queue.h"
 #include <optional>
+#include <atomic>
 #include "mathfu/mathfu.h"
 #include "common_msg.h"
+#include "message_bus.h"
 #include "common/utils.h"
+#include "jobs/jobs.h"
+#include "stat/stat.h"
+#include "memory/frame_arena.h"
+
+enum class ETickMode : uint8
+{
+	Continuous,	// Tick after every pass over the queue, never park
+	EveryFrame,	// Tick once per CommonMsg::Frame, park in between
+	OnMessage,	// Tick only after some messages were handled, park when the queue is empty
+};
+
+enum class EExecution : uint8
+{
+	DedicatedThread,	// SystemLoop on an own std::thread
+	Pooled,				// Each pass over the queue runs as a job, scheduled only when there is something to do
+};
 
 class IBaseSystem
 {
@@ -14,22 +35,177 @@ public:
 	virtual void Destroy() = 0;
 	virtual bool IsRunning() const = 0;
 
-	virtual void ReceiveCommonMessage(CommonMsg::Message) = 0;
-
 	virtual std::string_view GetName() const = 0;
 	virtual ~IBaseSystem() = default;
 };
 
-template<class TMsg>
-class BaseSystemImpl : public IBaseSystem
+template<class TMsg, class TQueue = TMessageQueue<TMsg>>
+class BaseSystemImpl : public IBaseSystem, private CommonMsg::ISubscriber
 {
-	LockFreeQueue_SingleConsumer<TMsg, 32> msg_queue_;
-	//TMessageQueue<TMsg> msg_queue_;
+	// Pool sizes for queues with a node pool.
+	static constexpr size_t kPreallocatedMessages = 64;
+	static constexpr size_t kMaxFreeMessageNodes = 1024;
+	static constexpr size_t kDefaultFrameArenaSize = 64 * 1024;
+
+	TQueue msg_queue_;
 	std::thread thread_;
 
+	// Bumped on every wake up source. The system thread reads it before draining the queue and parks on it,
+	// so a message enqueued after the drain always changes the value it waits for.
+	std::atomic<uint32> wake_epoch_ = 0;
+	std::atomic_bool parked_ = false;
+	std::atomic_bool frame_pending_ = false;
+
+	// Read on the system thread, the bus only wakes the system up.
+	CommonMsg::Subscription common_subscription_;
+
+	// Current during the system passes. Reset in the first pass after a CommonMsg::Frame was published.
+	std::optional<FrameArena> frame_arena_;
+	uint64 arena_frame_ = 0;
+
+	// Pooled execution. At most one job of the system is alive: Wake schedules it when Idle,
+	// or marks the running one dirty, so it's rescheduled instead of going Idle.
+	enum class ERunState : uint8
+	{
+		Idle,
+		Scheduled,
+		Running,
+		RunningDirty,
+		Finished
+	};
+	std::atomic<ERunState> run_state_ = ERunState::Idle;
+	Jobs::Counter pooled_jobs_;
+	bool pooled_ = false;
+	bool pooled_initialized_ = false;
+
+	struct HandleResult
+	{
+		uint32 handled = 0;
+		bool budget_exceeded = false;
+	};
+
+#if DO_STAT
+	// Grouped by the system name, registered in Start.
+	struct QueueStats
+	{
+		QueueStats(const char* group)
+			: handled(group, "msg_handled", Stat::EMode::PerFrame)
+			, drain_time(group, "msg_drain", Stat::EMode::PerFrame)
+			, backlog(group, "msg_backlog", Stat::EMode::Override)
+			, allocated(group, "msg_queue_allocated", Stat::EMode::Override)
+			, arena_peak(group, "frame_arena_peak", Stat::EMode::Override)
+			, arena_fallbacks(group, "frame_arena_fallbacks", Stat::EMode::PerFrame)
+		{}
+
+		Stat::Id handled;
+		Stat::Id drain_time;
+		Stat::Id backlog;
+		Stat::Id allocated;
+		Stat::Id arena_peak;
+		Stat::Id arena_fallbacks;
+	};
+	std::optional<QueueStats> queue_stats_;
+
+	void PassQueueStats(const HandleResult& result, Utils::TimeType start_time) const
+	{
+		if (!result.handled || !queue_stats_)
+			return;
+		queue_stats_->handled.PassValue(result.handled);
+		queue_stats_->drain_time.PassValue(Utils::ToMiliseconds(Utils::GetTime() - start_time));
+		queue_stats_->backlog.PassValue(msg_queue_.Num());
+		queue_stats_->allocated.PassValue(msg_queue_.NumAllocated());
+	}
+#endif
+
+	void BeginFrameArenaPass()
+	{
+		const uint64 frame = CommonMsg::Topic<CommonMsg::Frame>::Get().NumPublished();
+		if (frame == arena_frame_)
+			return;
+		arena_frame_ = frame;
+#if DO_STAT
+		if (queue_stats_)
+		{
+			queue_stats_->arena_peak.PassValue(static_cast<double>(frame_arena_->GetPeak()));
+			queue_stats_->arena_fallbacks.PassValue(frame_arena_->GetFallbackNum());
+		}
+#endif
+		frame_arena_->Reset();
+	}
+
+	void SchedulePooledPass()
+	{
+		Jobs::Schedule([this]() { PooledPass(); }, &pooled_jobs_);
+	}
+
+	void WakePooled()
+	{
+		ERunState state = run_state_.load();
+		while (true)
+		{
+			switch (state)
+			{
+			case ERunState::Idle:
+				if (run_state_.compare_exchange_weak(state, ERunState::Scheduled))
+				{
+					SchedulePooledPass();
+					return;
+				}
+				break;
+			case ERunState::Running:
+				if (run_state_.compare_exchange_weak(state, ERunState::RunningDirty))
+					return;
+				break;
+			default:
+				return;
+			}
+		}
+	}
+
+	void Wake()
+	{
+		if (pooled_)
+		{
+			WakePooled();
+			return;
+		}
+		wake_epoch_.fetch_add(1);
+		if (parked_.load())
+		{
+			wake_epoch_.notify_one();
+		}
+	}
+
+	void Park(uint32 observed_epoch)
+	{
+		parked_.store(true);
+		if (open_ && (wake_epoch_.load() == observed_epoch))
+		{
+			wake_epoch_.wait(observed_epoch);
+		}
+		parked_.store(false);
+	}
+
+	bool ShouldTick(const HandleResult& result)
+	{
+		switch (GetTickMode())
+		{
+		case ETickMode::EveryFrame:	return frame_pending_.exchange(false);
+		case ETickMode::OnMessage:	return result.handled > 0;
+		default:					return true;
+		}
+	}
+
 protected:
 	bool open_ = false;
 
+	BaseSystemImpl()
+	{
+		if constexpr (requires(TQueue& queue) { queue.Preallocate(kPreallocatedMessages); })
+		{
+			msg_queue_.Preallocate(kPreallocatedMessages);
+		}
+	}
 	virtual ~BaseSystemImpl() = default;
 	virtual void HandleSingleMessage(TMsg&) = 0;
 
@@ -42,46 +218,167 @@ protected:
 	void Destroy() override {}
 
 	virtual std::optional<Utils::TimeSpan> GetMessageBudget() const { return {}; }
+	virtual ETickMode GetTickMode() const { return ETickMode::Continuous; }
+
+	// CommonMsg types the system subscribes to in Start. EveryFrame systems need at least Frame.
+	virtual CommonMsg::TypeMask GetCommonMessageTypes() const
+	{
+		return (GetTickMode() == ETickMode::EveryFrame) ? CommonMsg::MaskOf<CommonMsg::Frame>() : 0;
+	}
+
+	// Called on the system thread, before the queued messages, for the types from GetCommonMessageTypes.
+	virtual void HandleCommonMessage(CommonMsg::Message) {}
 
-	virtual void ReceiveCommonMessage(CommonMsg::Message) {}
+	virtual std::size_t GetFrameArenaSize() const { return kDefaultFrameArenaSize; }
 
-	void HandleMessages()
+	// For data that doesn't outlive the current frame of this system. Also FrameArena::Current() during the passes.
+	FrameArena& GetFrameArena() { return *frame_arena_; }
+
+	HandleResult HandleMessages()
 	{
+		HandleResult result;
+		const auto start_time = Utils::GetTime();
+		result.handled = common_subscription_.ConsumeAll([&](const auto& msg) { HandleCommonMessage(msg); });
 		std::optional<Utils::TimeSpan> budget = GetMessageBudget();
 		if (!budget)
 		{
-			while (auto opt_msg = msg_queue_.Pop())
+			result.handled += msg_queue_.ConsumeAll([&](TMsg& msg) { HandleSingleMessage(msg); });
+		}
+		else
+		{
+			const Utils::TimeSpan time_budget = *budget;
+			result.handled += msg_queue_.ConsumeAll([&](TMsg& msg) -> bool
 			{
-				HandleSingleMessage(*opt_msg);
-			}
-			return;
+				HandleSingleMessage(msg);
+				result.budget_exceeded = (Utils::GetTime() - start_time) > time_budget;
+				return !result.budget_exceeded;
+			});
 		}
-
-		const Utils::TimeSpan time_budget = *budget;
-		const auto start_time = Utils::GetTime();
-		while (auto opt_msg = msg_queue_.Pop())
+		IF_DO_STAT(PassQueueStats(result, start_time));
+		if constexpr (requires(TQueue& queue) { queue.Trim(kMaxFreeMessageNodes); })
 		{
-			HandleSingleMessage(*opt_msg);
-			if ((Utils::GetTime() - start_time) > time_budget)
-				break;
+			if (result.handled && !result.budget_exceeded)
+			{
+				msg_queue_.Trim(kMaxFreeMessageNodes);
+			}
 		}
+		return result;
 	}
 
 	void SystemLoop()
 	{
-		//msg_queue_.Preallocate(64);
+		FrameArena::Scope arena_scope(&*frame_arena_);
 		ThreadInitialize();
 		while (open_)
 		{
-			HandleMessages();
-			Tick();
+			const uint32 wake_epoch = wake_epoch_.load();
+			BeginFrameArenaPass();
+			const HandleResult result = HandleMessages();
+			if (ShouldTick(result))
+			{
+				Tick();
+			}
+			else if (!result.budget_exceeded)
+			{
+				Park(wake_epoch);
+			}
 		}
 		ThreadCleanUp();
 	}
+
+	// Pooled counterpart of a single SystemLoop iteration. ThreadInitialize and ThreadCleanUp run in the first
+	// and the last pass, passes never overlap, but they may be executed by different worker threads.
+	void PooledPass()
+	{
+		// Messages sent during the pass keep their per-producer lanes, whichever worker runs it.
+		LaneQueue::ProducerScope producer_scope(this);
+		FrameArena::Scope arena_scope(&*frame_arena_);
+		run_state_.store(ERunState::Running);
+		if (!pooled_initialized_)
+		{
+			ThreadInitialize();
+			pooled_initialized_ = true;
+		}
+
+		if (open_)
+		{
+			BeginFrameArenaPass();
+			const HandleResult result = HandleMessages();
+			const bool tick = ShouldTick(result);
+			if (tick)
+			{
+				Tick();
+			}
+			const bool run_again = result.budget_exceeded || (tick && (GetTickMode() == ETickMode::Continuous));
+			ERunState expected = ERunState::Running;
+			if (!run_again && run_state_.compare_exchange_strong(expected, ERunState::Idle))
+				return; // Stop wakes the system up, the next pass will clean up
+
+			if (open_)
+			{
+				run_state_.store(ERunState::Scheduled);
+				SchedulePooledPass();
+				return;
+			}
+		}
+
+		ThreadCleanUp();
+		run_state_.store(ERunState::Finished);
+	}
+
+	virtual EExecution GetExecution() const { return EExecution::DedicatedThread; }
 	
-	void Start() override { CustomOpen(); open_ = true; thread_ = std::thread(&BaseSystemImpl::SystemLoop, this); }
-	void Stop() override { open_ = false; thread_.join(); CustomClose(); }
+	void Start() override 
+	{ 
+		CustomOpen(); 
+		IF_DO_STAT(queue_stats_.emplace(GetName().data()));
+		frame_arena_.emplace(GetFrameArenaSize());
+		open_ = true; 
+		pooled_ = GetExecution() == EExecution::Pooled;
+		common_subscription_.Subscribe(*this, GetCommonMessageTypes());
+		if (pooled_)
+		{
+			Wake();
+		}
+		else
+		{
+			thread_ = std::thread(&BaseSystemImpl::SystemLoop, this);
+		}
+	}
+	void Stop() override 
+	{ 
+		open_ = false; 
+		Wake(); 
+		if (pooled_)
+		{
+			Jobs::Wait(pooled_jobs_);
+		}
+		else
+		{
+			thread_.join();
+		}
+		common_subscription_.Unsubscribe(); // the subscription is read by the system thread
+		CustomClose(); 
+	}
 public:
 	bool IsRunning() const override { return open_; }
-	void EnqueueMsg(TMsg&& msg) { msg_queue_.Enqueue(std::forward<TMsg>(msg)); }
+	void EnqueueMsg(TMsg&& msg) { msg_queue_.Enqueue(std::forward<TMsg>(msg)); Wake(); }
+
+	// Builds the message alternative directly in the queue slot, so it's never moved on the way.
+	template<typename TAlt, typename... Args>
+	void EmplaceMsg(Args&&... args)
+	{
+		msg_queue_.Emplace(std::in_place_type<TAlt>, std::forward<Args>(args)...);
+		Wake();
+	}
+
+private:
+	void OnPublished(uint32 type_index) override final
+	{
+		if ((type_index == CommonMsg::TypeIndex<CommonMsg::Frame>()) && (GetTickMode() == ETickMode::EveryFrame))
+		{
+			frame_pending_.store(true);
+		}
+		Wake();
+	}
 };
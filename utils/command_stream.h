@@ -0,0 +1,179 @@
+#pragma once
+
+#include<atomic>
+#include<variant>
+#include<new>
+#include<type_traits>
+#include<assert.h>
+#include "common/base_types.h"
+#include "mpsc_queue.h"
+
+// Multi producer, single consumer byte ring of heterogeneous commands. A command occupies only as many
+// 16 byte cells as its own type needs, instead of a slot sized for the largest alternative. Commands are
+// constructed in place and visited in place, so they are never relocated. The record header (type and size)
+// lives in a parallel array of per-cell states, non-zero only at record starts. When a record doesn't fit
+// before the end of the ring, the remaining cells are skipped with a padding record. When the ring is full,
+// producers spill into a block queue of variants, like RingQueue_SingleConsumer does.
+template<uint32_t kCapacity, typename... TCommands>
+class CommandStream_SingleConsumer
+{
+	static constexpr uint32_t kCellSize = 16;
+	static constexpr uint32_t kNumCells = kCapacity / kCellSize;
+	static constexpr uint64_t kMask = kNumCells - 1;
+	static constexpr uint32_t kPadding = 0xFF;
+	static constexpr uint32_t kOverflowBlockSize = 32;
+
+	static_assert(!(kCapacity % kCellSize) && (kNumCells >= 2) && !(kNumCells & kMask), "capacity must be a power of two");
+	static_assert(sizeof...(TCommands) < kPadding, "too many command types");
+	static_assert(((alignof(TCommands) <= kCellSize) && ...), "over-aligned command");
+
+	template<typename TCmd>
+	static constexpr uint32_t kNumCellsOf = static_cast<uint32_t>((sizeof(TCmd) + kCellSize - 1) / kCellSize);
+	static_assert(((kNumCellsOf<TCommands> <= kNumCells / 4) && ...), "command too big for the ring");
+
+	template<typename TCmd>
+	static constexpr uint32_t IndexOf()
+	{
+		constexpr bool matches[] = { std::is_same_v<TCmd, TCommands>... };
+		for (uint32_t idx = 0; idx < sizeof...(TCommands); idx++)
+		{
+			if (matches[idx])
+				return idx;
+		}
+		return kPadding;
+	}
+
+	static constexpr uint32_t Encode(uint32_t num_cells, uint32_t kind) { return (num_cells << 8) | kind; }
+
+	using Spilled = std::variant<TCommands...>;
+
+	CommandStream_SingleConsumer(const CommandStream_SingleConsumer&) = delete;
+	CommandStream_SingleConsumer& operator=(const CommandStream_SingleConsumer&) = delete;
+	CommandStream_SingleConsumer(const CommandStream_SingleConsumer&&) = delete;
+	CommandStream_SingleConsumer& operator=(const CommandStream_SingleConsumer&&) = delete;
+
+	alignas(kCacheLineSize) std::atomic<uint64_t> tail_ = 0;		// producers, in cells
+	alignas(kCacheLineSize) std::atomic<uint64_t> head_ = 0;		// written only by the consumer
+	alignas(kCacheLineSize) std::atomic<uint32_t> overflow_num_ = 0;
+	alignas(kCacheLineSize) std::byte cells_[kCapacity];
+	std::atomic<uint32_t> states_[kNumCells] = {};
+	LockFreeQueue_SingleConsumer<Spilled, kOverflowBlockSize> overflow_;
+
+	void* CellAt(uint64_t pos) { return cells_ + (pos & kMask) * kCellSize; }
+
+	template<typename F, typename TCmd>
+	static bool VisitCommand(F& func, void* raw)
+	{
+		TCmd& cmd = *std::launder(reinterpret_cast<TCmd*>(raw));
+		const bool proceed = VisitQueueItem(func, cmd);
+		cmd.~TCmd();
+		return proceed;
+	}
+
+	// The command is constructed only when cells were taken, otherwise args are left untouched.
+	template<typename TCmd, typename... Args>
+	bool TryEmplaceStream(Args&&... args)
+	{
+		constexpr uint32_t num_cells = kNumCellsOf<TCmd>;
+		uint64_t pos = tail_.load(std::memory_order_relaxed);
+		while (true)
+		{
+			const uint32_t contiguous = static_cast<uint32_t>(kNumCells - (pos & kMask));
+			const uint32_t padding = (num_cells <= contiguous) ? 0 : contiguous;
+			const uint64_t end = pos + padding + num_cells;
+			if ((end - head_.load(std::memory_order_acquire)) > kNumCells)
+				return false; //full
+			if (tail_.compare_exchange_weak(pos, end, std::memory_order_relaxed))
+				break;
+		}
+
+		const uint32_t contiguous = static_cast<uint32_t>(kNumCells - (pos & kMask));
+		if (num_cells > contiguous)
+		{
+			states_[pos & kMask].store(Encode(contiguous, kPadding), std::memory_order_release);
+			pos += contiguous;
+		}
+		new (CellAt(pos)) TCmd(std::forward<Args>(args)...);
+		states_[pos & kMask].store(Encode(num_cells, IndexOf<TCmd>() + 1), std::memory_order_release);
+		return true;
+	}
+
+public:
+	CommandStream_SingleConsumer()
+		: overflow_(0)
+	{}
+
+	~CommandStream_SingleConsumer()
+	{
+		while (ConsumeAll([](auto&) {})) {}
+	}
+
+	template<typename TCmd, typename... Args>
+	void Emplace(Args&&... args)
+	{
+		static_assert(IndexOf<TCmd>() != kPadding, "not a command of this stream");
+		if (!overflow_num_.load(std::memory_order_acquire) && TryEmplaceStream<TCmd>(std::forward<Args>(args)...))
+			return;
+		overflow_num_.fetch_add(1);
+		overflow_.Emplace(std::in_place_type<TCmd>, std::forward<Args>(args)...);
+	}
+
+	template<typename TCmd>
+	void Enqueue(TCmd&& cmd)
+	{
+		Emplace<std::decay_t<TCmd>>(std::forward<TCmd>(cmd));
+	}
+
+	// func must accept every command type (void or bool result, like other batch consumers). Commands are visited
+	// in place, oldest first, then the spilled ones once the ring is drained. Consumer thread only.
+	template<typename F>
+	uint32_t ConsumeAll(F&& func)
+	{
+		using VisitFn = bool(*)(F&, void*);
+		static constexpr VisitFn kVisit[] = { &VisitCommand<F, TCommands>... };
+
+		uint32_t consumed = 0;
+		uint64_t pos = head_.load(std::memory_order_relaxed);
+		while (true)
+		{
+			std::atomic<uint32_t>& state = states_[pos & kMask];
+			const uint32_t value = state.load(std::memory_order_acquire);
+			if (!value)
+				break; //empty, or still being written
+			const uint32_t kind = value & 0xFF;
+			bool proceed = true;
+			if (kind != kPadding)
+			{
+				proceed = kVisit[kind - 1](func, CellAt(pos));
+				consumed++;
+			}
+			state.store(0, std::memory_order_relaxed);
+			pos += value >> 8;
+			head_.store(pos, std::memory_order_release);
+			if (!proceed)
+				return consumed;
+		}
+
+		// Spilled commands are newer than everything claimed in the ring, so the ring must be drained first.
+		if (overflow_num_.load(std::memory_order_acquire) && (pos == tail_.load(std::memory_order_acquire)))
+		{
+			consumed += overflow_.ConsumeAll([&](Spilled& item) -> bool
+			{
+				const bool proceed = std::visit([&](auto& cmd) { return VisitQueueItem(func, cmd); }, item);
+				overflow_num_.fetch_sub(1, std::memory_order_release);
+				return proceed;
+			});
+		}
+		return consumed;
+	}
+
+	// Cells taken by unconsumed commands and padding.
+	uint32_t NumUsedCells() const
+	{
+		return static_cast<uint32_t>(tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed));
+	}
+
+	uint32_t NumSpilled() const { return overflow_num_.load(std::memory_order_relaxed); }
+
+	uint32_t NumAllocated() const { return overflow_.NumAllocated(); }
+};
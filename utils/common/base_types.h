@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <cstddef>
 
 using int8 = int8_t;
 using uint8 = uint8_t;
@@ -10,3 +11,12 @@ using int32 = int32_t;
 using uint32 = uint32_t;
 using int64 = int64_t;
 using uint64 = uint64_t;
+
+constexpr std::size_t kCacheLineSize = 64;
+
+// Empty members take no space. MSVC ignores the standard attribute, it has its own.
+#if defined(_MSC_VER)
+#define NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
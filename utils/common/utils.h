@@ -32,8 +32,8 @@ namespace Utils
 	std::optional<T> ParseNumber(std::string_view trimmed_str)
 	{
 		T result{};
-		const char* end = str.data() + str.size();
-		auto [ptr, ec] = std::from_chars(str.data(), end, result);
+		const char* end = trimmed_str.data() + trimmed_str.size();
+		auto [ptr, ec] = std::from_chars(trimmed_str.data(), end, result);
 		const bool bOk = (ec == std::errc()) && (ptr == end);
 		return bOk ? result : std::optional<T>{};
 	}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+
+// CPU side bookkeeping of descriptor heap slots, independent of D3D12.
+// FreeList: O(1) allocate and free of single slots, for persistent heaps. Free slots are linked through an index array.
+// Linear: O(1) bump allocation of contiguous ranges and O(1) clear, for heaps refilled every frame. Slots are not freed one by one.
+class DescriptorAllocator
+{
+public:
+	enum class EMode : uint8_t { FreeList, Linear };
+	static constexpr uint32_t kInvalidIndex = 0xFFFFFFFF;
+
+private:
+	static constexpr uint32_t kTaken = 0xFFFFFFFE;	// next_free_ of an allocated slot
+
+	std::vector<uint32_t> next_free_;	// FreeList only
+	uint32_t first_free_ = kInvalidIndex;
+	uint32_t capacity_ = 0;
+	uint32_t num_allocated_ = 0;		// in Linear mode, also the next slot
+	EMode mode_ = EMode::FreeList;
+
+public:
+	void initialize(uint32_t capacity, EMode mode, uint32_t initially_allocated = 0)
+	{
+		assert(capacity < kTaken);
+		capacity_ = capacity;
+		mode_ = mode;
+		if (mode_ == EMode::FreeList)
+		{
+			next_free_.resize(capacity_);
+		}
+		clear(initially_allocated);
+	}
+
+	// Slots [0, initially_allocated) are taken. O(1) in Linear mode, O(capacity) in FreeList mode.
+	void clear(uint32_t initially_allocated = 0)
+	{
+		assert(initially_allocated <= capacity_);
+		num_allocated_ = initially_allocated;
+		if (mode_ == EMode::Linear)
+			return;
+		std::fill(next_free_.begin(), next_free_.begin() + initially_allocated, kTaken);
+		for (uint32_t idx = initially_allocated; idx < capacity_; idx++)
+		{
+			next_free_[idx] = ((idx + 1) < capacity_) ? (idx + 1) : kInvalidIndex;
+		}
+		first_free_ = (initially_allocated < capacity_) ? initially_allocated : kInvalidIndex;
+	}
+
+	// Returns the first of num contiguous slots, or kInvalidIndex when the heap is full. FreeList mode allocates single slots.
+	uint32_t allocate(uint32_t num = 1)
+	{
+		if (mode_ == EMode::Linear)
+		{
+			if ((capacity_ - num_allocated_) < num)
+				return kInvalidIndex;
+			const uint32_t first = num_allocated_;
+			num_allocated_ += num;
+			return first;
+		}
+		assert(num == 1);
+		const uint32_t idx = first_free_;
+		if (idx == kInvalidIndex)
+			return kInvalidIndex;
+		first_free_ = next_free_[idx];
+		next_free_[idx] = kTaken;
+		num_allocated_++;
+		return idx;
+	}
+
+	void free(uint32_t idx)
+	{
+		assert(mode_ == EMode::FreeList);
+		assert(is_set(idx));
+		next_free_[idx] = first_free_;
+		first_free_ = idx;
+		num_allocated_--;
+	}
+
+	bool is_set(uint32_t idx) const
+	{
+		assert(idx < capacity_);
+		return (mode_ == EMode::Linear) ? (idx < num_allocated_) : (next_free_[idx] == kTaken);
+	}
+
+	uint32_t get_capacity() const { return capacity_; }
+	uint32_t get_num_allocated() const { return num_allocated_; }
+	EMode get_mode() const { return mode_; }
+
+	void destroy()
+	{
+		next_free_.clear();
+		first_free_ = kInvalidIndex;
+		capacity_ = 0;
+		num_allocated_ = 0;
+	}
+};
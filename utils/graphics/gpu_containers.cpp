@@ -1,7 +1,8 @@
 #include "stdafx.h"
 #include "gpu_containers.h"
 
-void DescriptorHeap::create(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, D3D12_DESCRIPTOR_HEAP_FLAGS flags, uint32_t capacity, uint32_t initially_allocated)
+void DescriptorHeap::create(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, D3D12_DESCRIPTOR_HEAP_FLAGS flags, uint32_t capacity, uint32_t initially_allocated
+	, DescriptorAllocator::EMode mode)
 {
 	assert(device);
 	assert(!heap_);
@@ -10,30 +11,20 @@ void DescriptorHeap::create(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE typ
 	type_ = type;
 	descriptor_size_ = device->GetDescriptorHandleIncrementSize(type);
 
-	taken_slots_.resize(capacity, false);
 	assert(initially_allocated <= capacity);
-	for (uint32_t idx = 0; idx < initially_allocated; idx++)
-	{
-		taken_slots_[idx] = true;
-	}
+	allocator_.initialize(capacity, mode, initially_allocated);
 }
 
 uint32_t DescriptorHeap::allocate()
 {
-	auto found = std::find(taken_slots_.begin(), taken_slots_.end(), false);
-	if (found != taken_slots_.end())
-	{
-		*found = true;
-		return static_cast<uint32_t>(std::distance(taken_slots_.begin(), found));
-	}
-	assert(false);
-	return Const::kInvalid32;
+	const uint32_t idx = allocator_.allocate();
+	assert(idx != DescriptorAllocator::kInvalidIndex);
+	return (idx != DescriptorAllocator::kInvalidIndex) ? idx : Const::kInvalid32;
 }
 
 void DescriptorHeap::free(uint32_t idx)
 {
-	assert(is_set(idx));
-	taken_slots_[idx] = false;
+	allocator_.free(idx);
 }
 
 void DescriptorHeap::copy(ID3D12Device* device, uint32_t num, uint32_t dst_start, uint32_t src_start, const DescriptorHeap& src_heap)
@@ -46,17 +37,13 @@ void DescriptorHeap::copy(ID3D12Device* device, uint32_t num, uint32_t dst_start
 	{
 		for (uint32_t idx = 0; idx < num; idx++)
 		{
-			if (!src_heap.is_set(src_start + idx))
+			if (!src_heap.is_set(src_start + idx) || !is_set(dst_start + idx))
 				return false;
 		}
 		return true;
 	}());
 
 	device->CopyDescriptorsSimple(num, get_cpu_handle(dst_start), src_heap.get_cpu_handle(src_start), type_);
-	for (uint32_t idx = 0; idx < num; idx++) 
-	{ 
-		taken_slots_[dst_start + idx] = true;
-	}
 }
 
 void CommitedBuffer::create_resource(ID3D12Device* device)
@@ -165,19 +152,19 @@ void UploadBuffer::initialize(ID3D12Device* device, uint32_t size)
 	void* data = nullptr;
 	CD3DX12_RANGE read_range(0, 0);
 	upload_buffer_->Map(0, &read_range, &data);
-	current_pos_ = data_begin_ = reinterpret_cast<UINT8*>(data);
-	data_end_ = data_begin_ + size;
+	data_begin_ = reinterpret_cast<UINT8*>(data);
+	ring_.initialize(size);
 }
 
 std::optional<std::tuple<uint64_t, UINT8*>> UploadBuffer::reserve_space(std::size_t size, std::size_t alignment)
 {
 	static_assert(sizeof(uint64_t) == sizeof(UINT8*), "only x64 is supported");
-	UINT8* const local_begin = reinterpret_cast<UINT8*>(align(reinterpret_cast<uint64_t>(current_pos_), alignment));
-	//assert(std::distance(data_begin_, data_end_) > size);
-	if ((local_begin + size) > data_end_)
+	align(0, alignment); // validates the alignment
+	// The mapped resource is at least 64KB aligned, so aligning the offset aligns the address.
+	const uint64_t offset = ring_.allocate(size, alignment);
+	if (offset == UploadRing::kInvalidOffset)
 		return {};
-	current_pos_ = local_begin + size;
-	return { {std::distance(data_begin_, local_begin), local_begin} };
+	return { {offset, data_begin_ + offset} };
 }
 
 std::optional< uint64_t> UploadBuffer::data_to_upload(
@@ -192,9 +179,29 @@ std::optional< uint64_t> UploadBuffer::data_to_upload(
 	return { offset };
 }
 
+void UploadBuffer::set_size_limits(uint64_t min_size, uint64_t max_size)
+{
+	assert(min_size && (min_size <= max_size) && (max_size <= UINT32_MAX));
+	size_policy_.min_size = min_size;
+	size_policy_.max_size = max_size;
+}
+
+bool UploadBuffer::adapt_size(ID3D12Device* device)
+{
+	assert(!ring_.has_in_flight() && !ring_.get_used());
+	const uint64_t size = ring_.get_capacity();
+	const uint64_t new_size = size_policy_.next_size(size, ring_.get_high_water(), ring_.get_overflow_num());
+	ring_.clear_usage();
+	if (new_size == size)
+		return false;
+	destroy();
+	initialize(device, static_cast<uint32_t>(new_size));
+	return true;
+}
+
 void UploadBuffer::reset()
 {
-	current_pos_ = data_begin_;
+	ring_.reset();
 }
 
 void UploadBuffer::destroy()
@@ -203,6 +210,5 @@ void UploadBuffer::destroy()
 		upload_buffer_->Unmap(0, nullptr);
 	upload_buffer_.Reset();
 	data_begin_ = nullptr;
-	current_pos_ = nullptr;
-	data_end_ = nullptr;
+	ring_.reset();
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <wrl.h>
 #include <unordered_map>
 #include "../base_app_helper.h"
+#include "descriptor_allocator.h"
+#include "upload_ring.h"
+#include "stat/stat.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -20,13 +23,13 @@ protected:
 	ComPtr<ID3D12DescriptorHeap> heap_;
 	D3D12_DESCRIPTOR_HEAP_TYPE type_ = D3D12_DESCRIPTOR_HEAP_TYPE::D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES;
 	uint32_t descriptor_size_ = 0;
-	std::vector<bool> taken_slots_;
+	DescriptorAllocator allocator_;
 
 public:
 	ID3D12DescriptorHeap* get_heap() const { return heap_.Get(); }
 	ID3D12DescriptorHeap* Get() const { return heap_.Get(); } // to work with macro
-	uint32_t get_capacity() const { return static_cast<uint32_t>(taken_slots_.size()); }
-	bool is_set(uint32_t idx) const { return taken_slots_[idx]; }
+	uint32_t get_capacity() const { return allocator_.get_capacity(); }
+	bool is_set(uint32_t idx) const { return allocator_.is_set(idx); }
 
 	CD3DX12_CPU_DESCRIPTOR_HANDLE get_cpu_handle(uint32_t idx) const
 	{
@@ -44,20 +47,17 @@ public:
 		return CD3DX12_GPU_DESCRIPTOR_HANDLE(heap_->GetGPUDescriptorHandleForHeapStart(), idx, descriptor_size_);
 	}
 
-	void create(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, D3D12_DESCRIPTOR_HEAP_FLAGS flags, uint32_t capacity, uint32_t initially_allocated = 0);
+	// Linear mode is meant for per-frame, shader visible heaps: slots are taken in order and released together by clear.
+	void create(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, D3D12_DESCRIPTOR_HEAP_FLAGS flags, uint32_t capacity, uint32_t initially_allocated = 0
+		, DescriptorAllocator::EMode mode = DescriptorAllocator::EMode::FreeList);
 	uint32_t allocate();
+	// The destination slots must be allocated.
 	void copy(ID3D12Device* device, uint32_t num, uint32_t dst_start, uint32_t src_start, const DescriptorHeap& src_heap);
 	void free(uint32_t idx);
-	void clear(uint32_t initially_allocated = 0)
-	{
-		for (uint32_t idx = 0; idx < taken_slots_.size(); idx++)
-		{
-			taken_slots_[idx] = initially_allocated > idx;
-		}
-	}
+	void clear(uint32_t initially_allocated = 0) { allocator_.clear(initially_allocated); }
 	void destroy()
 	{
-		taken_slots_.clear();
+		allocator_.destroy();
 		heap_.Reset();
 		descriptor_size_ = 0;
 		type_ = D3D12_DESCRIPTOR_HEAP_TYPE::D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES;
@@ -157,24 +157,61 @@ inline DescriptorHeapElementRef CopyDescriptor(ID3D12Device* device, DescriptorH
 	return result;
 }
 
+// Either used linearly and reset, when the GPU finished with it, or as a ring: submit tags the data reserved since
+// the previous submit with a fence value, and retire reclaims the space of completed submissions.
 class UploadBuffer
 {
 	ComPtr<ID3D12Resource> upload_buffer_;
 	UINT8* data_begin_ = nullptr;    // starting position of upload buffer
-	UINT8* current_pos_ = nullptr;      // current position of upload buffer
-	UINT8* data_end_ = nullptr;      // ending position of upload buffer
+	UploadRing ring_;
+	UploadSizePolicy size_policy_;
 
 public:
 	static uint64_t align(uint64_t uLocation, uint64_t uAlign);
 	void initialize(ID3D12Device* device, uint32_t size);
 	std::optional< uint64_t > data_to_upload(const void* src_data, std::size_t size_bytes, std::size_t alignment);
 	std::optional<std::tuple<uint64_t, UINT8*>> reserve_space(std::size_t size_bytes, std::size_t alignment);
+	void submit(uint64_t fence_value) { ring_.submit(fence_value); }
+	void retire(uint64_t completed_fence_value) { ring_.retire(completed_fence_value); }
+	uint64_t get_oldest_fence_value() const { return ring_.get_oldest_fence_value(); }
+	// Usage since the last adapt_size.
+	uint64_t get_high_water() const { return ring_.get_high_water(); }
+	uint32_t get_overflow_num() const { return ring_.get_overflow_num(); }
+	uint64_t get_size() const { return ring_.get_capacity(); }
+	// Limits for adapt_size. Without them the size is fixed.
+	void set_size_limits(uint64_t min_size, uint64_t max_size);
+	// Recreates the buffer, when the usage since the last call asks for another size. Nothing can be in flight.
+	// Returns true when the buffer was recreated.
+	bool adapt_size(ID3D12Device* device);
 	void reset();
 	void destroy();
 	ID3D12Resource* get_resource() { return upload_buffer_.Get(); }
 	~UploadBuffer() { destroy(); }
 };
 
+#if DO_STAT
+struct UploadStats
+{
+	Stat::Id high_water;
+	Stat::Id overflows;
+	Stat::Id size;
+
+	UploadStats(const char* group)
+		: high_water(group, "upload_high_water", Stat::EMode::Override)
+		, overflows(group, "upload_overflows", Stat::EMode::PerFrame)
+		, size(group, "upload_size", Stat::EMode::Override)
+	{}
+
+	// Call before adapt_size, which clears the usage.
+	void pass(const UploadBuffer& buffer) const
+	{
+		high_water.PassValue(static_cast<double>(buffer.get_high_water()));
+		overflows.PassValue(buffer.get_overflow_num());
+		size.PassValue(static_cast<double>(buffer.get_size()));
+	}
+};
+#endif
+
 struct CommitedBuffer
 {
 	static constexpr D3D12_RESOURCE_STATES kDefaultState = D3D12_RESOURCE_STATE_COMMON;
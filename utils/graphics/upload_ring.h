@@ -0,0 +1,142 @@
+#pragma once
+
+#include <deque>
+#include <algorithm>
+#include <bit>
+#include <assert.h>
+#include <stdint.h>
+
+// CPU side bookkeeping of a ring upload buffer, independent of D3D12. Allocations made since the last submit form
+// a batch, tagged with the fence value signaled after the copies reading it. retire(completed_fence_value) reclaims
+// the batches the GPU finished, so space is reused as soon as possible, instead of once the whole buffer is idle.
+// Without submit, it behaves like a linear allocator cleared by reset.
+class UploadRing
+{
+public:
+	static constexpr uint64_t kInvalidOffset = ~uint64_t(0);
+
+private:
+	struct Submission
+	{
+		uint64_t end = 0;
+		uint64_t fence_value = 0;
+	};
+
+	std::deque<Submission> submissions_;
+	uint64_t capacity_ = 0;
+	uint64_t head_ = 0;			// positions grow monotonically, the offset is position % capacity_
+	uint64_t tail_ = 0;			// oldest position not retired yet
+	uint64_t submitted_ = 0;	// head_ at the last submit
+	uint64_t high_water_ = 0;	// since the last clear_usage
+	uint32_t overflow_num_ = 0;	// failed allocations since the last clear_usage
+
+public:
+	void initialize(uint64_t capacity)
+	{
+		capacity_ = capacity;
+		reset();
+		clear_usage();
+	}
+
+	// Returns the offset of the allocation, or kInvalidOffset when there is not enough space before the tail.
+	// An allocation never wraps around, the remaining bytes at the end of the buffer are skipped instead.
+	uint64_t allocate(uint64_t size, uint64_t alignment)
+	{
+		assert(alignment && !(alignment & (alignment - 1)));
+		const uint64_t offset = head_ % capacity_;
+		uint64_t begin = (offset + alignment - 1) & ~(alignment - 1);
+		uint64_t skipped = begin - offset;
+		if ((begin + size) > capacity_)
+		{
+			skipped = capacity_ - offset;
+			begin = 0;
+		}
+		const uint64_t new_head = head_ + skipped + size;
+		if ((new_head - tail_) > capacity_)
+		{
+			overflow_num_++;
+			return kInvalidOffset;
+		}
+		head_ = new_head;
+		high_water_ = std::max(high_water_, head_ - tail_);
+		return begin;
+	}
+
+	// Tags the allocations made since the last submit. Fence values must grow.
+	void submit(uint64_t fence_value)
+	{
+		if (head_ == submitted_)
+			return;
+		assert(submissions_.empty() || (submissions_.back().fence_value < fence_value));
+		submissions_.push_back({ head_, fence_value });
+		submitted_ = head_;
+	}
+
+	void retire(uint64_t completed_fence_value)
+	{
+		while (!submissions_.empty() && (submissions_.front().fence_value <= completed_fence_value))
+		{
+			tail_ = submissions_.front().end;
+			submissions_.pop_front();
+		}
+		if (head_ == tail_)
+		{
+			// Idle, so the next batch starts at the beginning and doesn't wrap.
+			head_ = tail_ = submitted_ = 0;
+		}
+	}
+
+	// Fence value to wait for, to reclaim the oldest batch. 0 when nothing is in flight.
+	uint64_t get_oldest_fence_value() const { return submissions_.empty() ? 0 : submissions_.front().fence_value; }
+	bool has_in_flight() const { return !submissions_.empty(); }
+	uint64_t get_used() const { return head_ - tail_; }
+	uint64_t get_capacity() const { return capacity_; }
+	uint64_t get_high_water() const { return high_water_; }
+	uint32_t get_overflow_num() const { return overflow_num_; }
+
+	// Usage is not cleared by reset, so it covers every frame since the last call.
+	void clear_usage()
+	{
+		high_water_ = 0;
+		overflow_num_ = 0;
+	}
+
+	void reset()
+	{
+		submissions_.clear();
+		head_ = tail_ = submitted_ = 0;
+	}
+};
+
+// Picks the size of an upload buffer from the usage observed since the previous call, within [min_size, max_size].
+// It doubles after an overflow. It shrinks to twice the peak usage, once the usage stayed under a quarter of the size
+// for kShrinkPeriods calls in a row, so a single quiet frame doesn't release the memory needed by the next burst.
+struct UploadSizePolicy
+{
+	static constexpr uint32_t kShrinkPeriods = 128;
+
+	uint64_t min_size = 0;
+	uint64_t max_size = 0;		// 0 keeps the size fixed
+	uint64_t quiet_peak = 0;	// highest usage in the current quiet streak
+	uint32_t quiet_periods = 0;
+
+	uint64_t next_size(uint64_t size, uint64_t high_water, uint32_t overflow_num)
+	{
+		if (!max_size)
+			return size;
+		assert(min_size && (min_size <= max_size));
+		if (overflow_num || ((high_water * 4) > size))
+		{
+			quiet_periods = 0;
+			quiet_peak = 0;
+			return std::clamp(overflow_num ? (size * 2) : size, min_size, max_size);
+		}
+		quiet_peak = std::max(quiet_peak, high_water);
+		if (++quiet_periods < kShrinkPeriods)
+			return std::clamp(size, min_size, max_size);
+		quiet_periods = 0;
+		const uint64_t shrunk = std::bit_ceil(std::max<uint64_t>(quiet_peak * 2, 1));
+		quiet_peak = 0;
+		return std::clamp(std::min(shrunk, size), min_size, max_size);
+	}
+};
@@ -0,0 +1,377 @@
+#pragma once
+
+#include<atomic>
+#include<bit>
+#include<limits>
+#include<assert.h>
+#include "common/base_types.h"
+
+#if defined(_MSC_VER) && defined(__AVX2__)
+#include<immintrin.h>
+#endif
+
+namespace Bits
+{
+	// tzcnt/popcnt when the target has BMI (implied by AVX2), std::countr_zero/std::popcount otherwise.
+	inline uint32 CountTrailingZeros(uint64 value)
+	{
+#if defined(_MSC_VER) && defined(__AVX2__)
+		return static_cast<uint32>(_tzcnt_u64(value));
+#else
+		return static_cast<uint32>(std::countr_zero(value));
+#endif
+	}
+
+	inline uint32 PopCount(uint64 value)
+	{
+#if defined(_MSC_VER) && defined(__AVX2__)
+		return static_cast<uint32>(_mm_popcnt_u64(value));
+#else
+		return static_cast<uint32>(std::popcount(value));
+#endif
+	}
+
+	// Bits [first, 64)
+	constexpr uint64 MaskFrom(uint32 first) { return (first < 64) ? (~uint64(0) << first) : 0; }
+	// Bits [0, num)
+	constexpr uint64 MaskFirst(uint32 num) { return (num < 64) ? ((uint64(1) << num) - 1) : ~uint64(0); }
+}
+
+// Bit set over 64-bit leaf words, with two summary levels: a leaf has a set bit / a leaf has a clear bit.
+// Searches skip 64 leaves (4096 bits) per summary word. Not thread safe.
+template<std::size_t N>
+class HierarchicalBitmap
+{
+public:
+	static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+private:
+	static constexpr uint32 kLeafWords = static_cast<uint32>((N + 63) / 64);
+	static constexpr uint32 kSummaryWords = (kLeafWords + 63) / 64;
+	static_assert(N > 0, "empty bitmap");
+
+	uint64 leaves_[kLeafWords] = {};
+	uint64 any_set_[kSummaryWords] = {};
+	uint64 any_clear_[kSummaryWords] = {};
+
+	// Bits past N in the last leaf are never set.
+	static constexpr uint64 ValidMask(uint32 leaf)
+	{
+		return (leaf == (kLeafWords - 1)) ? Bits::MaskFirst(static_cast<uint32>(N - leaf * 64)) : ~uint64(0);
+	}
+
+	void UpdateSummary(uint32 leaf)
+	{
+		const uint64 bit = uint64(1) << (leaf % 64);
+		uint64& any_set = any_set_[leaf / 64];
+		uint64& any_clear = any_clear_[leaf / 64];
+		any_set = leaves_[leaf] ? (any_set | bit) : (any_set & ~bit);
+		any_clear = (leaves_[leaf] != ValidMask(leaf)) ? (any_clear | bit) : (any_clear & ~bit);
+	}
+
+	// First leaf >= first_leaf flagged in the summary.
+	static uint32 FindLeaf(const uint64* summary, uint32 first_leaf)
+	{
+		for (uint32 word = first_leaf / 64; word < kSummaryWords; word++)
+		{
+			uint64 value = summary[word];
+			if (word == (first_leaf / 64))
+			{
+				value &= Bits::MaskFrom(first_leaf % 64);
+			}
+			if (value)
+				return word * 64 + Bits::CountTrailingZeros(value);
+		}
+		return kLeafWords;
+	}
+
+	template<bool kSet>
+	std::size_t FindFrom(std::size_t start) const
+	{
+		if (start >= N)
+			return npos;
+		const uint32 first_leaf = static_cast<uint32>(start / 64);
+		auto leaf_value = [this](uint32 leaf) { return kSet ? leaves_[leaf] : (~leaves_[leaf] & ValidMask(leaf)); };
+		const uint64 in_first = leaf_value(first_leaf) & Bits::MaskFrom(start % 64);
+		if (in_first)
+			return first_leaf * 64 + Bits::CountTrailingZeros(in_first);
+		const uint32 leaf = FindLeaf(kSet ? any_set_ : any_clear_, first_leaf + 1);
+		if (leaf >= kLeafWords)
+			return npos;
+		return leaf * 64 + Bits::CountTrailingZeros(leaf_value(leaf));
+	}
+
+	template<bool kSet>
+	void AssignRange(std::size_t first, std::size_t num)
+	{
+		assert((first + num) <= N);
+		std::size_t idx = first;
+		const std::size_t end = first + num;
+		while (idx < end)
+		{
+			const uint32 leaf = static_cast<uint32>(idx / 64);
+			const uint32 bit = idx % 64;
+			const uint32 bits_in_leaf = static_cast<uint32>(std::min<std::size_t>(64 - bit, end - idx));
+			const uint64 mask = Bits::MaskFirst(bits_in_leaf) << bit;
+			leaves_[leaf] = kSet ? (leaves_[leaf] | mask) : (leaves_[leaf] & ~mask);
+			UpdateSummary(leaf);
+			idx += bits_in_leaf;
+		}
+	}
+
+public:
+	HierarchicalBitmap() { clear_all(); }
+
+	static constexpr std::size_t size() { return N; }
+
+	bool test(std::size_t idx) const
+	{
+		assert(idx < N);
+		return leaves_[idx / 64] & (uint64(1) << (idx % 64));
+	}
+
+	bool operator[](std::size_t idx) const { return test(idx); }
+
+	void set(std::size_t idx)
+	{
+		assert(idx < N);
+		leaves_[idx / 64] |= uint64(1) << (idx % 64);
+		UpdateSummary(static_cast<uint32>(idx / 64));
+	}
+
+	void clear(std::size_t idx)
+	{
+		assert(idx < N);
+		leaves_[idx / 64] &= ~(uint64(1) << (idx % 64));
+		UpdateSummary(static_cast<uint32>(idx / 64));
+	}
+
+	void set(std::size_t idx, bool value) { value ? set(idx) : clear(idx); }
+
+	void set_range(std::size_t first, std::size_t num) { AssignRange<true>(first, num); }
+	void clear_range(std::size_t first, std::size_t num) { AssignRange<false>(first, num); }
+	void set_all() { set_range(0, N); }
+	void clear_all() { clear_range(0, N); }
+
+	std::size_t find_first_set() const { return FindFrom<true>(0); }
+	std::size_t find_first_clear() const { return FindFrom<false>(0); }
+	// First index > idx, like bitset2::find_next.
+	std::size_t find_next_set(std::size_t idx) const { return FindFrom<true>(idx + 1); }
+	std::size_t find_next_clear(std::size_t idx) const { return FindFrom<false>(idx + 1); }
+
+	std::size_t count() const
+	{
+		std::size_t num = 0;
+		for (const uint64 leaf : leaves_)
+		{
+			num += Bits::PopCount(leaf);
+		}
+		return num;
+	}
+
+	// func(std::size_t idx) for every set bit, in order. func must not modify the bitmap.
+	template<typename F>
+	void for_each_set(F&& func) const
+	{
+		for (uint32 leaf = FindLeaf(any_set_, 0); leaf < kLeafWords; leaf = FindLeaf(any_set_, leaf + 1))
+		{
+			for (uint64 value = leaves_[leaf]; value; value &= value - 1)
+			{
+				func(static_cast<std::size_t>(leaf) * 64 + Bits::CountTrailingZeros(value));
+			}
+		}
+	}
+};
+
+// Concurrent counterpart with the same two summary levels. acquire_set and set are lock-free and may run on any
+// thread, queries give a snapshot. A summary bit may briefly stay set for an empty (or full) leaf, but once the call
+// returns, it's never clear for a leaf with a set (or clear) bit.
+template<std::size_t N>
+class AtomicHierarchicalBitmap
+{
+public:
+	static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+private:
+	static constexpr uint32 kLeafWords = static_cast<uint32>((N + 63) / 64);
+	static constexpr uint32 kSummaryWords = (kLeafWords + 63) / 64;
+	static_assert(N > 0, "empty bitmap");
+
+	std::atomic<uint64> leaves_[kLeafWords] = {};
+	std::atomic<uint64> any_set_[kSummaryWords] = {};
+	std::atomic<uint64> any_clear_[kSummaryWords] = {};
+
+	static constexpr uint64 ValidMask(uint32 leaf)
+	{
+		return (leaf == (kLeafWords - 1)) ? Bits::MaskFirst(static_cast<uint32>(N - leaf * 64)) : ~uint64(0);
+	}
+
+	static constexpr uint64 SummaryBit(uint32 leaf) { return uint64(1) << (leaf % 64); }
+
+	// Summary bits of the leaves that exist.
+	static constexpr uint64 SummaryMask(uint32 word) { return Bits::MaskFirst(std::min<uint32>(64, kLeafWords - word * 64)); }
+
+	// Tries to clear the lowest set bit of the leaf.
+	std::size_t AcquireInLeaf(uint32 leaf)
+	{
+		std::atomic<uint64>& word = leaves_[leaf];
+		uint64 value = word.load(std::memory_order_relaxed);
+		while (value)
+		{
+			const uint64 lowest = value & (~value + 1);
+			if (word.compare_exchange_weak(value, value & ~lowest))
+			{
+				if (value == ValidMask(leaf))
+				{
+					// The leaf was full. Otherwise its clear bits keep the summary bit set.
+					any_clear_[leaf / 64].fetch_or(SummaryBit(leaf));
+				}
+				if (value == lowest)
+				{
+					// The leaf became empty. A concurrent set may have flagged it in between, so check again.
+					any_set_[leaf / 64].fetch_and(~SummaryBit(leaf));
+					if (word.load())
+					{
+						any_set_[leaf / 64].fetch_or(SummaryBit(leaf));
+					}
+				}
+				return static_cast<std::size_t>(leaf) * 64 + Bits::CountTrailingZeros(lowest);
+			}
+		}
+		return npos;
+	}
+
+	// First leaf >= first_leaf flagged in the summary.
+	static uint32 FindFlaggedLeaf(const std::atomic<uint64>* summary, uint32 first_leaf)
+	{
+		for (uint32 word = first_leaf / 64; word < kSummaryWords; word++)
+		{
+			uint64 value = summary[word].load(std::memory_order_relaxed);
+			if (word == (first_leaf / 64))
+			{
+				value &= Bits::MaskFrom(first_leaf % 64);
+			}
+			if (value)
+				return word * 64 + Bits::CountTrailingZeros(value);
+		}
+		return kLeafWords;
+	}
+
+	uint64 LeafValue(uint32 leaf, bool set) const
+	{
+		const uint64 value = leaves_[leaf].load(std::memory_order_relaxed);
+		return set ? value : (~value & ValidMask(leaf));
+	}
+
+	std::size_t FindFrom(std::size_t start, bool set) const
+	{
+		if (start >= N)
+			return npos;
+		const uint32 first_leaf = static_cast<uint32>(start / 64);
+		uint64 value = LeafValue(first_leaf, set) & Bits::MaskFrom(start % 64);
+		uint32 leaf = first_leaf;
+		while (!value)
+		{
+			leaf = FindFlaggedLeaf(set ? any_set_ : any_clear_, leaf + 1);
+			if (leaf >= kLeafWords)
+				return npos;
+			value = LeafValue(leaf, set);
+		}
+		return static_cast<std::size_t>(leaf) * 64 + Bits::CountTrailingZeros(value);
+	}
+
+public:
+	AtomicHierarchicalBitmap()
+	{
+		for (uint32 word = 0; word < kSummaryWords; word++)
+		{
+			any_clear_[word].store(SummaryMask(word), std::memory_order_relaxed);
+		}
+	}
+
+	static constexpr std::size_t size() { return N; }
+
+	bool test(std::size_t idx) const
+	{
+		assert(idx < N);
+		return leaves_[idx / 64].load(std::memory_order_relaxed) & (uint64(1) << (idx % 64));
+	}
+
+	// Thread safe. Clears a set bit and returns its index, npos when none is set. The search starts at first_hint
+	// and wraps around, so acquire_set(0) returns the lowest set bit when there is no concurrent access.
+	std::size_t acquire_set(std::size_t first_hint = 0)
+	{
+		const uint32 first_leaf = static_cast<uint32>((first_hint % N) / 64);
+		for (uint32 it = 0; it < kSummaryWords + 1; it++)
+		{
+			const uint32 word = ((first_leaf / 64) + it) % kSummaryWords;
+			uint64 summary = any_set_[word].load(std::memory_order_acquire);
+			if (it == 0)
+			{
+				summary &= Bits::MaskFrom(first_leaf % 64);
+			}
+			else if (it == kSummaryWords)
+			{
+				summary &= ~Bits::MaskFrom(first_leaf % 64); // the wrapped part of the first word
+			}
+			for (; summary; summary &= summary - 1)
+			{
+				const std::size_t idx = AcquireInLeaf(word * 64 + Bits::CountTrailingZeros(summary));
+				if (idx != npos)
+					return idx;
+			}
+		}
+		return npos;
+	}
+
+	// Thread safe. The bit must be clear.
+	void set(std::size_t idx)
+	{
+		assert(idx < N);
+		const uint32 leaf = static_cast<uint32>(idx / 64);
+		const uint64 previous = leaves_[leaf].fetch_or(uint64(1) << (idx % 64));
+		assert(!(previous & (uint64(1) << (idx % 64))));
+		any_set_[leaf / 64].fetch_or(SummaryBit(leaf));
+		if ((previous | (uint64(1) << (idx % 64))) == ValidMask(leaf))
+		{
+			// The leaf became full. A concurrent acquire_set may have flagged it in between, so check again.
+			any_clear_[leaf / 64].fetch_and(~SummaryBit(leaf));
+			if (leaves_[leaf].load() != ValidMask(leaf))
+			{
+				any_clear_[leaf / 64].fetch_or(SummaryBit(leaf));
+			}
+		}
+	}
+
+	// Not concurrent with acquire_set or set.
+	void set_all()
+	{
+		for (uint32 leaf = 0; leaf < kLeafWords; leaf++)
+		{
+			leaves_[leaf].store(ValidMask(leaf), std::memory_order_relaxed);
+		}
+		for (uint32 word = 0; word < kSummaryWords; word++)
+		{
+			any_set_[word].store(SummaryMask(word), std::memory_order_relaxed);
+			any_clear_[word].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	std::size_t find_first_set() const { return FindFrom(0, true); }
+	std::size_t find_first_clear() const { return FindFrom(0, false); }
+	std::size_t find_next_set(std::size_t idx) const { return FindFrom(idx + 1, true); }
+	std::size_t find_next_clear(std::size_t idx) const { return FindFrom(idx + 1, false); }
+
+	// func(std::size_t idx) for every clear bit, in order. Full leaves are skipped through the summary.
+	template<typename F>
+	void for_each_clear(F&& func) const
+	{
+		for (uint32 leaf = FindFlaggedLeaf(any_clear_, 0); leaf < kLeafWords; leaf = FindFlaggedLeaf(any_clear_, leaf + 1))
+		{
+			for (uint64 value = ~leaves_[leaf].load(std::memory_order_relaxed) & ValidMask(leaf); value; value &= value - 1)
+			{
+				func(static_cast<std::size_t>(leaf) * 64 + Bits::CountTrailingZeros(value));
+			}
+		}
+	}
+};
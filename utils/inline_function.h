@@ -0,0 +1,95 @@
+#pragma once
+
+#include<new>
+#include<cstddef>
+#include<utility>
+#include<type_traits>
+#include<assert.h>
+#include "common/base_types.h"
+
+template<typename Signature, uint32_t kInlineSize = 64>
+class InlineFunction;
+
+// Move-only callable, the capture is always stored inline. A capture that doesn't fit is a compile error
+// rather than a hidden heap allocation.
+template<typename R, typename... Args, uint32_t kInlineSize>
+class InlineFunction<R(Args...), kInlineSize>
+{
+	struct VTable
+	{
+		R(*invoke)(void*, Args&&...);
+		void(*move)(void* dst, void* src);
+		void(*destroy)(void*);
+	};
+
+	template<typename F>
+	static constexpr VTable kVTable = {
+		[](void* callable, Args&&... args) -> R { return (*static_cast<F*>(callable))(std::forward<Args>(args)...); },
+		[](void* dst, void* src) { new (dst) F(std::move(*static_cast<F*>(src))); },
+		[](void* callable) { static_cast<F*>(callable)->~F(); }
+	};
+
+	alignas(std::max_align_t) std::byte storage_[kInlineSize];
+	const VTable* vtable_ = nullptr;
+
+	void Reset()
+	{
+		if (vtable_)
+		{
+			vtable_->destroy(storage_);
+			vtable_ = nullptr;
+		}
+	}
+
+	void MoveFrom(InlineFunction& other)
+	{
+		if (other.vtable_)
+		{
+			other.vtable_->move(storage_, other.storage_);
+			vtable_ = other.vtable_;
+			other.Reset();
+		}
+	}
+
+public:
+	InlineFunction() = default;
+	InlineFunction(std::nullptr_t) {}
+
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InlineFunction>>>
+	InlineFunction(F&& func)
+	{
+		using Callable = std::decay_t<F>;
+		static_assert(sizeof(Callable) <= kInlineSize, "capture doesn't fit inline");
+		static_assert(alignof(Callable) <= alignof(std::max_align_t), "over-aligned capture");
+		static_assert(std::is_nothrow_move_constructible_v<Callable>, "capture must be nothrow movable");
+		new (storage_) Callable(std::forward<F>(func));
+		vtable_ = &kVTable<Callable>;
+	}
+
+	InlineFunction(InlineFunction&& other) noexcept { MoveFrom(other); }
+
+	InlineFunction& operator=(InlineFunction&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			MoveFrom(other);
+		}
+		return *this;
+	}
+
+	InlineFunction& operator=(std::nullptr_t) { Reset(); return *this; }
+
+	InlineFunction(const InlineFunction&) = delete;
+	InlineFunction& operator=(const InlineFunction&) = delete;
+
+	~InlineFunction() { Reset(); }
+
+	explicit operator bool() const { return vtable_; }
+
+	R operator()(Args... args)
+	{
+		assert(vtable_);
+		return vtable_->invoke(storage_, std::forward<Args>(args)...);
+	}
+};
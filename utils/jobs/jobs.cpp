@@ -0,0 +1,489 @@
+#include "stdafx.h"
+#include "jobs.h"
+#include "config/config.h"
+#include "log/log.h"
+#include <memory>
+#include <thread>
+
+namespace Jobs
+{
+	IF_DO_LOG(LogCategory jobs_log("jobs");)
+
+	struct Job
+	{
+		Function func;
+		Counter* counter = nullptr;
+		Job* next = nullptr;	// in the pool, or in the injected queue
+	};
+
+	// Jobs are allocated in chunks and recycled through a small cache per thread, so scheduling doesn't touch the heap
+	// once the pool is warm. Caches over kMaxCached jobs give half of them back to the shared list. Jobs taken on one
+	// thread are mostly given back on another, so the jobs parked in the caches vary with the timing. Reserve covers
+	// full caches, so the pool doesn't grow with that, only with the jobs in flight.
+	class JobPool
+	{
+		static constexpr uint32 kChunkSize = 256;
+		static constexpr uint32 kMaxCached = 64;
+		static constexpr uint32 kRefill = kMaxCached / 2;
+
+		struct Cache
+		{
+			Job* first = nullptr;
+			uint32 num = 0;
+
+			~Cache();
+		};
+		static thread_local Cache t_cache;
+
+		std::mutex mutex_;
+		Job* free_ = nullptr;
+		std::vector<std::unique_ptr<Job[]>> chunks_;
+
+		void AddChunk() // under mutex_
+		{
+			Job* const chunk = chunks_.emplace_back(std::make_unique<Job[]>(kChunkSize)).get();
+			for (uint32 idx = 0; idx < kChunkSize; idx++)
+			{
+				chunk[idx].next = (idx + 1 < kChunkSize) ? &chunk[idx + 1] : free_;
+			}
+			free_ = chunk;
+		}
+
+		void Refill(Cache& cache)
+		{
+			std::lock_guard lock(mutex_);
+			if (!free_)
+			{
+				AddChunk();
+			}
+			while (free_ && (cache.num < kRefill))
+			{
+				Job* const job = free_;
+				free_ = job->next;
+				job->next = cache.first;
+				cache.first = job;
+				cache.num++;
+			}
+		}
+
+		void Release(Cache& cache, uint32 num)
+		{
+			std::lock_guard lock(mutex_);
+			for (; num && cache.first; num--)
+			{
+				Job* const job = cache.first;
+				cache.first = job->next;
+				cache.num--;
+				job->next = free_;
+				free_ = job;
+			}
+		}
+
+	public:
+		// Enough jobs for a full cache on each of num_threads threads, and kChunkSize jobs in flight.
+		void Reserve(uint32 num_threads)
+		{
+			std::lock_guard lock(mutex_);
+			while ((chunks_.size() * kChunkSize) < (num_threads * kMaxCached + kChunkSize))
+			{
+				AddChunk();
+			}
+		}
+
+		Job* Take(Function&& func, Counter* counter)
+		{
+			Cache& cache = t_cache;
+			if (!cache.first)
+			{
+				Refill(cache);
+			}
+			Job* const job = cache.first;
+			cache.first = job->next;
+			cache.num--;
+			job->next = nullptr;
+			job->func = std::move(func);
+			job->counter = counter;
+			return job;
+		}
+
+		void Give(Job* job)
+		{
+			assert(job && !job->next);
+			job->func = nullptr;
+			job->counter = nullptr;
+			Cache& cache = t_cache;
+			job->next = cache.first;
+			cache.first = job;
+			if (++cache.num > kMaxCached)
+			{
+				Release(cache, cache.num - kRefill);
+			}
+		}
+
+		void ReleaseAll(Cache& cache) { Release(cache, cache.num); }
+	};
+
+	JobPool g_job_pool;
+	thread_local JobPool::Cache JobPool::t_cache;
+
+	JobPool::Cache::~Cache() { g_job_pool.ReleaseAll(*this); }
+
+	thread_local const Counter* t_executing_counter = nullptr;
+
+	const Counter* ExecutingCounter() { return t_executing_counter; }
+
+	// Chase-Lev deque with a fixed capacity. The owner pushes and pops at the bottom, thieves steal from the top.
+	class WorkStealingDeque
+	{
+		static constexpr int64 kCapacity = 4096;
+		static constexpr int64 kMask = kCapacity - 1;
+
+		alignas(kCacheLineSize) std::atomic<int64> top_ = 0;
+		alignas(kCacheLineSize) std::atomic<int64> bottom_ = 0;
+		alignas(kCacheLineSize) std::atomic<Job*> buffer_[kCapacity] = {};
+
+	public:
+		bool Push(Job* job) //owner
+		{
+			const int64 bottom = bottom_.load(std::memory_order_relaxed);
+			const int64 top = top_.load(std::memory_order_acquire);
+			if ((bottom - top) >= kCapacity)
+				return false;
+			buffer_[bottom & kMask].store(job, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom_.store(bottom + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		Job* Pop() //owner
+		{
+			const int64 bottom = bottom_.load(std::memory_order_relaxed) - 1;
+			bottom_.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64 top = top_.load(std::memory_order_relaxed);
+			if (top > bottom)
+			{
+				bottom_.store(bottom + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Job* job = buffer_[bottom & kMask].load(std::memory_order_relaxed);
+			if (top == bottom) // last one, race with thieves
+			{
+				if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					job = nullptr;
+				}
+				bottom_.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+
+		Job* Steal() //any thread
+		{
+			int64 top = top_.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64 bottom = bottom_.load(std::memory_order_acquire);
+			if (top >= bottom)
+				return nullptr;
+			Job* job = buffer_[top & kMask].load(std::memory_order_relaxed);
+			if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return job;
+		}
+	};
+
+	struct Worker
+	{
+		WorkStealingDeque deque;
+		std::thread thread;
+		uint32 index = 0;
+	};
+
+	thread_local Worker* t_worker = nullptr;
+
+	struct Scheduler
+	{
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::atomic_bool running = false;
+
+		// Jobs scheduled from threads outside of the pool, or set aside by Wait. Linked through Job::next.
+		std::mutex injected_mutex;
+		Job* injected_first = nullptr;
+		Job* injected_last = nullptr;
+		std::atomic<uint32> num_injected = 0;
+
+		std::atomic<uint32> wake_epoch = 0;
+		std::atomic<uint32> num_sleeping = 0;
+
+		void WakeOne()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (num_sleeping.load(std::memory_order_relaxed))
+			{
+				wake_epoch.fetch_add(1);
+				wake_epoch.notify_one();
+			}
+		}
+
+		void Inject(Job* job)
+		{
+			std::lock_guard lock(injected_mutex);
+			(injected_last ? injected_last->next : injected_first) = job;
+			injected_last = job;
+			num_injected++;
+		}
+
+		void Push(Job* job)
+		{
+			assert(job && !job->next);
+			if (!t_worker || !t_worker->deque.Push(job))
+			{
+				Inject(job);
+			}
+			WakeOne();
+		}
+
+		// The counters of queued jobs are alive, the jobs keep them pending.
+		static bool IsWaitedBy(const Job& job, const Counter& counter)
+		{
+			for (const Counter* it = job.counter; it; it = it->parent_)
+			{
+				if (it == &counter)
+					return true;
+			}
+			return false;
+		}
+
+		// The oldest injected job, or the oldest one of the waited counter.
+		Job* PopInjected(const Counter* waited = nullptr)
+		{
+			if (!num_injected.load(std::memory_order_relaxed))
+				return nullptr;
+			std::lock_guard lock(injected_mutex);
+			Job* prev = nullptr;
+			for (Job* job = injected_first; job; prev = job, job = job->next)
+			{
+				if (waited && !IsWaitedBy(*job, *waited))
+					continue;
+				(prev ? prev->next : injected_first) = job->next;
+				if (injected_last == job)
+				{
+					injected_last = prev;
+				}
+				job->next = nullptr;
+				num_injected--;
+				return job;
+			}
+			return nullptr;
+		}
+
+		// The waited jobs were pushed last, they are at the bottom of the own deque. Other jobs found there are set
+		// aside to the injected queue, where the workers take them, even when this one is the only worker.
+		Job* FindJobOf(const Counter& counter)
+		{
+			if (t_worker)
+			{
+				while (Job* job = t_worker->deque.Pop())
+				{
+					if (IsWaitedBy(*job, counter))
+						return job;
+					Inject(job);
+					WakeOne();
+				}
+			}
+			return PopInjected(&counter);
+		}
+
+		Job* FindJob()
+		{
+			if (t_worker)
+			{
+				if (Job* job = t_worker->deque.Pop())
+					return job;
+			}
+			if (Job* job = PopInjected())
+				return job;
+
+			const uint32 num_workers = static_cast<uint32>(workers.size());
+			const uint32 start = t_worker ? (t_worker->index + 1) : 0;
+			for (uint32 it = 0; it < num_workers; it++)
+			{
+				Worker& victim = *workers[(start + it) % num_workers];
+				if (&victim == t_worker)
+					continue;
+				if (Job* job = victim.deque.Steal())
+					return job;
+			}
+			return nullptr;
+		}
+
+		void Finish(Counter& counter)
+		{
+			counter.finishing_.fetch_add(1);
+			if (1 == counter.pending_.fetch_sub(1))
+			{
+				std::vector<Job*> continuations;
+				{
+					std::lock_guard lock(counter.continuations_mutex_);
+					continuations.swap(counter.continuations_);
+				}
+				for (Job* job : continuations)
+				{
+					Push(job);
+				}
+				counter.pending_.notify_all();
+			}
+			counter.finishing_.fetch_sub(1);
+		}
+
+		void Execute(Job* job)
+		{
+			assert(job);
+			const Counter* const outer_counter = t_executing_counter;
+			t_executing_counter = job->counter;
+			job->func();
+			t_executing_counter = outer_counter;
+			// The capture is released before the waiting thread may return.
+			Counter* const counter = job->counter;
+			g_job_pool.Give(job);
+			if (counter)
+			{
+				Finish(*counter);
+			}
+		}
+
+		void WorkerLoop(Worker& worker)
+		{
+			t_worker = &worker;
+			while (true)
+			{
+				const uint32 epoch = wake_epoch.load();
+				if (Job* job = FindJob())
+				{
+					Execute(job);
+					continue;
+				}
+				if (!running.load())
+					break;
+
+				num_sleeping.fetch_add(1);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (Job* job = FindJob())
+				{
+					num_sleeping.fetch_sub(1);
+					Execute(job);
+					continue;
+				}
+				if (running.load())
+				{
+					wake_epoch.wait(epoch);
+				}
+				num_sleeping.fetch_sub(1);
+			}
+			t_worker = nullptr;
+		}
+
+		static Job* MakeJob(Function&& func, Counter* counter)
+		{
+			if (counter)
+			{
+				counter->pending_.fetch_add(1);
+			}
+			return g_job_pool.Take(std::move(func), counter);
+		}
+
+		void ScheduleAfter(Counter& dependency, Function&& func, Counter* counter)
+		{
+			Job* job = MakeJob(std::move(func), counter);
+			{
+				std::lock_guard lock(dependency.continuations_mutex_);
+				if (!dependency.IsDone())
+				{
+					dependency.continuations_.push_back(job);
+					return;
+				}
+			}
+			Push(job);
+		}
+
+		void Wait(Counter& counter)
+		{
+			while (!counter.IsDone())
+			{
+				if (Job* job = FindJobOf(counter))
+				{
+					Execute(job);
+					continue;
+				}
+				const uint32 pending = counter.pending_.load();
+				if (pending)
+				{
+					counter.pending_.wait(pending);
+				}
+			}
+		}
+	};
+
+	Scheduler g_scheduler;
+
+	void Initialize(uint32 num_workers)
+	{
+		assert(g_scheduler.workers.empty());
+		if (!num_workers)
+		{
+			const uint32 hardware_threads = std::thread::hardware_concurrency();
+			num_workers = Config::GetNumber<uint32>("jobs", "workers")
+				.value_or(hardware_threads > 1 ? hardware_threads - 1 : 1);
+		}
+		num_workers = std::max(num_workers, 1u);
+		LOG(jobs_log, ELog::Display, "starting {} workers", num_workers);
+		// The workers, and a thread scheduling the jobs.
+		g_job_pool.Reserve(num_workers + 1);
+
+		g_scheduler.running = true;
+		for (uint32 idx = 0; idx < num_workers; idx++)
+		{
+			std::unique_ptr<Worker>& worker = g_scheduler.workers.emplace_back(std::make_unique<Worker>());
+			worker->index = idx;
+		}
+		for (std::unique_ptr<Worker>& worker : g_scheduler.workers)
+		{
+			worker->thread = std::thread(&Scheduler::WorkerLoop, &g_scheduler, std::ref(*worker));
+		}
+	}
+
+	void Shutdown()
+	{
+		g_scheduler.running = false;
+		g_scheduler.wake_epoch.fetch_add(1);
+		g_scheduler.wake_epoch.notify_all();
+		for (std::unique_ptr<Worker>& worker : g_scheduler.workers)
+		{
+			worker->thread.join();
+		}
+		g_scheduler.workers.clear();
+		assert(!g_scheduler.injected_first);
+	}
+
+	uint32 NumWorkers() { return static_cast<uint32>(g_scheduler.workers.size()); }
+
+	bool IsWorkerThread() { return t_worker; }
+
+	void Schedule(Function&& func, Counter* counter)
+	{
+		assert(g_scheduler.running);
+		g_scheduler.Push(Scheduler::MakeJob(std::move(func), counter));
+	}
+
+	void ScheduleAfter(Counter& dependency, Function&& func, Counter* counter)
+	{
+		assert(g_scheduler.running);
+		g_scheduler.ScheduleAfter(dependency, std::move(func), counter);
+	}
+
+	void Wait(Counter& counter)
+	{
+		g_scheduler.Wait(counter);
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include "common/base_types.h"
+#include "inline_function.h"
+
+namespace Jobs
+{
+	// Jobs are pooled, the capture is stored in the job itself.
+	using Function = InlineFunction<void()>;
+	struct Job;
+	class Counter;
+
+	// Counter of the job executed by the calling thread, nullptr outside of jobs.
+	const Counter* ExecutingCounter();
+
+	// Number of unfinished jobs. Pass it to Schedule to join a group of jobs with Wait,
+	// or use it as a dependency in ScheduleAfter. A counter created inside a job is a child of the job's counter.
+	class Counter
+	{
+		Counter(const Counter&) = delete;
+		Counter& operator=(const Counter&) = delete;
+
+	public:
+		Counter() : parent_(ExecutingCounter()) {}
+		~Counter()
+		{
+			assert(IsDone());
+			while (finishing_.load()) {} // the last finishing job may still touch the counter
+		}
+
+		bool IsDone() const { return !pending_.load(std::memory_order_acquire); }
+
+	private:
+		friend struct Scheduler;
+		const Counter* const parent_;
+		std::atomic<uint32> pending_ = 0;
+		std::atomic<uint32> finishing_ = 0;
+		std::mutex continuations_mutex_;
+		std::vector<Job*> continuations_;
+	};
+
+	// num_workers == 0: use [jobs] workers from Config, or the hardware concurrency.
+	void Initialize(uint32 num_workers = 0);
+	void Shutdown();
+	uint32 NumWorkers();
+	bool IsWorkerThread();
+
+	// Thread safe. Counter (optional) is incremented immediately and decremented once func returns.
+	void Schedule(Function&& func, Counter* counter = nullptr);
+
+	// Thread safe. func is scheduled when dependency is done.
+	void ScheduleAfter(Counter& dependency, Function&& func, Counter* counter = nullptr);
+
+	// Executes the jobs of counter and of its child counters while waiting, so it's safe to call it from a job.
+	// Unrelated jobs are left to the workers, a system waiting for its ParallelFor never runs another system.
+	void Wait(Counter& counter);
+
+	// func(uint32 index) is called for each index in [0, num). The calling thread takes part in the work.
+	template<typename F>
+	void ParallelFor(uint32 num, uint32 batch_size, F&& func)
+	{
+		batch_size = std::max(batch_size, 1u);
+		const uint32 num_batches = (num + batch_size - 1) / batch_size;
+		auto run_batch = [&func, batch_size, num](uint32 batch)
+		{
+			const uint32 end = std::min(num, (batch + 1) * batch_size);
+			for (uint32 idx = batch * batch_size; idx < end; idx++)
+			{
+				func(idx);
+			}
+		};
+
+		Counter counter;
+		for (uint32 batch = 1; batch < num_batches; batch++)
+		{
+			Schedule([&run_batch, batch]() { run_batch(batch); }, &counter);
+		}
+		if (num_batches)
+		{
+			run_batch(0);
+		}
+		Wait(counter);
+	}
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include<atomic>
+#include<optional>
+#include<mutex>
+#include<vector>
+#include<span>
+#include<algorithm>
+#include<new>
+#include<assert.h>
+#include "common/base_types.h"
+#include "mpsc_queue.h"
+
+namespace LaneQueue
+{
+	// Lanes are keyed by producer. By default the producer is the calling thread. A pooled system runs its passes
+	// on different workers, so it installs itself as the producer for the duration of a pass, and keeps its lane.
+	inline thread_local const void* t_producer_key = nullptr;
+	inline thread_local char t_thread_marker = 0;
+	inline std::atomic<uint64> g_next_queue_id = 1;
+
+	inline const void* GetProducerKey() { return t_producer_key ? t_producer_key : &t_thread_marker; }
+
+	using ReleaseLaneFunction = void(*)(void* queue, void* lane);
+
+	// Ids of the queues alive. An exiting thread gives its lanes back only to these.
+	inline std::mutex g_live_queues_mutex;
+	inline std::vector<uint64> g_live_queues;
+
+	struct CacheEntry
+	{
+		uint64 queue_id = 0;
+		const void* producer_key = nullptr;
+		void* lane = nullptr;
+		void* queue = nullptr;
+		ReleaseLaneFunction release = nullptr;
+	};
+
+	// Queue ids are never reused, so entries of destroyed queues are never hit. When the thread exits, the lanes
+	// keyed by the thread are released, so another producer can take them over. Lanes of a ProducerScope stay with
+	// its key (one per pooled system).
+	struct LaneCache
+	{
+		std::vector<CacheEntry> entries;
+
+		~LaneCache()
+		{
+			std::lock_guard lock(g_live_queues_mutex);
+			for (const CacheEntry& entry : entries)
+			{
+				const bool alive = std::find(g_live_queues.begin(), g_live_queues.end(), entry.queue_id) != g_live_queues.end();
+				if (alive && entry.lane && (entry.producer_key == &t_thread_marker))
+				{
+					entry.release(entry.queue, entry.lane);
+				}
+			}
+		}
+	};
+	inline thread_local LaneCache t_lane_cache;
+
+	// Passes never overlap and are ordered by the job system, so a single producer per lane is preserved.
+	struct ProducerScope
+	{
+		explicit ProducerScope(const void* key) : previous_(t_producer_key) { t_producer_key = key; }
+		~ProducerScope() { t_producer_key = previous_; }
+
+		ProducerScope(const ProducerScope&) = delete;
+		ProducerScope& operator=(const ProducerScope&) = delete;
+	private:
+		const void* previous_;
+	};
+}
+
+// Multi producer, single consumer queue built from single producer lanes. Each producer lazily registers
+// its own unbounded SPSC lane, so producers never write to a shared cache line. The consumer visits the lanes
+// round-robin. FIFO order holds per producer only. Lanes of exited threads are taken over by new producers.
+// When all kMaxLanes are in use, remaining producers share an MPSC fallback queue.
+template<typename T, uint32_t kSegmentSize = 64, uint32_t kMaxLanes = 16>
+class LaneQueue_SingleConsumer
+{
+	LaneQueue_SingleConsumer(const LaneQueue_SingleConsumer&) = delete;
+	LaneQueue_SingleConsumer& operator=(const LaneQueue_SingleConsumer&) = delete;
+	LaneQueue_SingleConsumer(const LaneQueue_SingleConsumer&&) = delete;
+	LaneQueue_SingleConsumer& operator=(const LaneQueue_SingleConsumer&&) = delete;
+
+	struct Segment
+	{
+		alignas(T) std::byte storage[sizeof(T) * kSegmentSize];
+		std::atomic<uint32_t> written = 0;	// published slots
+		std::atomic<Segment*> next = nullptr;
+
+		T& At(uint32_t index) { return *std::launder(reinterpret_cast<T*>(storage + index * sizeof(T))); }
+		void* RawAt(uint32_t index) { return storage + index * sizeof(T); }
+	};
+
+	struct Lane
+	{
+		const void* producer_key = nullptr;	// nullptr when released, guarded by register_mutex_
+
+		alignas(kCacheLineSize) Segment* tail = nullptr;	// producer
+		uint32_t tail_index = 0;
+		std::atomic<uint64_t> enqueued = 0;
+
+		alignas(kCacheLineSize) Segment* head = nullptr;	// consumer
+		uint32_t head_index = 0;
+		std::atomic<uint64_t> consumed = 0;
+		std::atomic<Segment*> spare = nullptr;				// recycled by the consumer, taken by the producer
+	};
+
+	const uint64 id_ = LaneQueue::g_next_queue_id.fetch_add(1);
+	std::atomic<Lane*> lanes_[kMaxLanes] = {};
+	std::atomic<uint32_t> num_lanes_ = 0;
+	std::mutex register_mutex_;
+	std::atomic<uint32_t> allocated_segments_ = 0;
+	uint32_t next_lane_ = 0;	// consumer, round-robin start
+	LockFreeQueue_SingleConsumer<T, kSegmentSize> fallback_;
+
+	Segment* AllocateSegment()
+	{
+		allocated_segments_.fetch_add(1, std::memory_order_relaxed);
+		return new Segment();
+	}
+
+	void FreeSegment(Segment* segment)
+	{
+		allocated_segments_.fetch_sub(1, std::memory_order_relaxed);
+		delete segment;
+	}
+
+	Lane* FindLane(const void* producer_key) const
+	{
+		const uint32_t num = std::min(num_lanes_.load(std::memory_order_acquire), kMaxLanes);
+		for (uint32_t idx = 0; idx < num; idx++)
+		{
+			Lane* lane = lanes_[idx].load(std::memory_order_acquire);
+			if (lane && (lane->producer_key == producer_key))
+				return lane;
+		}
+		return nullptr;
+	}
+
+	// nullptr when all lanes were taken at the first call of the producer.
+	Lane* GetProducerLane()
+	{
+		const void* producer_key = LaneQueue::GetProducerKey();
+		for (const LaneQueue::CacheEntry& entry : LaneQueue::t_lane_cache.entries)
+		{
+			if ((entry.queue_id == id_) && (entry.producer_key == producer_key))
+				return static_cast<Lane*>(entry.lane);
+		}
+
+		Lane* lane = nullptr;
+		{
+			std::lock_guard lock(register_mutex_);
+			lane = FindLane(producer_key);
+			if (!lane)
+			{
+				// A released lane continues from its tail, items of the previous producer are still consumed first.
+				lane = FindLane(nullptr);
+				if (lane)
+				{
+					lane->producer_key = producer_key;
+				}
+			}
+			const uint32_t num = num_lanes_.load(std::memory_order_relaxed);
+			if (!lane && (num < kMaxLanes))
+			{
+				lane = new Lane();
+				lane->producer_key = producer_key;
+				lane->head = lane->tail = AllocateSegment();
+				lanes_[num].store(lane, std::memory_order_release);
+				num_lanes_.store(num + 1, std::memory_order_release);
+			}
+		}
+		// A producer that fell back stays there, even when a lane is released later, or its order would break.
+		LaneQueue::t_lane_cache.entries.push_back({ id_, producer_key, lane, this, &ReleaseLane });
+		return lane;
+	}
+
+	// Called by the exiting producer thread, with g_live_queues_mutex held.
+	static void ReleaseLane(void* queue, void* lane)
+	{
+		LaneQueue_SingleConsumer& owner = *static_cast<LaneQueue_SingleConsumer*>(queue);
+		std::lock_guard lock(owner.register_mutex_);
+		static_cast<Lane*>(lane)->producer_key = nullptr;
+	}
+
+	template<typename... Args>
+	void Push(Lane& lane, Args&&... args)
+	{
+		if (lane.tail_index == kSegmentSize)
+		{
+			Segment* segment = lane.spare.exchange(nullptr, std::memory_order_acquire);
+			if (!segment)
+			{
+				segment = AllocateSegment();
+			}
+			lane.tail->next.store(segment, std::memory_order_release);
+			lane.tail = segment;
+			lane.tail_index = 0;
+		}
+		new (lane.tail->RawAt(lane.tail_index)) T(std::forward<Args>(args)...);
+		lane.tail_index++;
+		lane.tail->written.store(lane.tail_index, std::memory_order_release);
+		lane.enqueued.store(lane.enqueued.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	void Recycle(Lane& lane, Segment* segment)
+	{
+		segment->written.store(0, std::memory_order_relaxed);
+		segment->next.store(nullptr, std::memory_order_relaxed);
+		Segment* expected = nullptr;
+		if (!lane.spare.compare_exchange_strong(expected, segment, std::memory_order_release))
+		{
+			FreeSegment(segment);
+		}
+	}
+
+	// Visits items published so far in the lane. Returns false, when func asked to stop.
+	template<typename F>
+	bool ConsumeLane(Lane& lane, F& func, uint32_t& consumed)
+	{
+		while (true)
+		{
+			const uint32_t written = lane.head->written.load(std::memory_order_acquire);
+			if (lane.head_index < written)
+			{
+				T& item = lane.head->At(lane.head_index);
+				const bool proceed = VisitQueueItem(func, item);
+				item.~T();
+				lane.head_index++;
+				lane.consumed.store(lane.consumed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				consumed++;
+				if (!proceed)
+					return false;
+				continue;
+			}
+
+			if (lane.head_index < kSegmentSize)
+				return true;
+			Segment* next = lane.head->next.load(std::memory_order_acquire);
+			if (!next)
+				return true;
+			Segment* spent = lane.head;
+			lane.head = next;
+			lane.head_index = 0;
+			Recycle(lane, spent);
+		}
+	}
+
+public:
+	LaneQueue_SingleConsumer()
+		: fallback_(0)
+	{
+		std::lock_guard lock(LaneQueue::g_live_queues_mutex);
+		LaneQueue::g_live_queues.push_back(id_);
+	}
+
+	~LaneQueue_SingleConsumer()
+	{
+		{
+			std::lock_guard lock(LaneQueue::g_live_queues_mutex);
+			std::erase(LaneQueue::g_live_queues, id_);
+		}
+		ConsumeAll([](T&) {});
+		for (std::atomic<Lane*>& it : lanes_)
+		{
+			Lane* lane = it.load();
+			if (!lane)
+				continue;
+			assert(lane->head == lane->tail);
+			FreeSegment(lane->head);
+			if (Segment* spare = lane->spare.load())
+			{
+				FreeSegment(spare);
+			}
+			delete lane;
+		}
+	}
+
+	void Enqueue(T&& item)
+	{
+		Emplace(std::move(item));
+	}
+
+	// Constructs the item directly in the lane slot.
+	template<typename... Args>
+	void Emplace(Args&&... args)
+	{
+		if (Lane* lane = GetProducerLane())
+		{
+			Push(*lane, std::forward<Args>(args)...);
+			return;
+		}
+		fallback_.Emplace(std::forward<Args>(args)...);
+	}
+
+	// Visits published items in place, lane by lane. When func returns false, the drain stops after the current
+	// item and the next call starts with the following lane. Consumer thread only.
+	template<typename F>
+	uint32_t ConsumeAll(F&& func)
+	{
+		uint32_t consumed = 0;
+		const uint32_t num = std::min(num_lanes_.load(std::memory_order_acquire), kMaxLanes);
+		for (uint32_t it = 0; it < num; it++)
+		{
+			const uint32_t idx = (next_lane_ + it) % num;
+			Lane* lane = lanes_[idx].load(std::memory_order_acquire);
+			if (lane && !ConsumeLane(*lane, func, consumed))
+			{
+				next_lane_ = idx + 1;
+				return consumed;
+			}
+		}
+		next_lane_ = num ? ((next_lane_ + 1) % num) : 0;
+		consumed += fallback_.ConsumeAll(func);
+		return consumed;
+	}
+
+	uint32_t DrainInto(std::span<T> out) //consumer thread
+	{
+		uint32_t num = 0;
+		if (out.empty())
+			return num;
+		ConsumeAll([&](T& item) -> bool
+		{
+			out[num++] = std::move(item);
+			return num < out.size();
+		});
+		return num;
+	}
+
+	std::optional<T> Pop() //consumer thread
+	{
+		std::optional<T> result;
+		ConsumeAll([&](T& item) -> bool
+		{
+			result.emplace(std::move(item));
+			return false;
+		});
+		return result;
+	}
+
+	uint32_t Num() const
+	{
+		uint64_t num = fallback_.Num();
+		for (const std::atomic<Lane*>& it : lanes_)
+		{
+			if (const Lane* lane = it.load(std::memory_order_acquire))
+			{
+				num += lane->enqueued.load(std::memory_order_relaxed) - lane->consumed.load(std::memory_order_relaxed);
+			}
+		}
+		return static_cast<uint32_t>(num);
+	}
+
+	uint32_t NumLanes() const { return std::min(num_lanes_.load(std::memory_order_relaxed), kMaxLanes); }
+
+	// Lane segments and fallback blocks.
+	uint32_t NumAllocated() const { return allocated_segments_.load(std::memory_order_relaxed) + fallback_.NumAllocated(); }
+
+	void ClearFreeList() { fallback_.ClearFreeList(); }
+};
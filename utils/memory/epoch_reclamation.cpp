@@ -0,0 +1,201 @@
+#include "stdafx.h"
+#include "epoch_reclamation.h"
+#include <mutex>
+#include <vector>
+#include <limits>
+#include <assert.h>
+
+namespace Reclamation
+{
+	constexpr uint64 kInactive = std::numeric_limits<uint64>::max();
+
+	struct alignas(kCacheLineSize) ThreadRecord
+	{
+		std::atomic<uint64> epoch = kInactive;
+		std::atomic_bool used = false;
+	};
+
+	struct RetiredPtr
+	{
+		void* ptr = nullptr;
+		Deleter deleter = nullptr;
+		uint64 epoch = 0;
+	};
+
+	// Blocks are only appended, and freed with the domain, so a record never moves and can be scanned lock-free.
+	struct RecordBlock
+	{
+		ThreadRecord records[kRecordsPerBlock];
+		std::atomic<RecordBlock*> next = nullptr;
+	};
+
+	struct Domain
+	{
+		RecordBlock first_block;
+		std::atomic<uint64> global_epoch = 1;
+
+		std::mutex retired_mutex;
+		std::vector<RetiredPtr> retired;
+
+		~Domain()
+		{
+			for (const RetiredPtr& it : retired)
+			{
+				it.deleter(it.ptr);
+			}
+			for (RecordBlock* block = first_block.next.load(); block;)
+			{
+				RecordBlock* const next = block->next.load();
+				delete block;
+				block = next;
+			}
+		}
+
+		template<typename F>
+		void ForEachRecord(F&& func)
+		{
+			for (RecordBlock* block = &first_block; block; block = block->next.load(std::memory_order_acquire))
+			{
+				for (ThreadRecord& record : block->records)
+				{
+					func(record);
+				}
+			}
+		}
+
+		ThreadRecord* TryClaim()
+		{
+			ThreadRecord* claimed = nullptr;
+			ForEachRecord([&](ThreadRecord& record)
+			{
+				bool expected = false;
+				if (!claimed && !record.used.load(std::memory_order_relaxed) && record.used.compare_exchange_strong(expected, true))
+				{
+					claimed = &record;
+				}
+			});
+			return claimed;
+		}
+
+		ThreadRecord& AcquireRecord()
+		{
+			if (ThreadRecord* record = TryClaim())
+				return *record;
+
+			// All records are taken, append a block with the first record already claimed.
+			RecordBlock* const new_block = new RecordBlock();
+			new_block->records[0].used.store(true, std::memory_order_relaxed);
+			RecordBlock* last = &first_block;
+			while (true)
+			{
+				RecordBlock* expected = nullptr;
+				if (last->next.compare_exchange_weak(expected, new_block))
+					return new_block->records[0];
+				if (expected)
+				{
+					last = expected;
+				}
+			}
+		}
+
+		bool TryAdvance(uint64 epoch)
+		{
+			bool all_current = true;
+			ForEachRecord([&](const ThreadRecord& record)
+			{
+				const uint64 local = record.epoch.load();
+				all_current &= (local == kInactive) || (local == epoch);
+			});
+			return all_current && global_epoch.compare_exchange_strong(epoch, epoch + 1);
+		}
+	};
+
+	Domain g_domain;
+
+	// Returns the record to the domain when the thread exits.
+	struct ThreadState
+	{
+		ThreadRecord* record = nullptr;
+		uint32 depth = 0;
+
+		~ThreadState()
+		{
+			if (record)
+			{
+				record->epoch.store(kInactive);
+				record->used.store(false);
+			}
+		}
+	};
+
+	thread_local ThreadState t_state;
+
+	void Enter()
+	{
+		if (t_state.depth++)
+			return;
+		if (!t_state.record)
+		{
+			t_state.record = &g_domain.AcquireRecord();
+		}
+		// The announcement must be visible before any shared pointer is read. If the epoch moved meanwhile,
+		// the announced value could already be too old to protect anything, so announce again.
+		uint64 epoch = g_domain.global_epoch.load();
+		while (true)
+		{
+			t_state.record->epoch.store(epoch);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const uint64 actual = g_domain.global_epoch.load();
+			if (actual == epoch)
+				break;
+			epoch = actual;
+		}
+	}
+
+	void Leave()
+	{
+		assert(t_state.depth && t_state.record);
+		if (--t_state.depth)
+			return;
+		t_state.record->epoch.store(kInactive, std::memory_order_release);
+	}
+
+	void Retire(void* ptr, Deleter deleter)
+	{
+		assert(ptr && deleter);
+		{
+			std::lock_guard lock(g_domain.retired_mutex);
+			g_domain.retired.push_back({ ptr, deleter, g_domain.global_epoch.load() });
+		}
+	}
+
+	void Collect()
+	{
+		// Two steps are needed before anything retired in the current epoch can be freed.
+		uint64 epoch = g_domain.global_epoch.load();
+		for (uint32 step = 0; (step < 2) && g_domain.TryAdvance(epoch); step++)
+		{
+			epoch++;
+		}
+		epoch = g_domain.global_epoch.load();
+
+		// Retired in epoch e could be seen only by threads that entered in e or e-1.
+		std::vector<RetiredPtr> to_free;
+		{
+			std::lock_guard lock(g_domain.retired_mutex);
+			auto is_safe = [epoch](const RetiredPtr& it) { return (it.epoch + 2) <= epoch; };
+			for (const RetiredPtr& it : g_domain.retired)
+			{
+				if (is_safe(it))
+				{
+					to_free.push_back(it);
+				}
+			}
+			std::erase_if(g_domain.retired, is_safe);
+		}
+		for (const RetiredPtr& it : to_free)
+		{
+			it.deleter(it.ptr);
+		}
+	}
+}
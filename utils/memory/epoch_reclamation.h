@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include "common/base_types.h"
+
+// Epoch based reclamation. Lock-free readers run inside a Guard. Memory they might still see is passed to Retire,
+// and freed only after every thread that was inside a Guard at that moment has left it.
+namespace Reclamation
+{
+	using Deleter = void(*)(void*);
+
+	// Records of the threads are allocated in blocks of this size. A thread returns its record when it exits, a new
+	// block is added only when more threads are inside the domain at once.
+	constexpr uint32 kRecordsPerBlock = 64;
+
+	void Enter();
+	void Leave();
+
+	// Thread safe. The memory is freed by one of the following Collect calls.
+	void Retire(void* ptr, Deleter deleter);
+
+	// Thread safe. Tries to advance the global epoch, and frees what is no longer reachable.
+	void Collect();
+
+	// Nested guards are allowed.
+	struct Guard
+	{
+		Guard() { Enter(); }
+		~Guard() { Leave(); }
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+	};
+
+	template<typename T>
+	void Retire(T* ptr)
+	{
+		Retire(ptr, [](void* raw) { delete static_cast<T*>(raw); });
+	}
+}
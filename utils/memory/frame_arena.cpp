@@ -0,0 +1,96 @@
+#include "stdafx.h"
+#include "frame_arena.h"
+#include <algorithm>
+#include <memory>
+#include <assert.h>
+
+namespace
+{
+	thread_local FrameArena* t_current_arena = nullptr;
+}
+
+FrameArena::FrameArena(std::size_t capacity, std::pmr::memory_resource* upstream)
+	: buffer_(std::make_unique<std::byte[]>(capacity))
+	, capacity_(capacity)
+	, upstream_(upstream)
+{
+	assert(upstream_);
+}
+
+FrameArena::~FrameArena()
+{
+	Reset();
+}
+
+void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	// The buffer itself is only aligned for std::max_align_t, so the address is aligned, not the offset.
+	void* ptr = buffer_.get() + used_;
+	std::size_t space = capacity_ - used_;
+	if (std::align(alignment, bytes, ptr, space))
+	{
+		used_ = capacity_ - space + bytes;
+		peak_ = std::max(peak_, used_);
+		return ptr;
+	}
+	void* const fallback = upstream_->allocate(bytes, alignment);
+	fallbacks_.push_back({ fallback, bytes, alignment });
+	fallback_num_++;
+	return fallback;
+}
+
+void FrameArena::Reset()
+{
+	for (const Fallback& it : fallbacks_)
+	{
+		upstream_->deallocate(it.ptr, it.bytes, it.alignment);
+	}
+	fallbacks_.clear();
+	fallback_num_ = 0;
+	used_ = 0;
+}
+
+void FrameArena::Rewind(const Mark& mark)
+{
+	assert((mark.used <= used_) && (mark.fallbacks <= fallbacks_.size()));
+	for (std::size_t idx = mark.fallbacks; idx < fallbacks_.size(); idx++)
+	{
+		upstream_->deallocate(fallbacks_[idx].ptr, fallbacks_[idx].bytes, fallbacks_[idx].alignment);
+	}
+	fallbacks_.resize(mark.fallbacks);
+	used_ = mark.used;
+}
+
+FrameArena* FrameArena::Current()
+{
+	return t_current_arena;
+}
+
+std::pmr::memory_resource* FrameArena::CurrentResource()
+{
+	return t_current_arena ? static_cast<std::pmr::memory_resource*>(t_current_arena) : std::pmr::get_default_resource();
+}
+
+FrameArena::RewindScope::RewindScope(FrameArena* arena)
+	: arena_(arena)
+	, mark_(arena ? arena->GetMark() : Mark{})
+{}
+
+FrameArena::RewindScope::~RewindScope()
+{
+	if (arena_)
+	{
+		arena_->Rewind(mark_);
+	}
+}
+
+FrameArena::Scope::Scope(FrameArena* arena)
+	: previous_(t_current_arena)
+{
+	t_current_arena = arena;
+}
+
+FrameArena::Scope::~Scope()
+{
+	t_current_arena = previous_;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory_resource>
+#include <memory>
+#include <vector>
+#include "common/base_types.h"
+
+// Linear allocator for transient data, released all at once by Reset (at a frame boundary). It's a
+// std::pmr::memory_resource, so pmr containers can use it directly. Allocations that don't fit go to the upstream
+// resource, and are released by Reset too. Deallocation is a no-op. Not thread safe, except for deallocation.
+class FrameArena : public std::pmr::memory_resource
+{
+	struct Fallback
+	{
+		void* ptr = nullptr;
+		std::size_t bytes = 0;
+		std::size_t alignment = 0;
+	};
+
+	std::unique_ptr<std::byte[]> buffer_;
+	std::size_t capacity_ = 0;
+	std::size_t used_ = 0;
+	std::size_t peak_ = 0;
+	std::pmr::memory_resource* upstream_ = nullptr;
+	std::vector<Fallback> fallbacks_;
+	uint32 fallback_num_ = 0;	// since the last Reset
+
+protected:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+	void do_deallocate(void*, std::size_t, std::size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+	explicit FrameArena(std::size_t capacity, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// Everything allocated so far must be already destroyed.
+	void Reset();
+
+	// Position in the arena, to release the scratch data of a single pass before the end of the frame.
+	struct Mark
+	{
+		std::size_t used = 0;
+		std::size_t fallbacks = 0;
+	};
+	Mark GetMark() const { return { used_, fallbacks_.size() }; }
+	// Releases everything allocated since the mark, it must be already destroyed. GetFallbackNum still counts the
+	// released fallbacks.
+	void Rewind(const Mark& mark);
+
+	std::size_t GetCapacity() const { return capacity_; }
+	std::size_t GetUsed() const { return used_; }
+	// Highest usage of the buffer (without fallbacks) since the creation.
+	std::size_t GetPeak() const { return peak_; }
+	uint32 GetFallbackNum() const { return fallback_num_; }
+
+	// Arena of the system running on this thread, nullptr outside of system passes.
+	static FrameArena* Current();
+	// Current arena, or the default resource when there is none.
+	static std::pmr::memory_resource* CurrentResource();
+
+	// Rewinds the arena (if any) to its mark from the construction. Declare it before the scratch containers.
+	struct RewindScope
+	{
+		explicit RewindScope(FrameArena* arena);
+		~RewindScope();
+
+		RewindScope(const RewindScope&) = delete;
+		RewindScope& operator=(const RewindScope&) = delete;
+	private:
+		FrameArena* arena_;
+		Mark mark_;
+	};
+
+	// Installs the arena as the current one, for the duration of a system pass.
+	struct Scope
+	{
+		explicit Scope(FrameArena* arena);
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		FrameArena* previous_;
+	};
+};
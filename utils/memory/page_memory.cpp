@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "page_memory.h"
+#include "config/config.h"
+#include "log/log.h"
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+namespace PageMemory
+{
+	IF_DO_LOG(LogCategory page_memory_log("page_memory");)
+
+#if defined(_WIN32)
+	namespace
+	{
+		// Large pages need SeLockMemoryPrivilege enabled in the process token.
+		bool EnableLockMemoryPrivilege()
+		{
+			HANDLE token = nullptr;
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+				return false;
+			TOKEN_PRIVILEGES privileges = {};
+			privileges.PrivilegeCount = 1;
+			privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+			const bool found = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid);
+			// AdjustTokenPrivileges succeeds, even when the privilege is not assigned to the user.
+			const bool enabled = found && AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+				&& (GetLastError() == ERROR_SUCCESS);
+			CloseHandle(token);
+			return enabled;
+		}
+
+		std::size_t LargePageSize()
+		{
+			static const std::size_t size = EnableLockMemoryPrivilege() ? GetLargePageMinimum() : 0;
+			return size;
+		}
+
+		void* VirtualAllocOnNode(std::size_t size, DWORD type, int32 numa_node)
+		{
+			return (numa_node < 0)
+				? VirtualAlloc(nullptr, size, type, PAGE_READWRITE)
+				: VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, type, PAGE_READWRITE, static_cast<DWORD>(numa_node));
+		}
+	}
+#else
+	namespace
+	{
+		constexpr std::size_t kLargePageSize = 2 * 1024 * 1024;
+
+		// Maps size bytes at a kLargePageSize boundary, so transparent huge pages can back the whole range.
+		void* MapAligned(std::size_t size)
+		{
+			const std::size_t reserved = size + kLargePageSize;
+			void* const mapped = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapped == MAP_FAILED)
+				return nullptr;
+			const uintptr_t begin = reinterpret_cast<uintptr_t>(mapped);
+			const uintptr_t aligned = (begin + kLargePageSize - 1) & ~(kLargePageSize - 1);
+			if (aligned != begin)
+			{
+				munmap(mapped, aligned - begin);
+			}
+			munmap(reinterpret_cast<void*>(aligned + size), (begin + reserved) - (aligned + size));
+			return reinterpret_cast<void*>(aligned);
+		}
+	}
+#endif
+
+	Policy PolicyFromConfig()
+	{
+		Policy policy;
+		policy.large_pages = Config::GetNumber<uint32>("memory", "large_pages").value_or(0) != 0;
+		policy.numa_node = Config::GetNumber<int32>("memory", "numa_node").value_or(-1);
+		return policy;
+	}
+
+#if defined(_WIN32)
+	Block Allocate(std::size_t size, const Policy& policy)
+	{
+		assert(size);
+		if (policy.large_pages)
+		{
+			if (const std::size_t large_page_size = LargePageSize())
+			{
+				const std::size_t large_size = (size + large_page_size - 1) & ~(large_page_size - 1);
+				if (void* ptr = VirtualAllocOnNode(large_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, policy.numa_node))
+					return Block{ ptr, large_size, true };
+				LOG(page_memory_log, ELog::Warning, "no large pages for {} bytes, error {}", large_size, GetLastError());
+			}
+			else
+			{
+				LOG(page_memory_log, ELog::Warning, "large pages are not available");
+			}
+		}
+		void* ptr = VirtualAllocOnNode(size, MEM_RESERVE | MEM_COMMIT, policy.numa_node);
+		if (!ptr)
+			throw std::bad_alloc();
+		return Block{ ptr, size, false };
+	}
+
+	void Free(Block& block)
+	{
+		if (block.ptr)
+		{
+			VirtualFree(block.ptr, 0, MEM_RELEASE);
+		}
+		block = Block{};
+	}
+#else
+	Block Allocate(std::size_t size, const Policy& policy)
+	{
+		assert(size);
+		// The NUMA node is not honoured, the pages are placed on the node of the thread that touches them first.
+		if (policy.large_pages)
+		{
+			const std::size_t large_size = (size + kLargePageSize - 1) & ~(kLargePageSize - 1);
+			// Reserved huge pages first (vm.nr_hugepages), then transparent huge pages, when the kernel allows them.
+			void* const ptr = mmap(nullptr, large_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (ptr != MAP_FAILED)
+				return Block{ ptr, large_size, true };
+			if (void* const thp_ptr = MapAligned(large_size))
+			{
+				const bool advised = madvise(thp_ptr, large_size, MADV_HUGEPAGE) == 0;
+				LOG(page_memory_log, ELog::Warning, "no reserved huge pages for {} bytes, transparent: {}", large_size, advised);
+				return Block{ thp_ptr, large_size, advised };
+			}
+		}
+		void* const ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			throw std::bad_alloc();
+		return Block{ ptr, size, false };
+	}
+
+	void Free(Block& block)
+	{
+		if (block.ptr)
+		{
+			munmap(block.ptr, block.size);
+		}
+		block = Block{};
+	}
+#endif
+}
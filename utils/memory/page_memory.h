@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <new>
+#include "common/base_types.h"
+
+// Page granular backing for large, long lived arrays, that are scanned or copied every tick. 2MB pages cut the TLB
+// misses of such scans. They need the "Lock pages in memory" privilege, without it the allocation falls back to
+// regular pages. Regular pages are placed on the NUMA node of the thread that touches them first, unless a node is
+// given explicitly. Elsewhere (the tests), reserved huge pages are tried first, then transparent ones, and the NUMA
+// node is always the first touch one.
+namespace PageMemory
+{
+	struct Policy
+	{
+		bool large_pages = false;
+		int32 numa_node = -1;	// -1: first touch
+	};
+
+	// Section "memory": large_pages (0/1), numa_node.
+	Policy PolicyFromConfig();
+
+	struct Block
+	{
+		void* ptr = nullptr;
+		std::size_t size = 0;
+		bool large_pages = false;
+	};
+
+	// Page aligned, zeroed. Throws std::bad_alloc.
+	Block Allocate(std::size_t size, const Policy& policy);
+
+	void Free(Block& block);
+}
+
+// Owns a T constructed in its own pages.
+template<typename T>
+class PageBacked
+{
+	PageMemory::Block block_;
+	T* object_ = nullptr;
+
+public:
+	template<typename... Args>
+	explicit PageBacked(const PageMemory::Policy& policy, Args&&... args)
+		: block_(PageMemory::Allocate(sizeof(T), policy))
+	{
+		static_assert(alignof(T) <= 4096, "over-aligned for a page");
+		try
+		{
+			object_ = new (block_.ptr) T(std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			PageMemory::Free(block_);
+			throw;
+		}
+	}
+
+	~PageBacked()
+	{
+		object_->~T();
+		PageMemory::Free(block_);
+	}
+
+	PageBacked(const PageBacked&) = delete;
+	PageBacked& operator=(const PageBacked&) = delete;
+
+	bool IsLargePages() const { return block_.large_pages; }
+
+			T* operator->()			{ return object_; }
+	const	T* operator->() const	{ return object_; }
+			T& operator*()			{ return *object_; }
+	const	T& operator*()	const	{ return *object_; }
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include<atomic>
+#include<variant>
+#include<utility>
+#include<algorithm>
+#include<type_traits>
+#include<cstring>
+#include<assert.h>
+#include "common/base_types.h"
+#include "common_msg.h"
+
+// Publish/subscribe bus for CommonMsg. Every alternative of CommonMsg::Message has its own topic: a broadcast
+// ring written by publishers and read by each subscriber at its own pace. Subscribers are notified on the
+// publishing thread, and read the messages on their own threads.
+namespace CommonMsg
+{
+	constexpr uint32 kNumTypes = static_cast<uint32>(std::variant_size_v<Message>);
+	constexpr uint32 kMaxSubscribers = 16;
+	constexpr uint32 kBroadcastCapacity = 64;
+
+	template<typename T, uint32 kIdx = 0>
+	constexpr uint32 TypeIndex()
+	{
+		static_assert(kIdx < kNumTypes, "not a CommonMsg type");
+		if constexpr (std::is_same_v<T, std::variant_alternative_t<kIdx, Message>>)
+			return kIdx;
+		else
+			return TypeIndex<T, kIdx + 1>();
+	}
+
+	using TypeMask = uint32;
+	template<typename... TMsgs>
+	constexpr TypeMask MaskOf() { return ((TypeMask(1) << TypeIndex<TMsgs>()) | ... | TypeMask(0)); }
+
+	class ISubscriber
+	{
+	public:
+		// Called on the publishing thread, after the message can be read.
+		virtual void OnPublished(uint32 type_index) = 0;
+	protected:
+		~ISubscriber() = default;
+	};
+
+	// Single writer, multi reader ring. Readers keep their own cursors and never write to the ring. The payload is
+	// copied word by word through relaxed atomics and validated with the slot sequence afterwards (seqlock),
+	// so a reader lapped by the writer drops the overwritten messages instead of reading torn ones.
+	template<typename T, uint32 kCapacity>
+	class BroadcastRing
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "broadcast messages are copied word by word");
+		static constexpr uint32 kWords = static_cast<uint32>((sizeof(T) + sizeof(uint64) - 1) / sizeof(uint64));
+
+		struct Slot
+		{
+			std::atomic<uint64> sequence = 0;	// position + 1 of the complete message, 0 while it's written
+			std::atomic<uint64> words[kWords] = {};
+		};
+
+		alignas(kCacheLineSize) std::atomic<uint64> written_ = 0;
+		Slot slots_[kCapacity];
+
+	public:
+		void Write(const T& msg) //single writer
+		{
+			uint64 raw[kWords] = {};
+			memcpy(raw, &msg, sizeof(T));
+			const uint64 pos = written_.load(std::memory_order_relaxed);
+			Slot& slot = slots_[pos % kCapacity];
+			slot.sequence.store(0, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			for (uint32 idx = 0; idx < kWords; idx++)
+			{
+				slot.words[idx].store(raw[idx], std::memory_order_relaxed);
+			}
+			slot.sequence.store(pos + 1, std::memory_order_release);
+			written_.store(pos + 1, std::memory_order_release);
+		}
+
+		uint64 Written() const { return written_.load(std::memory_order_acquire); }
+
+		// Calls func(const T&) for messages in [cursor, written), and moves the cursor past them.
+		template<typename F>
+		uint32 Read(uint64& cursor, F& func) const
+		{
+			uint32 num = 0;
+			const uint64 written = written_.load(std::memory_order_acquire);
+			if ((written - cursor) > kCapacity)
+			{
+				cursor = written - kCapacity; // lapped
+			}
+			while (cursor < written)
+			{
+				const Slot& slot = slots_[cursor % kCapacity];
+				const uint64 sequence = slot.sequence.load(std::memory_order_acquire);
+				uint64 raw[kWords];
+				for (uint32 idx = 0; idx < kWords; idx++)
+				{
+					raw[idx] = slot.words[idx].load(std::memory_order_relaxed);
+				}
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if ((sequence != (cursor + 1)) || (slot.sequence.load(std::memory_order_relaxed) != sequence))
+				{
+					// Overwritten meanwhile, skip to the oldest message that is still there.
+					const uint64 latest = written_.load(std::memory_order_acquire);
+					cursor = std::max(cursor + 1, latest - std::min<uint64>(latest, kCapacity - 1));
+					continue;
+				}
+				T msg;
+				memcpy(&msg, raw, sizeof(T));
+				cursor++;
+				num++;
+				func(static_cast<const T&>(msg));
+			}
+			return num;
+		}
+	};
+
+	template<typename T>
+	class Topic
+	{
+		BroadcastRing<T, kBroadcastCapacity> ring_;
+		std::atomic<ISubscriber*> subscribers_[kMaxSubscribers] = {};
+		std::atomic_flag publishing_;	// serializes publishers, so the ring has a single writer at a time
+
+		void Lock() { while (publishing_.test_and_set(std::memory_order_acquire)) { publishing_.wait(true); } }
+		void Unlock() { publishing_.clear(std::memory_order_release); publishing_.notify_one(); }
+
+	public:
+		static Topic& Get()
+		{
+			static Topic topic;
+			return topic;
+		}
+
+		// Thread safe.
+		void Publish(const T& msg)
+		{
+			Lock();
+			ring_.Write(msg);
+			for (std::atomic<ISubscriber*>& it : subscribers_)
+			{
+				if (ISubscriber* subscriber = it.load(std::memory_order_acquire))
+				{
+					subscriber->OnPublished(TypeIndex<T>());
+				}
+			}
+			Unlock();
+		}
+
+		// Returns the cursor of the first message the subscriber will read.
+		uint64 Subscribe(ISubscriber& subscriber)
+		{
+			for (std::atomic<ISubscriber*>& it : subscribers_)
+			{
+				ISubscriber* expected = nullptr;
+				if (it.compare_exchange_strong(expected, &subscriber))
+					return ring_.Written();
+			}
+			assert(false); // more than kMaxSubscribers subscribers
+			return ring_.Written();
+		}
+
+		// Once it returns, the subscriber is never notified again.
+		void Unsubscribe(ISubscriber& subscriber)
+		{
+			for (std::atomic<ISubscriber*>& it : subscribers_)
+			{
+				ISubscriber* expected = &subscriber;
+				it.compare_exchange_strong(expected, nullptr);
+			}
+			Lock(); // wait for a publish in progress
+			Unlock();
+		}
+
+		template<typename F>
+		uint32 Read(uint64& cursor, F& func) const { return ring_.Read(cursor, func); }
+
+		// Thread safe, doesn't need a subscription.
+		uint64 NumPublished() const { return ring_.Written(); }
+	};
+
+	// Thread safe. Never blocks on subscribers.
+	template<typename T>
+	void Publish(const T& msg)
+	{
+		Topic<T>::Get().Publish(msg);
+	}
+
+	// Read positions of a single subscriber. Subscribe, Unsubscribe and ConsumeAll must not overlap.
+	class Subscription
+	{
+		ISubscriber* subscriber_ = nullptr;
+		TypeMask mask_ = 0;
+		uint64 cursors_[kNumTypes] = {};
+
+		template<typename T, typename F>
+		uint32 ConsumeType(F& func)
+		{
+			if (!(mask_ & MaskOf<T>()))
+				return 0;
+			return Topic<T>::Get().Read(cursors_[TypeIndex<T>()], func);
+		}
+
+		template<typename F, size_t... kIdx>
+		uint32 ConsumeTypes(F& func, std::index_sequence<kIdx...>)
+		{
+			return (ConsumeType<std::variant_alternative_t<kIdx, Message>>(func) + ... + 0);
+		}
+
+		template<size_t... kIdx>
+		void ForEachType(TypeMask mask, auto&& func, std::index_sequence<kIdx...>)
+		{
+			((mask & (TypeMask(1) << kIdx) ? func(Topic<std::variant_alternative_t<kIdx, Message>>::Get(), kIdx) : void()), ...);
+		}
+
+	public:
+		Subscription() = default;
+		Subscription(const Subscription&) = delete;
+		Subscription& operator=(const Subscription&) = delete;
+		~Subscription() { assert(!mask_); }
+
+		void Subscribe(ISubscriber& subscriber, TypeMask mask)
+		{
+			assert(!mask_ && !subscriber_);
+			subscriber_ = &subscriber;
+			mask_ = mask;
+			ForEachType(mask_, [&](auto& topic, size_t idx) { cursors_[idx] = topic.Subscribe(subscriber); },
+				std::make_index_sequence<kNumTypes>());
+		}
+
+		void Unsubscribe()
+		{
+			if (!subscriber_)
+				return;
+			ForEachType(mask_, [&](auto& topic, size_t) { topic.Unsubscribe(*subscriber_); },
+				std::make_index_sequence<kNumTypes>());
+			mask_ = 0;
+			subscriber_ = nullptr;
+		}
+
+		// Calls func(const T&) for every message published since the last call, type by type.
+		template<typename F>
+		uint32 ConsumeAll(F&& func)
+		{
+			return ConsumeTypes(func, std::make_index_sequence<kNumTypes>());
+		}
+	};
+}
@@ -2,7 +2,10 @@
 
 #include<atomic>
 #include<optional>
+#include<span>
 #include<assert.h>
+#include "mpsc_queue.h"
+#include "memory/epoch_reclamation.h"
 
 namespace MessageQueue
 {
@@ -21,9 +24,31 @@ namespace MessageQueue
 	private:
 		alignas(T) std::byte data[sizeof(T)];
 	public:
-		TNode<T>* next = nullptr;
+		// Atomic, because a losing TLockFreeStack::Pop may still read it, while the winner already reuses the node.
+		std::atomic<TNode<T>*> next = nullptr;
 	};
 
+	// Pointer and a generation counter packed into a single word. The counter changes on every successful CAS,
+	// so a head that was popped and pushed back in the meantime no longer compares equal (ABA).
+	struct TaggedPtr
+	{
+		static_assert(sizeof(void*) == sizeof(uint64_t), "48 bit user space pointers are assumed");
+		static constexpr uint64_t kPtrBits = 48;
+		static constexpr uint64_t kPtrMask = (uint64_t(1) << kPtrBits) - 1;
+
+		static uint64_t Pack(const void* ptr, uint64_t tag)
+		{
+			const uint64_t address = reinterpret_cast<uint64_t>(ptr);
+			assert(!(address & ~kPtrMask));
+			return address | (tag << kPtrBits);
+		}
+
+		template<typename N>
+		static N* Ptr(uint64_t packed) { return reinterpret_cast<N*>(packed & kPtrMask); }
+		static uint64_t Tag(uint64_t packed) { return packed >> kPtrBits; }
+	};
+
+	// Nodes popped here may be freed only through Reclamation::Retire, see TMemoryPool::Trim.
 	template<typename T>
 	struct TLockFreeStack
 	{
@@ -31,30 +56,40 @@ namespace MessageQueue
 
 		void Push(Node& new_node)
 		{
-			new_node.next = head.load(std::memory_order_relaxed);
-
-			while (!head.compare_exchange_weak(new_node.next, &new_node,
+			uint64_t old_head = head.load(std::memory_order_relaxed);
+			uint64_t new_head = 0;
+			do
+			{
+				new_node.next.store(TaggedPtr::Ptr<Node>(old_head), std::memory_order_relaxed);
+				new_head = TaggedPtr::Pack(&new_node, TaggedPtr::Tag(old_head) + 1);
+			} while (!head.compare_exchange_weak(old_head, new_head,
 				std::memory_order_release,
-				std::memory_order_relaxed))
-				;
+				std::memory_order_relaxed));
 		}
 
 		Node* Pop()
 		{
-			Node* top = head.load(std::memory_order_relaxed);
+			Reclamation::Guard guard;
+			uint64_t old_head = head.load(std::memory_order_acquire);
+			uint64_t new_head = 0;
+			Node* top = nullptr;
 			do
 			{
+				top = TaggedPtr::Ptr<Node>(old_head);
 				if (!top)
 				{
 					return nullptr;
 				}
-			} while (!head.compare_exchange_weak(top, top->next));
-			top->next = nullptr;
+				new_head = TaggedPtr::Pack(top->next.load(std::memory_order_relaxed), TaggedPtr::Tag(old_head) + 1);
+			} while (!head.compare_exchange_weak(old_head, new_head,
+				std::memory_order_acquire,
+				std::memory_order_acquire));
+			top->next.store(nullptr, std::memory_order_relaxed);
 			return top;
 		}
 
 	private:
-		std::atomic<Node*> head = nullptr;
+		std::atomic<uint64_t> head = 0;
 	};
 
 	template<typename T>
@@ -65,6 +100,8 @@ namespace MessageQueue
 		Node* last_ = nullptr; //Add here
 	};
 
+	// Multi producer, single consumer. Producers push onto a single word head; the consumer detaches everything
+	// at once. There is no single item Pop, so the head never moves back and ABA cannot happen.
 	template<typename T>
 	struct TLockFreeQueue
 	{
@@ -72,46 +109,27 @@ namespace MessageQueue
 
 		void Enqueue(Node& new_node)
 		{
-			//assert(state_.is_lock_free());
-			TQueueState<T> state = state_.load(std::memory_order_relaxed);
-			TQueueState<T> new_state;
-
+			Node* last = last_.load(std::memory_order_relaxed);
 			do
 			{
-				new_state.last_ = &new_node;
-				new_state.first_ = state.first_ ? state.first_ : &new_node;
-				new_node.next = state.last_;
-			} while (!state_.compare_exchange_weak(state, new_state));
+				new_node.next.store(last, std::memory_order_relaxed);
+			} while (!last_.compare_exchange_weak(last, &new_node,
+				std::memory_order_release,
+				std::memory_order_relaxed));
 		}
 
-		Node* Pop()
+		// Returns the newest node, linked through next towards the oldest one.
+		Node* TakeAll()
 		{
-			TQueueState<T> state = state_.load(std::memory_order_relaxed);
-			TQueueState<T> new_state;
-
-			do
+			if (!last_.load(std::memory_order_relaxed))
 			{
-				if (!state.first_)
-				{
-					return nullptr;
-				}
-				new_state.first_ = state.first_->next;
-				new_state.last_ = (state.last_ == state.first_) ? nullptr : state.last_;
-			} while (!state_.compare_exchange_weak(state, new_state));
-			state.first_->next = nullptr;
-			return state.first_;
-		}
-
-		TQueueState<T> TakeAll()
-		{
-			TQueueState<T> state = state_.load(std::memory_order_relaxed);
-			while (!state_.compare_exchange_weak(state, TQueueState<T>{}))
-				;
-			return state;
+				return nullptr;
+			}
+			return last_.exchange(nullptr, std::memory_order_acquire);
 		}
 
 	private:
-		std::atomic<TQueueState<T>> state_;
+		std::atomic<Node*> last_ = nullptr;
 	};
 
 	template<typename T>
@@ -126,24 +144,8 @@ namespace MessageQueue
 			size_t all_pool_elements = all_pool_elements_;
 			assert(free_elements_num_ == all_pool_elements);
 			assert(!preallocated_array_ == !preallocated_size_);
-			if (preallocated_array_)
-			{
-				delete[] preallocated_array_;
-				all_pool_elements -= preallocated_size_;
-			}
-
-			if (!all_pool_elements)
-			{
-				return;
-			}
-
-			auto IsPreallocated = [&](Node* node) -> bool
-			{
-				return preallocated_array_ 
-					&& (node >= preallocated_array_) 
-					&& (node < (preallocated_array_ + preallocated_size_));
-			};
 
+			// Popping reads next from every node, so the preallocated array can go only after the stack is empty.
 			while (Node* node = free_elements_.Pop())
 			{
 				if (!IsPreallocated(node))
@@ -153,6 +155,11 @@ namespace MessageQueue
 				}
 			}
 
+			if (preallocated_array_)
+			{
+				delete[] preallocated_array_;
+				all_pool_elements -= preallocated_size_;
+			}
 			assert(!all_pool_elements);
 		}
 
@@ -183,6 +190,44 @@ namespace MessageQueue
 			free_elements_num_++;
 		}
 
+		// Frees nodes allocated on demand, until at most max_free nodes are left. A concurrent Pop may still
+		// read a node taken here, so the nodes are retired rather than deleted.
+		void Trim(const size_t max_free)
+		{
+			if (free_elements_num_.load(std::memory_order_relaxed) <= max_free)
+				return;
+
+			Node* preallocated = nullptr;
+			while (free_elements_num_.load(std::memory_order_relaxed) > max_free)
+			{
+				Node* node = free_elements_.Pop();
+				if (!node)
+					break;
+				free_elements_num_--;
+				if (IsPreallocated(node))
+				{
+					node->next.store(preallocated, std::memory_order_relaxed);
+					preallocated = node;
+					continue;
+				}
+				all_pool_elements_--;
+				Reclamation::Retire(node);
+			}
+
+			while (preallocated)
+			{
+				Node* next = preallocated->next.load(std::memory_order_relaxed);
+				Take(*preallocated);
+				preallocated = next;
+			}
+			Reclamation::Collect();
+		}
+
+		size_t GetNumOfAll() const
+		{
+			return all_pool_elements_.load(std::memory_order_relaxed);
+		}
+
 		size_t GetNumOfUsed() const
 		{
 			return all_pool_elements_.load(std::memory_order_relaxed)
@@ -190,6 +235,13 @@ namespace MessageQueue
 		}
 
 	private:
+		bool IsPreallocated(const Node* node) const
+		{
+			return preallocated_array_ 
+				&& (node >= preallocated_array_) 
+				&& (node < (preallocated_array_ + preallocated_size_));
+		}
+
 		Node* IncreasePool(const size_t delta = 1)
 		{
 			if (!delta)
@@ -225,12 +277,7 @@ struct TMessageQueue
 
 	~TMessageQueue()
 	{
-		while (Node * node = messages_.Pop())
-		{
-			T& node_data = node->GetCasted();
-			node_data.~T();
-			memory_pool_.Take(*node);
-		}
+		ConsumeAll([](T&) {});
 	}
 
 	void Preallocate(const size_t num)
@@ -238,34 +285,106 @@ struct TMessageQueue
 		memory_pool_.Preallocate(num);
 	}
 
+	// Releases pool nodes above max_free, after a burst.
+	void Trim(const size_t max_free)
+	{
+		memory_pool_.Trim(max_free);
+	}
+
 	std::optional<T> Pop()
 	{
-		if (Node* node = messages_.Pop())
+		std::optional<T> result;
+		ConsumeAll([&](T& msg) -> bool
+		{
+			result.emplace(std::move(msg));
+			return false;
+		});
+		return result;
+	}
+
+	// Nodes owned by the pool.
+	uint32_t NumAllocated() const { return static_cast<uint32_t>(memory_pool_.GetNumOfAll()); }
+
+	uint32_t Num() const { return static_cast<uint32_t>(memory_pool_.GetNumOfUsed()); }
+
+	void Enqueue(T&& msg)
+	{
+		Emplace(std::move(msg));
+	}
+
+	// Constructs the message directly in the pooled node.
+	template<typename... Args>
+	void Emplace(Args&&... args)
+	{
+		Node& node = memory_pool_.Give();
+		assert(memory_pool_.GetNumOfUsed());
+		new(node.GetRaw()) T(std::forward<Args>(args)...);
+		messages_.Enqueue(node);
+	}
+
+	// Visits messages in place, oldest first. The backlog is detached from the shared queue at once,
+	// messages not visited when func returns false are kept in pending_ for the next call. Consumer thread only.
+	template<typename F>
+	uint32_t ConsumeAll(F&& func)
+	{
+		if (!pending_.first_)
 		{
+			ClaimPending();
+		}
+
+		uint32_t consumed = 0;
+		while (Node* node = pending_.first_)
+		{
+			pending_.first_ = node->next.load(std::memory_order_relaxed);
+			if (!pending_.first_)
+			{
+				pending_.last_ = nullptr;
+			}
+			node->next.store(nullptr, std::memory_order_relaxed);
+
 			assert(memory_pool_.GetNumOfUsed());
 			T& node_data = node->GetCasted();
-			T msg = std::move(node_data);
+			const bool proceed = VisitQueueItem(func, node_data);
 			node_data.~T();
-			
 			memory_pool_.Take(*node);
-			return msg;
+			consumed++;
+			if (!proceed)
+				break;
 		}
-		return {};
+		return consumed;
 	}
 
-	void Enqueue(T&& msg)
+	uint32_t DrainInto(std::span<T> out) //consumer thread
 	{
-		Node& node = memory_pool_.Give();
-		assert(memory_pool_.GetNumOfUsed());
-		new(node.GetRaw()) T(std::forward<T>(msg));
-		messages_.Enqueue(node);
+		uint32_t num = 0;
+		if (out.empty())
+			return num;
+		ConsumeAll([&](T& msg) -> bool
+		{
+			out[num++] = std::move(msg);
+			return num < out.size();
+		});
+		return num;
 	}
 
 private:
+	void ClaimPending()
+	{
+		// Taken chain is linked from the newest node, reverse it so it can be consumed from the oldest one.
+		Node* const newest = messages_.TakeAll();
+		Node* oldest = nullptr;
+		for (Node* it = newest; it;)
+		{
+			Node* const next = it->next.load(std::memory_order_relaxed);
+			it->next.store(oldest, std::memory_order_relaxed);
+			oldest = it;
+			it = next;
+		}
+		pending_.first_ = oldest;
+		pending_.last_ = newest;
+	}
+
 	MessageQueue::TLockFreeQueue<T> messages_;
 	MessageQueue::TMemoryPool<T> memory_pool_;
-	//TQueueState pending_;
+	MessageQueue::TQueueState<T> pending_; //consumer only, already taken from messages_
 };
-
-
-
@@ -2,8 +2,26 @@
 
 #include<atomic>
 #include<optional>
+#include<span>
+#include<type_traits>
+#include<new>
 #include<assert.h>
 
+// Batch consumers accept a visitor returning either void, or bool - false stops the drain after the current item.
+template<typename F, typename T>
+bool VisitQueueItem(F& func, T& item)
+{
+	if constexpr (std::is_void_v<std::invoke_result_t<F&, T&>>)
+	{
+		func(item);
+		return true;
+	}
+	else
+	{
+		return static_cast<bool>(func(item));
+	}
+}
+
 template<typename T, uint32_t kSize> 
 class LockFreeQueue_SingleConsumer
 {
@@ -14,9 +32,12 @@ class LockFreeQueue_SingleConsumer
 
 	struct Block
 	{
-		T data[kSize];
+		// Raw storage, items are constructed by Emplace and destroyed by the consumer.
+		alignas(T) std::byte data[kSize][sizeof(T)];
 		std::atomic_bool written[kSize] = { false };
 		Block* next = nullptr;
+
+		T& Item(uint32_t index) { return *std::launder(reinterpret_cast<T*>(data[index])); }
 	};
 
 	struct alignas(8) State
@@ -30,6 +51,19 @@ class LockFreeQueue_SingleConsumer
 	};
 	std::atomic<State> state_;
 	std::atomic<Block*> free_list_head_ = nullptr;;
+	std::atomic<uint32_t> allocated_blocks_ = 0;
+
+	// Backlog detached from state_ by ConsumeAll, touched only by the consumer.
+	// Blocks are linked oldest first, items inside a block are read from the higher index down.
+	struct Claimed
+	{
+		Block* block = nullptr;
+		uint32_t index = 0;
+		uint32_t count = 0;
+	};
+	Claimed claimed_;
+	// Set while the consumer sleeps in WaitUntilWritten, so producers only notify then.
+	std::atomic_bool consumer_waiting_ = false;
 
 	void MoveToFreeList(Block* block)
 	{
@@ -76,10 +110,109 @@ class LockFreeQueue_SingleConsumer
 		return local_head;
 	}
 
+	void WaitUntilWritten(const std::atomic_bool& written)
+	{
+		// The producer has already reserved the slot, usually it's a matter of a few instructions. Spin shortly, then sleep.
+		for (uint32_t spin = 0; spin < 64; spin++)
+		{
+			if (written.load(std::memory_order_acquire))
+				return;
+		}
+		// Pairs with the written store and the consumer_waiting_ load in Emplace: either the producer sees the flag, or
+		// the consumer sees the item.
+		consumer_waiting_.store(true);
+		if (!written.load())
+		{
+			written.wait(false, std::memory_order_acquire);
+		}
+		consumer_waiting_.store(false);
+	}
+
 	Block* GetOrAllocateFreeBlock()
 	{
 		Block* block = GetBlockFromFreeList();
-		return block ? block : new Block();
+		return block ? block : AllocateBlock();
+	}
+
+	Block* AllocateBlock()
+	{
+		allocated_blocks_.fetch_add(1, std::memory_order_relaxed);
+		return new Block();
+	}
+
+	bool Claim()
+	{
+		assert(!claimed_.count && !claimed_.block);
+		if (!state_.load().count)
+			return false;
+
+		// A single exchange detaches the whole backlog, producers start a fresh chain.
+		const State prev_state = state_.exchange(State{});
+		Block* oldest = nullptr;
+		uint32_t num_blocks = 0;
+		for (Block* it = prev_state.head; it; num_blocks++)
+		{
+			Block* const next = it->next;
+			it->next = oldest;
+			oldest = it;
+			it = next;
+		}
+
+		const uint32_t consecutive_index = prev_state.first + prev_state.count - 1;
+		const uint32_t needed_blocks = prev_state.count ? (consecutive_index / kSize + 1) : 0;
+		assert(num_blocks >= needed_blocks);
+		for (; num_blocks > needed_blocks; num_blocks--)
+		{
+			Block* const unused = oldest;
+			oldest = oldest->next;
+			unused->next = nullptr;
+			MoveToFreeList(unused);
+		}
+
+		if (!prev_state.count)
+			return false;
+		claimed_ = { oldest, consecutive_index % kSize, prev_state.count };
+		return true;
+	}
+
+	template<typename F>
+	uint32_t ConsumeClaimed(F& func)
+	{
+		uint32_t consumed = 0;
+		while (claimed_.count)
+		{
+			Block* const block = claimed_.block;
+			const uint32_t index_in_block = claimed_.index;
+			assert(block && (index_in_block < kSize));
+			WaitUntilWritten(block->written[index_in_block]);
+			T& item = block->Item(index_in_block);
+			const bool proceed = VisitQueueItem(func, item);
+			item.~T();
+#ifdef NDEBUG
+			block->written[index_in_block] = false;
+#else
+			const bool bWasOccupied = block->written[index_in_block].exchange(false);
+			assert(bWasOccupied);
+#endif
+			consumed++;
+			claimed_.count--;
+			if (!index_in_block || !claimed_.count)
+			{
+				assert(claimed_.count || !block->next);
+				claimed_.block = block->next;
+				claimed_.index = kSize - 1;
+				block->next = nullptr;
+				MoveToFreeList(block);
+			}
+			else
+			{
+				claimed_.index--;
+			}
+
+			if (!proceed)
+				break;
+		}
+		return consumed;
 	}
 
 public:
@@ -87,11 +220,20 @@ public:
 	{
 		for (uint32_t i = 0; i < initial_blocks; i++)
 		{
-			MoveToFreeList(new Block());
+			MoveToFreeList(AllocateBlock());
 		}
 	}
 	~LockFreeQueue_SingleConsumer()
 	{
+		while (ConsumeAll([](T&) {})) {}
+
+		for (Block* it = claimed_.block; it;)
+		{
+			Block* to_delete = it;
+			it = it->next;
+			delete to_delete;
+		}
+
 		for (Block* it = state_.load().head; it;)
 		{
 			Block* to_delete = it;
@@ -108,6 +250,13 @@ public:
 	}
 
 	void Enqueue(T&& item)
+	{
+		Emplace(std::move(item));
+	}
+
+	// Constructs the item directly in the slot.
+	template<typename... Args>
+	void Emplace(Args&&... args)
 	{
 		uint16_t local_first = 0;
 		Block* local_head = nullptr;
@@ -146,7 +295,7 @@ public:
 				};
 			} while (!state_.compare_exchange_weak(prev_state, next_state));
 		}
-		local_head->data[local_first] = std::forward<T>(item);
+		new (local_head->data[local_first]) T(std::forward<Args>(args)...);
 #ifdef NDEBUG
 		local_head->written[local_first] = true;
 #else
@@ -154,10 +303,22 @@ public:
 		const bool bWasOccupied = local_head->written[local_first].exchange(true);
 		assert(!bWasOccupied);
 #endif
+		if (consumer_waiting_.load())
+		{
+			local_head->written[local_first].notify_one();
+		}
 	}
 
 	std::optional<T> Pop() //This must be always called from the same thread
 	{
+		if (claimed_.count)
+		{
+			std::optional<T> result;
+			auto take_one = [&](T& item) -> bool { result.emplace(std::move(item)); return false; };
+			ConsumeClaimed(take_one);
+			return result;
+		}
+
 		State prev_state = state_;
 		if (!prev_state.count) 
 			return {};
@@ -197,8 +358,10 @@ public:
 		}
 		assert(block);
 		assert(index_in_block < kSize);
-		while (!block->written[index_in_block]) {} //wait for producer to finish writing. TODO: make it atomic_wait
-		std::optional<T> result(std::move(block->data[index_in_block])); //Add api to call a lambda here, to avoid moving ?
+		WaitUntilWritten(block->written[index_in_block]);
+		T& item = block->Item(index_in_block);
+		std::optional<T> result(std::move(item)); //ConsumeAll visits in place
+		item.~T();
 		
 #ifdef NDEBUG
 		block->written[index_in_block] = false;
@@ -232,13 +395,43 @@ public:
 		return result;
 	}
 
+	// Visits the backlog in place, oldest first. Everything enqueued so far is claimed with a single exchange,
+	// so the producers are not contended per item. When func returns false, the not visited part of the
+	// claimed batch stays at the front of the queue. This must be always called from the consumer thread.
+	template<typename F>
+	uint32_t ConsumeAll(F&& func)
+	{
+		if (!claimed_.count && !Claim())
+			return 0;
+		return ConsumeClaimed(func);
+	}
+
+	uint32_t DrainInto(std::span<T> out) //consumer thread
+	{
+		uint32_t num = 0;
+		if (out.empty())
+			return num;
+		ConsumeAll([&](T& item) -> bool
+		{
+			out[num++] = std::move(item);
+			return num < out.size();
+		});
+		return num;
+	}
+
+	// Items not claimed yet by the consumer.
 	uint32_t Num() const { return state_.load().count; }
+	// Items claimed by ConsumeAll, but not visited yet. Consumer thread only.
+	uint32_t NumClaimed() const { return claimed_.count; }
+	// Blocks owned by the queue, including the free list.
+	uint32_t NumAllocated() const { return allocated_blocks_.load(std::memory_order_relaxed); }
 
 	void ClearFreeList()
 	{
 		for (Block* block = GetBlockFromFreeList(); block; block = GetBlockFromFreeList())
 		{
 			delete block;
+			allocated_blocks_.fetch_sub(1, std::memory_order_relaxed);
 		}
 	}
 };
@@ -0,0 +1,184 @@
+#pragma once
+
+#include<atomic>
+#include<optional>
+#include<new>
+#include<span>
+#include<assert.h>
+#include "common/base_types.h"
+#include "mpsc_queue.h"
+
+// Bounded multi producer, single consumer ring. Each slot carries a sequence number, so both
+// Enqueue and Pop touch a single slot. When the ring is full, producers spill into a growable
+// block queue. While anything is pending there, all producers keep using it, so FIFO order
+// is preserved per producer.
+template<typename T, uint32_t kCapacity, uint32_t kOverflowBlockSize = 32>
+class RingQueue_SingleConsumer
+{
+	static_assert((kCapacity >= 2) && !(kCapacity & (kCapacity - 1)), "capacity must be a power of two");
+	static constexpr uint64_t kMask = kCapacity - 1;
+
+	RingQueue_SingleConsumer(const RingQueue_SingleConsumer&) = delete;
+	RingQueue_SingleConsumer& operator=(const RingQueue_SingleConsumer&) = delete;
+	RingQueue_SingleConsumer(const RingQueue_SingleConsumer&&) = delete;
+	RingQueue_SingleConsumer& operator=(const RingQueue_SingleConsumer&&) = delete;
+
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence = 0;
+		alignas(T) std::byte data[sizeof(T)];
+
+		T& Get() { return *std::launder(reinterpret_cast<T*>(data)); }
+	};
+
+	alignas(kCacheLineSize) std::atomic<uint64_t> tail_ = 0;		// producers
+	alignas(kCacheLineSize) std::atomic<uint64_t> head_ = 0;		// written only by the consumer
+	alignas(kCacheLineSize) std::atomic<uint32_t> overflow_num_ = 0;
+	alignas(kCacheLineSize) Slot slots_[kCapacity];
+	LockFreeQueue_SingleConsumer<T, kOverflowBlockSize> overflow_;
+
+	// The item is constructed only when a slot was taken, otherwise args are left untouched.
+	template<typename... Args>
+	bool TryEmplaceRing(Args&&... args)
+	{
+		uint64_t pos = tail_.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = slots_[pos & kMask];
+			const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const int64_t diff = static_cast<int64_t>(sequence - pos);
+			if (!diff)
+			{
+				if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					new (slot.data) T(std::forward<Args>(args)...);
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) //full
+			{
+				return false;
+			}
+			else
+			{
+				pos = tail_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+public:
+	RingQueue_SingleConsumer()
+		: overflow_(0)
+	{
+		for (uint32_t idx = 0; idx < kCapacity; idx++)
+		{
+			slots_[idx].sequence.store(idx, std::memory_order_relaxed);
+		}
+	}
+
+	~RingQueue_SingleConsumer()
+	{
+		while (Pop()) {}
+	}
+
+	void Enqueue(T&& item)
+	{
+		Emplace(std::move(item));
+	}
+
+	template<typename... Args>
+	void Emplace(Args&&... args)
+	{
+		if (!overflow_num_.load(std::memory_order_acquire) && TryEmplaceRing(std::forward<Args>(args)...))
+			return;
+		overflow_num_.fetch_add(1);
+		overflow_.Emplace(std::forward<Args>(args)...);
+	}
+
+	std::optional<T> Pop() //This must be always called from the same thread
+	{
+		std::optional<T> result;
+		const uint64_t pos = head_.load(std::memory_order_relaxed);
+		Slot& slot = slots_[pos & kMask];
+		if (slot.sequence.load(std::memory_order_acquire) == (pos + 1))
+		{
+			T& item = slot.Get();
+			result.emplace(std::move(item));
+			item.~T();
+			slot.sequence.store(pos + kCapacity, std::memory_order_release);
+			head_.store(pos + 1, std::memory_order_relaxed);
+			return result;
+		}
+
+		// Spilled items are newer than everything claimed in the ring, so the ring must be drained first.
+		if (overflow_num_.load(std::memory_order_acquire) && (pos == tail_.load(std::memory_order_acquire)))
+		{
+			result = overflow_.Pop();
+			if (result)
+			{
+				overflow_num_.fetch_sub(1, std::memory_order_release);
+			}
+		}
+		return result;
+	}
+
+	// Visits ready slots in place, oldest first, then the spilled items once the ring is drained.
+	// When func returns false the drain stops after the current item. Consumer thread only.
+	template<typename F>
+	uint32_t ConsumeAll(F&& func)
+	{
+		uint32_t consumed = 0;
+		const uint64_t tail = tail_.load(std::memory_order_acquire);
+		uint64_t pos = head_.load(std::memory_order_relaxed);
+		for (; pos != tail; pos++)
+		{
+			Slot& slot = slots_[pos & kMask];
+			if (slot.sequence.load(std::memory_order_acquire) != (pos + 1))
+				return consumed; //still being written
+			T& item = slot.Get();
+			const bool proceed = VisitQueueItem(func, item);
+			item.~T();
+			slot.sequence.store(pos + kCapacity, std::memory_order_release);
+			head_.store(pos + 1, std::memory_order_relaxed);
+			consumed++;
+			if (!proceed)
+				return consumed;
+		}
+
+		if (overflow_num_.load(std::memory_order_acquire) && (pos == tail_.load(std::memory_order_acquire)))
+		{
+			consumed += overflow_.ConsumeAll([&](T& item) -> bool
+			{
+				const bool proceed = VisitQueueItem(func, item);
+				overflow_num_.fetch_sub(1, std::memory_order_release);
+				return proceed;
+			});
+		}
+		return consumed;
+	}
+
+	uint32_t DrainInto(std::span<T> out) //consumer thread
+	{
+		uint32_t num = 0;
+		if (out.empty())
+			return num;
+		ConsumeAll([&](T& item) -> bool
+		{
+			out[num++] = std::move(item);
+			return num < out.size();
+		});
+		return num;
+	}
+
+	uint32_t Num() const 
+	{ 
+		const uint64_t in_ring = tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed);
+		return static_cast<uint32_t>(in_ring) + overflow_num_.load(std::memory_order_relaxed);
+	}
+
+	// Overflow blocks, the ring itself is never reallocated.
+	uint32_t NumAllocated() const { return overflow_.NumAllocated(); }
+
+	void ClearFreeList() { overflow_.ClearFreeList(); }
+};
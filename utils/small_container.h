@@ -3,7 +3,12 @@
 #include <atomic>
 #include <array>
 #include <algorithm>
-#include "third_party/bitset2/bitset2.hpp" 
+#include <vector>
+#include <optional>
+#include <memory>
+#include <type_traits>
+#include <cstring>
+#include "hierarchical_bitmap.h"
 #include "common/base_types.h"
 
 template<typename T>
@@ -37,6 +42,60 @@ public:
 			auto	end()					{ return buffers_.end(); }
 };
 
+// N buffers used round-robin by a producer, while a consumer may still read the previously published ones. Every
+// slot keeps the token of its pending retirement (e.g. a frame id, or a future of a fence value). The producer
+// waits only when it advances to a slot that is still in flight, so with N > 2 it normally doesn't wait at all.
+template<typename T, uint32_t N, typename TToken>
+class RingBuffered
+{
+	static_assert(N >= 2, "use a single buffer");
+
+	std::array<T, N> buffers_;
+	std::array<std::optional<TToken>, N> retire_tokens_;
+	uint32_t active_ = 0;
+
+public:
+	uint32_t		GetActiveIndex()			const	{ return active_; }
+			T&		GetActive()							{ return buffers_[active_]; }
+	const	T&		GetActive()					const	{ return buffers_[active_]; }
+
+	// The slot is in flight until the token is reached. Replaces the previous token of the slot.
+	void SetRetireToken(uint32_t idx, TToken&& token)
+	{
+		assert(idx < N);
+		retire_tokens_[idx].emplace(std::move(token));
+	}
+
+	bool IsInFlight(uint32_t idx) const { assert(idx < N); return retire_tokens_[idx].has_value(); }
+
+	// Makes the next slot active. When it's still in flight, wait(TToken&) must block until the token is reached.
+	template<typename F>
+	T& Advance(F&& wait)
+	{
+		active_ = (active_ + 1) % N;
+		if (std::optional<TToken>& token = retire_tokens_[active_])
+		{
+			wait(*token);
+			token.reset();
+		}
+		return buffers_[active_];
+	}
+
+	// Forgets all pending tokens, e.g. once the consumer is known to be idle.
+	void RetireAll()
+	{
+		for (std::optional<TToken>& token : retire_tokens_)
+		{
+			token.reset();
+		}
+	}
+
+	const	auto	begin()			const	{ return buffers_.begin(); }
+			auto	begin()					{ return buffers_.begin(); }
+	const	auto	end()			const	{ return buffers_.end(); }
+			auto	end()					{ return buffers_.end(); }
+};
+
 template<typename T> void RemoveSwap(std::vector<T>& vec, std::size_t idx)
 {
 	assert(vec.size() > idx);
@@ -48,10 +107,33 @@ template<typename T> void RemoveSwap(std::vector<T>& vec, std::size_t idx)
 	vec.pop_back();
 }
 
-template<typename T, uint32_t kMinInlineCapacity = 1>
+// Types that can be moved to new memory with memcpy, leaving nothing to destroy at the old place. Specialize it
+// for types that are relocatable but not trivially copyable (e.g. a type holding only owning pointers).
+template<typename T>
+struct is_trivially_relocatable : std::bool_constant<std::is_trivially_move_constructible_v<T> && std::is_trivially_destructible_v<T>> {};
+template<typename T>
+constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+// Growth policies of small_container: next_capacity(current) returns the capacity to grow to, when it's full.
+struct GrowDouble
+{
+	static constexpr std::size_t next_capacity(std::size_t current) { return std::max<std::size_t>(2 * current, 16); }
+};
+
+template<uint32_t kStep>
+struct GrowLinear
+{
+	static_assert(kStep > 0, "wrong step");
+	static constexpr std::size_t next_capacity(std::size_t current) { return current + kStep; }
+};
+
+// TAllocator is rebound to the raw element storage, so an arena (e.g. std::pmr::polymorphic_allocator) can back
+// the heap allocation.
+template<typename T, uint32_t kMinInlineCapacity = 1, typename TGrowth = GrowDouble, typename TAllocator = std::allocator<T>>
 class small_container
 {
 	using RawData = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+	using RawAllocator = typename std::allocator_traits<TAllocator>::template rebind_alloc<RawData>;
 
 public:
 	static constexpr uint32_t kInlineCapacity = std::max<uint32_t>(sizeof(RawData*) / sizeof(T), kMinInlineCapacity);
@@ -65,6 +147,7 @@ private:
 	} data_;
 	uint32_t num_ = 0;
 	uint32_t allocation_size_ = 0;
+	NO_UNIQUE_ADDRESS RawAllocator allocator_;
 
 	const	RawData*	get_mem()					const	{ return allocation_size_ ? data_.allocation_ : data_.inline_; }
 			RawData*	get_mem()							{ return allocation_size_ ? data_.allocation_ : data_.inline_; }
@@ -72,6 +155,26 @@ private:
 			T*			get_ptr(std::size_t pos)			{ return reinterpret_cast<		T*>(get_mem() + pos); }
 	std::size_t			max_size()					const	{ return allocation_size_ ? allocation_size_ : kInlineCapacity; }
 
+	void relocate(RawData* dst, RawData* src)
+	{
+		if constexpr (is_trivially_relocatable_v<T>)
+		{
+			if (num_)
+			{
+				memcpy(dst, src, num_ * sizeof(T));
+			}
+		}
+		else
+		{
+			for (std::size_t idx = 0; idx < num_; idx++)
+			{
+				T* const ptr = reinterpret_cast<T*>(src + idx);
+				new (dst + idx) T(std::move(*ptr));
+				ptr->~T();
+			}
+		}
+	}
+
 	void resize_allocation(std::size_t new_capacity)
 	{
 		assert(new_capacity >= num_);
@@ -79,17 +182,12 @@ private:
 		if (inline_alloc && !allocation_size_)
 			return;
 		RawData* const old_mem = get_mem();
-		RawData* const new_allocation = inline_alloc ? data_.inline_ : new RawData[new_capacity];
-		auto get_old_ptr = [old_mem](std::size_t idx) -> T* { return reinterpret_cast<T*>(old_mem + idx); };
-		for (std::size_t idx = 0; idx < num_; idx++)
-		{
-			T* const ptr = get_old_ptr(idx);
-			new (new_allocation + idx) T(std::move(*ptr));
-			ptr->~T();
-		}
-		if (allocation_size_)
+		const uint32_t old_allocation_size = allocation_size_;
+		RawData* const new_allocation = inline_alloc ? data_.inline_ : std::allocator_traits<RawAllocator>::allocate(allocator_, new_capacity);
+		relocate(new_allocation, old_mem);
+		if (old_allocation_size)
 		{
-			delete old_mem;
+			std::allocator_traits<RawAllocator>::deallocate(allocator_, old_mem, old_allocation_size);
 		}
 		if (!inline_alloc)
 		{
@@ -104,12 +202,62 @@ private:
 		assert(current_capacity >= num_);
 		if (current_capacity == num_)
 		{
-			resize_allocation(std::max<std::size_t>(2 * current_capacity, 16));
+			const std::size_t new_capacity = TGrowth::next_capacity(current_capacity);
+			assert(new_capacity > current_capacity);
+			resize_allocation(new_capacity);
 		}
 		return get_mem() + num_++;
 	}
 
+	// Takes the heap allocation of other, when it can be freed with allocator_, otherwise relocates the elements.
+	// Leaves other empty.
+	void take(small_container& other)
+	{
+		assert(!num_ && !allocation_size_);
+		if (other.allocation_size_ && (allocator_ == other.allocator_))
+		{
+			data_.allocation_ = other.data_.allocation_;
+			allocation_size_ = other.allocation_size_;
+			num_ = other.num_;
+			other.allocation_size_ = 0;
+			other.num_ = 0;
+			return;
+		}
+		reserve(other.num_);
+		num_ = other.num_;
+		relocate(get_mem(), other.get_mem());
+		other.num_ = 0;
+		other.resize_allocation(0);
+	}
+
 public:
+	small_container() = default;
+	explicit small_container(const TAllocator& allocator) : allocator_(allocator) {}
+	small_container(const small_container&) = delete;
+	small_container& operator=(const small_container&) = delete;
+
+	small_container(small_container&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+		: allocator_(other.allocator_)
+	{
+		take(other);
+	}
+
+	// The allocator follows the elements only when it propagates on move assignment, like in std containers.
+	small_container& operator=(small_container&& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			resize_allocation(0);
+			if constexpr (std::allocator_traits<RawAllocator>::propagate_on_container_move_assignment::value)
+			{
+				allocator_ = std::move(other.allocator_);
+			}
+			take(other);
+		}
+		return *this;
+	}
+
 	const	T&			operator[](std::size_t pos)	const	{ assert(num_ > pos); return *get_ptr(pos); }
 			T&			operator[](std::size_t pos)			{ assert(num_ > pos); return *get_ptr(pos); }
 	const	T*			begin()						const	{ return get_ptr(0); }
@@ -184,36 +332,84 @@ public:
 	~small_container() { reset(); resize_allocation(0); }
 };
 
+// 32-bit reference to a preallocated_container slot: 16-bit index and 16-bit generation. The generation of a slot
+// is bumped whenever it's freed, so a handle to a freed (or reused) slot is detected on lookup.
+struct SlotHandle
+{
+	static constexpr uint32 kIndexBits = 16;
+	static constexpr uint32 kIndexMask = (uint32(1) << kIndexBits) - 1;
+	static constexpr uint32 kInvalidGeneration = 0xFFFF;	// never used by a slot, so ~0 is never a valid handle
+
+	uint32 value = ~uint32(0);
+
+	SlotHandle() = default;
+	SlotHandle(uint32 index, uint32 generation) : value((generation << kIndexBits) | index)
+	{
+		assert((index <= kIndexMask) && (generation < kInvalidGeneration));
+	}
+
+	uint32 Index() const { return value & kIndexMask; }
+	uint32 Generation() const { return value >> kIndexBits; }
+	bool IsValid() const { return Generation() != kInvalidGeneration; }
+
+	bool operator==(const SlotHandle&) const = default;
+};
+
+// Fixed capacity storage with stable addresses. Free slots are tracked in a concurrent hierarchical bitmap
+// (bit set = free), so safe_allocate and safe_free are lock-free, and a search skips whole taken words through
+// the summary. allocate returns the lowest free slot, safe_allocate starts the search at a per-thread hint to keep
+// allocating threads on different words.
 template<class T, int N>
 struct preallocated_container
 {
 	using RawData = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+	using Bitmap = AtomicHierarchicalBitmap<N>;
+	static constexpr std::size_t npos = Bitmap::npos;
 
 private:
-	Bitset2::bitset2<N> free_;
-	std::array<RawData, N> data_;
-	std::mutex mutex_;
+	static constexpr uint32_t kWordBits = 64;
+	static constexpr uint32_t kWords = (N + kWordBits - 1) / kWordBits;
+
+	Bitmap free_;
+	std::array<std::atomic<uint16>, N> generations_ = {};
+	alignas(kCacheLineSize) std::array<RawData, N> data_;	// scanned and copied in bulk
+
+	static uint32_t& ThreadHint()
+	{
+		static std::atomic<uint32_t> next_hint = 0;
+		// Consecutive threads start a few words apart.
+		static thread_local uint32_t hint = ((next_hint.fetch_add(1, std::memory_order_relaxed) * 7) % kWords) * kWordBits;
+		return hint;
+	}
+
+	bool IsFree(std::size_t idx) const { return free_.test(idx); }
+
+	template<typename ...Args> T* Construct(std::size_t idx, Args&&... args)
+	{
+		if (idx == npos)
+			return nullptr;
+		return new (&data_[idx]) T(std::forward<Args>(args)...);
+	}
 
 public:
 	T* safe_get_data() { return reinterpret_cast<T*>(&data_[0]); }
 	const T* safe_get_data() const { return reinterpret_cast<const T*>(&data_[0]); }
 
+	// Lowest free slot, keeps the taken slots dense.
 	template<typename ...Args> T* allocate(Args&&... args)
 	{
-		const auto idx = free_.find_first();
-		if (idx == Bitset2::bitset2<N>::npos)
-			return nullptr;
-		free_.set(idx, false);
-		return new (&data_[idx]) T(std::forward<Args>(args)...);
+		return Construct(free_.acquire_set(0), std::forward<Args>(args)...);
 	}
 
 	void free(T* item)
 	{
 		assert(item);
 		const auto idx = safe_get_index(item);
-		assert(!free_.test(idx));
-		free_.set(idx, true);
+		assert(!IsFree(idx));
 		item->~T();
+		const uint16 generation = generations_[idx].load(std::memory_order_relaxed) + 1;
+		generations_[idx].store((generation == SlotHandle::kInvalidGeneration) ? 0 : generation, std::memory_order_relaxed);
+		free_.set(idx);
 	}
 
 	uint32_t safe_get_index(const T* item) const
@@ -224,54 +420,67 @@ public:
 		return idx;
 	}
 
+	SlotHandle get_handle(const T* item) const
+	{
+		static_assert(N <= (SlotHandle::kIndexMask + 1), "too many slots for SlotHandle");
+		const uint32_t idx = safe_get_index(item);
+		return SlotHandle(idx, generations_[idx].load(std::memory_order_relaxed));
+	}
+
+	// O(1). nullptr when the slot was freed since the handle was taken.
+	T* get(SlotHandle handle)
+	{
+		const uint32_t idx = handle.Index();
+		if (!handle.IsValid() || (idx >= N) || IsFree(idx) || (generations_[idx].load(std::memory_order_relaxed) != handle.Generation()))
+			return nullptr;
+		return &safe_get_data()[idx];
+	}
+
 	bool is_set(const T* item) const
 	{
 		const auto idx = safe_get_index(item);
-		return (idx < N) && (idx >= 0) && !free_.test(idx);
+		return (idx < N) && (idx >= 0) && !IsFree(idx);
 	}
 
 	bool is_set(const std::size_t idx) const
 	{
-		return (idx < N) && (idx >= 0) && !free_.test(idx);
+		return (idx < N) && (idx >= 0) && !IsFree(idx);
 	}
 
+	// Thread safe, lock-free.
 	template<typename ...Args> T* safe_allocate(Args&&... args)
 	{ 
-		std::lock_guard guard(mutex_); 
-		return allocate(std::forward<Args>(args)...);
+		uint32_t& hint = ThreadHint();
+		const std::size_t idx = free_.acquire_set(hint);
+		if (idx != npos)
+		{
+			hint = static_cast<uint32_t>(idx);
+		}
+		return Construct(idx, std::forward<Args>(args)...);
 	}
 
+	// Thread safe, lock-free.
 	void safe_free(T* component) 
 	{ 
-		std::lock_guard guard(mutex_); 
 		free(component);
 	}
 
 	template<typename F> void for_each(F& func)
 	{
-		const auto occupied = ~free_;
-		for (auto idx = occupied.find_first(); idx != Bitset2::bitset2<N>::npos; idx = occupied.find_next(idx))
-		{
-			func(safe_get_data()[idx]);
-		}
+		free_.for_each_clear([&](std::size_t idx) { func(safe_get_data()[idx]); });
 	}
 
+	// Not concurrent with allocations.
 	void reset()
 	{
 		auto reset_single = [](T& component) { component.~T(); };
 		for_each(reset_single);
-		free_.set();
-	}
-
-	void safe_reset()
-	{
-		std::lock_guard guard(mutex_);
-		reset();
+		free_.set_all();
 	}
 
 	preallocated_container() 
 	{ 
-		free_.set(); 
+		free_.set_all();
 	}
 
 	~preallocated_container()
@@ -279,16 +488,16 @@ public:
 		reset();
 	}
 
-	const	T& operator[](std::size_t idx)	const	{	assert(N > idx); assert(!free_.test(idx)); return safe_get_data()[idx]; }
-			T& operator[](std::size_t idx)			{	assert(N > idx); assert(!free_.test(idx)); return safe_get_data()[idx]; }
+	const	T& operator[](std::size_t idx)	const	{	assert(N > idx); assert(!IsFree(idx)); return safe_get_data()[idx]; }
+			T& operator[](std::size_t idx)			{	assert(N > idx); assert(!IsFree(idx)); return safe_get_data()[idx]; }
 
 	std::size_t find_first_free() const
 	{
-		return free_.find_first();
+		return free_.find_first_set();
 	}
 
 	std::size_t find_next_taken(std::size_t start) const
 	{
-		return (~free_).find_next(start);
+		return free_.find_next_clear(start);
 	}
 };
\ No newline at end of file